@@ -0,0 +1,88 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A bone of a skinned model: the scene graph node that moves it, and the
+// matrix from bind pose mesh space into the bone's space
+struct Bone {
+    unsigned int node;
+    glm::mat4 offset;
+};
+
+// Local transform of every scene graph node, one array per component so
+// sampling and blending run over flat arrays
+struct Pose {
+    std::vector<glm::vec3> translations;
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> scales;
+
+    size_t size() const { return translations.size(); }
+    void resize(size_t nodes);
+    // translation * rotation * scale of one node
+    glm::mat4 localMatrix(size_t node) const;
+};
+
+// Keys of one animated node as imported, times in seconds; the input of
+// AnimationCompressor, clips only keep the compressed form
+struct AnimationChannel {
+    unsigned int node = 0;
+    std::vector<float> translationTimes;
+    std::vector<glm::vec3> translations;
+    std::vector<float> rotationTimes;
+    std::vector<glm::quat> rotations;
+    std::vector<float> scaleTimes;
+    std::vector<glm::vec3> scales;
+};
+
+// One compressed key, time and value side by side so a search and the fetch
+// after it touch the same cache line. time is in 1/65535 of the clip; value
+// is a vec3 quantized within its channel's range, or a smallest-three rotation.
+struct PackedKey {
+    uint16_t time;
+    uint16_t value[3];
+};
+
+PackedKey packRotation(glm::quat rotation);
+glm::quat unpackRotation(const PackedKey& key);
+
+// Compressed keyframes of one animation. Channel c moves node channelNodes[c]
+// and owns keys [start, start + count) of each component's key array; a
+// channel's translations and scales are quantized between its min and
+// min + extent.
+struct AnimationClip {
+    std::string name;
+    float duration = 0.0f;
+    // seconds to key time units
+    float timeScale = 0.0f;
+
+    std::vector<unsigned int> channelNodes;
+    std::vector<unsigned int> translationStart, translationCount;
+    std::vector<unsigned int> rotationStart, rotationCount;
+    std::vector<unsigned int> scaleStart, scaleCount;
+    std::vector<glm::vec3> translationMin, translationExtent;
+    std::vector<glm::vec3> scaleMin, scaleExtent;
+
+    std::vector<PackedKey> translationKeys;
+    std::vector<PackedKey> rotationKeys;
+    std::vector<PackedKey> scaleKeys;
+
+    // writes the animated nodes at time (wrapped to the clip) into pose and
+    // leaves the others alone
+    void sample(float time, Pose& pose) const;
+    size_t memoryBytes() const;
+};
+
+// normalized lerp along the shorter arc, what sampling and blending use
+inline glm::quat nlerp(const glm::quat& a, glm::quat b, float t) {
+    if (glm::dot(a, b) < 0.0f)
+        b = -b;
+    return glm::normalize(glm::quat(a.w + (b.w - a.w) * t, a.x + (b.x - a.x) * t,
+                                    a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t));
+}
+
+// pose moves weight of the way towards other, rotations by normalized lerp
+void blendPoses(Pose& pose, const Pose& other, float weight);
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Animation.h"
+
+// Largest error a dropped key may introduce: model units for translations
+// and scales, radians for rotations
+struct AnimationTolerance {
+    float translation = 0.001f;
+    float rotation = 0.001f;
+    float scale = 0.001f;
+};
+
+// Sizes before and after, added up over every clip compressed with the same stats
+struct AnimationCompressionStats {
+    size_t rawKeys = 0;
+    size_t keptKeys = 0;
+    size_t rawBytes = 0;
+    size_t compressedBytes = 0;
+};
+
+// Turns imported keyframes into a compressed AnimationClip. Keys that linear
+// interpolation between the kept ones reproduces within the tolerance are
+// dropped and constant tracks shrink to a single key; the rest are stored as
+// 8 byte PackedKeys: 16 bit times, translations and scales quantized to 16
+// bits within their channel's range, rotations as smallest three.
+class AnimationCompressor {
+public:
+    static AnimationClip compress(const std::string& name, float duration, const std::vector<AnimationChannel>& channels,
+                                  const AnimationTolerance& tolerance = AnimationTolerance(),
+                                  AnimationCompressionStats* stats = nullptr);
+};
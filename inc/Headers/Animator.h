@@ -0,0 +1,85 @@
+#pragma once
+
+#include <glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "Animation.h"
+#include "Model.h"
+#include "shader_m.h"
+#include "TransformSystem.h"
+
+// Texture unit of the bone palette buffer; clear of Mesh::Draw, the lights and the clusters
+const unsigned int PALETTE_TEXTURE_UNIT = 11;
+// RGBA32F texels per bone, the top three rows of its skinning matrix
+const unsigned int PALETTE_TEXELS = 3;
+
+// Plays a skinned model's clips for one character. A character placed by
+// transform is evaluated less often the further it is from the viewer; the
+// time it skips is made up on its next evaluation, so playback speed does
+// not depend on the rate. Animators register with the AnimationSystem while
+// they live.
+class Animator {
+public:
+    Animator(const Model& model, TransformHandle transform);
+    ~Animator();
+
+    // crossfades from the current clip over fadeSeconds
+    void play(size_t clip, float fadeSeconds = 0.0f);
+    void setSpeed(float newSpeed) { speed = newSpeed; }
+    bool isActive() const { return model.hasSkeleton() && !model.animations.empty(); }
+    // first texel of this character's palette in the bound palette buffer
+    int getPaletteOffset() const { return static_cast<int>(paletteOffset); }
+
+private:
+    Animator(const Animator&);
+    Animator& operator=(const Animator&);
+    friend class AnimationSystem;
+
+    // worker thread: samples, blends and writes the skinning matrices into palette
+    void evaluate(float deltaTime, glm::vec4* palette);
+
+    const Model& model;
+    TransformHandle transform;
+    size_t clip;
+    size_t previousClip;
+    float time;
+    float previousTime;
+    float fade;
+    float fadeDuration;
+    float speed;
+
+    // time since the last evaluation and the frames between evaluations
+    float pendingTime;
+    unsigned int interval;
+    size_t paletteOffset;
+
+    Pose pose;
+    Pose fadePose;
+    std::vector<glm::mat4> globals;
+};
+
+// Evaluates every live Animator once a frame on the job system and uploads
+// the skinning matrices of all characters into one texture buffer, so a draw
+// only selects its character's range with the paletteOffset uniform.
+// GL thread only, apart from the evaluation jobs it runs.
+class AnimationSystem {
+public:
+    static void initialize();
+    static void shutdown();
+
+    static void add(Animator* animator);
+    static void remove(Animator* animator);
+
+    // advances every animator by deltaTime, distant ones every few frames
+    static void update(float deltaTime, const glm::vec3& viewPosition);
+    // binds the palette buffer; every program drawing skinned meshes needs this once
+    static void bind(Shader& shader);
+
+    // animators evaluated by the last update
+    static size_t getLastEvaluatedCount();
+
+private:
+    // frames between evaluations at a distance from the viewer
+    static unsigned int updateInterval(float distance);
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <glad.h>
+#include <glm/glm.hpp>
+#include <functional>
+
+#include "shader_m.h"
+#include "Light.h"
+#include "DeferredRenderer.h"
+
+class Benchmark {
+public:
+    // Draws the opaque scene through the forward and the deferred path with
+    // 1, 16, 128 and 1024 random lights and prints the GPU time of each.
+    static void runLighting(DeferredRenderer& deferred, Shader& forwardShader, LightBuffer& lightBuffer,
+                            const std::function<void(Shader&)>& drawOpaque,
+                            const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos,
+                            const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+    // CPU only. Runs a synthetic scene (object culling and mesh bounds) on the
+    // job system with 1..N threads and prints the time and speedup of each.
+    static void runJobScaling();
+
+    // CPU only. Cuts a dense sphere with one cylinder, a batch of cylinders and
+    // a capped plane and prints the throughput of each in triangles per second.
+    static void runCutting();
+
+    // CPU only. Rebuilds the world matrices of 100k transforms through the
+    // batch update with all, a tenth and none of them dirty, with and without
+    // look-at targets, next to building each matrix from scratch with glm.
+    static void runTransforms();
+
+    // CPU only. Evaluates 500 characters with a 64 bone skeleton each frame,
+    // all close to the viewer and spread out so distant ones update less often,
+    // and prints how much compressing the clip saved.
+    static void runAnimation();
+
+    // CPU only. Rasterizes the walls of a maze as occluders and tests small
+    // boxes on its floor against them, printing raster and test time, how many
+    // boxes were culled, and how many of those a ray cast could still see.
+    static void runOcclusion();
+
+    // CPU only. Builds the SpatialIndex over 1k, 10k and 100k boxes and times
+    // frustum, ray, sphere and box queries, single and batched, against a
+    // linear scan, then moves every box a little each frame.
+    static void runSpatial();
+};
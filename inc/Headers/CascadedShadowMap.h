@@ -0,0 +1,86 @@
+#pragma once
+
+#include <glad.h>
+#include <glm/glm.hpp>
+#include <functional>
+
+#include "Frustum.h"
+#include "Light.h"
+#include "shader_m.h"
+
+// Texture unit of the cascade array, after the point shadow cubes
+const unsigned int SUN_SHADOW_TEXTURE_UNIT = 14;
+const unsigned int MAX_CASCADES = 4;
+
+// Shadows of a directional light over the camera's view distance, split into
+// 2-4 cascades along the view (practical split: a blend of logarithmic and
+// uniform). Each cascade is an orthographic map around the bounding sphere of
+// its slice, so its size does not change as the camera turns, and is moved in
+// whole texels so the shadows do not shimmer as it moves. Only casters inside
+// a cascade's light frustum are drawn into it. The nearest cascade renders
+// every frame, cascade i every 2^i frames, staggered so the far ones do not
+// land on the same frame; a cascade the camera has moved too far from is
+// rendered early. Shading picks the first cascade whose rendered map covers
+// the point, so a cascade that is a few frames old stays correct.
+class CascadedShadowMap {
+public:
+    // draws the casters of one cascade, culled against the cascade's light frustum
+    typedef std::function<void(Shader& shader, const Frustum& cascade)> DrawCasters;
+
+    explicit CascadedShadowMap(unsigned int cascades = 3, unsigned int resolution = 2048);
+    ~CascadedShadowMap();
+
+    // clamped to 2..MAX_CASCADES; rerenders every cascade
+    void setCascadeCount(unsigned int count);
+    unsigned int getCascadeCount() const { return cascadeCount; }
+    // 0 uniform splits .. 1 logarithmic splits
+    void setSplitLambda(float lambda) { splitLambda = lambda; }
+    // shadows end here or at the far plane, whichever is nearer
+    void setShadowDistance(float distance) { shadowDistance = distance; }
+
+    // fits the cascades to the camera; call once a frame before render()
+    void update(const DirectionalLight& sun, const glm::mat4& view, float fovY, float aspect, float nearPlane, float farPlane);
+    // renders the cascades due this frame; leaves the framebuffer unbound
+    void render(const DrawCasters& drawCasters);
+    // the shading programs (lighting, clustered, deferred sun) before drawing
+    void bind(Shader& shader) const;
+    // points the sampler at its unit with no cascades, for programs drawn before the first bind
+    static void bindDisabled(Shader& shader);
+
+    // the depth pass program, for AnimationSystem::bind
+    Shader& getShader() { return depthShader; }
+    // cascades rendered by the last render()
+    unsigned int getLastRenderedCount() const { return lastRendered; }
+    float getSplit(unsigned int cascade) const { return splits[cascade]; }
+
+private:
+    CascadedShadowMap(const CascadedShadowMap&);
+    CascadedShadowMap& operator=(const CascadedShadowMap&);
+
+    void createMaps();
+    void destroyMaps();
+
+    unsigned int resolution;
+    unsigned int cascadeCount;
+    float splitLambda;
+    float shadowDistance;
+
+    unsigned int fbo;
+    unsigned int depthArray;
+
+    // far end of each cascade in view depth
+    float splits[MAX_CASCADES];
+    // what update() wants this frame
+    glm::mat4 wantedMatrices[MAX_CASCADES];
+    glm::vec3 wantedCenters[MAX_CASCADES];
+    float radii[MAX_CASCADES];
+    // what the maps hold; shading uses these
+    glm::mat4 renderedMatrices[MAX_CASCADES];
+    glm::vec3 renderedCenters[MAX_CASCADES];
+    bool rendered[MAX_CASCADES];
+
+    glm::vec3 sunDirection;
+    unsigned int frame;
+    unsigned int lastRendered;
+    Shader depthShader;
+};
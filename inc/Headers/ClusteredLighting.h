@@ -0,0 +1,75 @@
+#pragma once
+
+#include <glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "FrameAllocator.h"
+#include "shader_m.h"
+#include "Light.h"
+
+// Froxel grid the view frustum is split into (x/y tiles in screen space,
+// exponential slices in depth)
+const unsigned int CLUSTER_X = 16;
+const unsigned int CLUSTER_Y = 9;
+const unsigned int CLUSTER_Z = 24;
+const unsigned int CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+
+// Texture units for the cluster tables, next to LIGHT_TEXTURE_UNIT
+const unsigned int CLUSTER_GRID_TEXTURE_UNIT = 9;
+const unsigned int CLUSTER_INDEX_TEXTURE_UNIT = 10;
+
+// Clustered forward light assignment. Every frame the lights are binned into
+// the froxels they touch on the CPU (one job per depth slice, four lights
+// per SSE test) and the per-cluster light lists are uploaded to
+// texture buffers for lighting_clustered.frag.
+class ClusteredLighting {
+public:
+    ClusteredLighting();
+    ~ClusteredLighting();
+
+    // lights must be in the same order as in the LightBuffer the shader reads
+    void update(const std::vector<PointLight>& lights, const glm::mat4& view,
+                float fovY, float aspect, float zNear, float zFar);
+    void bind(Shader& shader, unsigned int screenWidth, unsigned int screenHeight) const;
+
+    unsigned int getAssignmentCount() const { return assignmentCount; }
+
+private:
+    ClusteredLighting(const ClusteredLighting&);
+    ClusteredLighting& operator=(const ClusteredLighting&);
+
+    struct ClusterBounds {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+
+    // Per depth slice output. The lists are frame arena memory and replaced
+    // rather than cleared on every update, since the arena an older update
+    // used may have been reset while clustering was off.
+    struct SliceOutput {
+        std::vector<unsigned int> counts;
+        FrameVector<unsigned int> indices;
+        FrameVector<float> cx, cy, cz, r2;
+        FrameVector<unsigned int> candidates;
+    };
+
+    void buildClusterBounds(float fovY, float aspect, float zNear, float zFar);
+    void binSlice(unsigned int slice);
+
+    std::vector<ClusterBounds> bounds;
+    float boundsFovY, boundsAspect, boundsNear, boundsFar;
+    float zScale, zBias;
+
+    // view space light spheres for the current update
+    FrameVector<glm::vec4> viewLights;
+    SliceOutput slices[CLUSTER_Z];
+
+    std::vector<unsigned int> gridData;
+    unsigned int assignmentCount;
+
+    unsigned int gridBuffer, gridTexture;
+    unsigned int indexBuffer, indexTexture;
+    size_t indexCapacity;
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <glad.h>
+#include <glm/glm.hpp>
+
+#include "shader_m.h"
+#include "Light.h"
+
+// Deferred shading path: opaque geometry is written once into a G-buffer
+// (albedo, normal, material params, depth) and every light is then applied
+// as an additively blended sphere volume covering only the pixels it reaches.
+class DeferredRenderer {
+public:
+    DeferredRenderer(unsigned int width, unsigned int height);
+    ~DeferredRenderer();
+
+    void resize(unsigned int width, unsigned int height);
+
+    // binds and clears the G-buffer; draw opaque objects with getGeometryShader() afterwards
+    void beginGeometryPass(const glm::mat4& view, const glm::mat4& projection);
+    Shader& getGeometryShader() { return geometryShader; }
+    void endGeometryPass();
+
+    // shades the G-buffer into targetFBO and copies the depth across so
+    // forward-rendered objects (laser, debug lines) can be drawn on top;
+    // a sun is added in one fullscreen pass
+    void lightingPass(const LightBuffer& lights, const glm::mat4& view, const glm::mat4& projection,
+                      const glm::vec3& viewPos, unsigned int targetFBO = 0, const DirectionalLight* sun = nullptr);
+    // the light volume program, for PointShadowMap::bind
+    Shader& getLightShader() { return lightShader; }
+    // the sun program, for CascadedShadowMap::bind
+    Shader& getSunShader() { return sunShader; }
+
+private:
+    DeferredRenderer(const DeferredRenderer&);
+    DeferredRenderer& operator=(const DeferredRenderer&);
+
+    void createTargets();
+    void destroyTargets();
+    void createLightVolume();
+
+    unsigned int width;
+    unsigned int height;
+
+    unsigned int gBuffer;
+    unsigned int gAlbedoSpec;
+    unsigned int gNormal;
+    unsigned int gMaterial;
+    unsigned int gDepth;
+
+    unsigned int sphereVAO, sphereVBO, sphereEBO;
+    unsigned int sphereIndexCount;
+    unsigned int fullscreenVAO;
+
+    Shader geometryShader;
+    Shader lightShader;
+    Shader sunShader;
+};
@@ -7,19 +7,19 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <vector>
 
+#include "Animator.h"
+#include "Frustum.h"
 #include "Model.h"
 #include "shader_m.h"
+#include "TransformSystem.h"
 
-enum class RotationMode {
-    NONE,
-    Y_ONLY,
-    ALL
-};
-
+// Draws a model with its own transform, which lives in the TransformSystem
 class Drawer {
 public:
     Drawer(Model& model, Shader& shader);
+    ~Drawer();
     void draw();
+    void draw(Shader& overrideShader);
     void setPosition(const glm::vec3& pos);
     void setScale(const glm::vec3& s);
     void setRotation(const glm::vec3& rot);
@@ -28,18 +28,28 @@ public:
     void setupBoundingBox(Shader& lineShader);
     Model& getModel();
     void setModel(Model& newModel);
+    // skinned meshes follow this animator's palette while it is active
+    void setAnimator(const Animator* newAnimator) { animator = newAnimator; }
     
     // Add getter methods
-    glm::vec3 getPosition() const { return position; }
-    glm::vec3 getTarget() const { return target; }
-    glm::mat4 calculateModelMatrix() const;
+    glm::vec3 getPosition() const { return TransformSystem::getPosition(transform); }
+    glm::vec3 getTarget() const { return TransformSystem::getTarget(transform); }
+    glm::vec3 getScale() const { return TransformSystem::getScale(transform); }
+    glm::vec3 getRotation() const { return TransformSystem::getRotation(transform); }
+    RotationMode getRotationMode() const { return TransformSystem::getRotationMode(transform); }
+    TransformHandle getTransform() const { return transform; }
+    // cached, only rebuilt after the transform changed
+    glm::mat4 calculateModelMatrix() const { return TransformSystem::getWorldMatrix(transform); }
+    glm::mat3 calculateNormalMatrix(const glm::mat4& modelMatrix) const;
+    // world AABB of the model's bounds under the current transform
+    void getWorldBounds(glm::vec3& boundsMin, glm::vec3& boundsMax) const;
     
 private:
+    Drawer(const Drawer&);
+    Drawer& operator=(const Drawer&);
+
     Model& model;
     Shader& shader;
-    glm::vec3 position;
-    glm::vec3 scale;
-    glm::vec3 rotation;
-    RotationMode rotationMode;
-    glm::vec3 target;
+    TransformHandle transform;
+    const Animator* animator;
 };
\ No newline at end of file
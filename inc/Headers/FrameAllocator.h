@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Linear allocator for transient data. Two arenas alternate between frames:
+// beginFrame() resets the older one, so memory handed out during a frame
+// stays valid through the next frame as well, long enough for a consumer
+// that picks the data up a frame late. Allocation is a lock-free bump from
+// any thread; nothing is freed individually. Requests that do not fit fall
+// back to the heap and are freed with their arena. A background job whose
+// temporaries can outlive the two frames holds the arenas, and beginFrame()
+// resets neither until every hold is released.
+//
+// The allocator also counts global operator new calls, so a frame can be
+// checked for heap allocations (build with -DENGINE_NO_ALLOC_COUNT to drop
+// the counting operator new).
+class FrameAllocator {
+public:
+    static const size_t DEFAULT_CAPACITY = 16 * 1024 * 1024;
+
+    // capacity per arena
+    static void initialize(size_t capacity = DEFAULT_CAPACITY);
+    static void shutdown();
+    // main thread, at the very start of a frame
+    static void beginFrame();
+    // main thread; a hold taken before a job starts and released once it has
+    // finished keeps everything the job allocated valid
+    static void hold();
+    static void release();
+
+    static void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+    template <typename T>
+    static T* allocateArray(size_t count) { return static_cast<T*>(allocate(count * sizeof(T), alignof(T))); }
+
+    // bytes of the current arena in use, and what had to go to the heap this frame
+    static size_t getUsedBytes();
+    static size_t getOverflowBytes();
+    // operator new calls since beginFrame(), and over the whole previous frame
+    static uint64_t getHeapAllocations();
+    static uint64_t getLastFrameHeapAllocations();
+};
+
+// STL allocator on top of the frame arenas; deallocate does nothing, the
+// memory goes back when the arena is reset
+template <typename T>
+struct FrameStlAllocator {
+    typedef T value_type;
+
+    FrameStlAllocator() {}
+    template <typename U>
+    FrameStlAllocator(const FrameStlAllocator<U>&) {}
+
+    T* allocate(size_t count) { return FrameAllocator::allocateArray<T>(count); }
+    void deallocate(T*, size_t) {}
+};
+
+template <typename T, typename U>
+bool operator==(const FrameStlAllocator<T>&, const FrameStlAllocator<U>&) { return true; }
+template <typename T, typename U>
+bool operator!=(const FrameStlAllocator<T>&, const FrameStlAllocator<U>&) { return false; }
+
+template <typename T>
+using FrameVector = std::vector<T, FrameStlAllocator<T>>;
+typedef std::basic_string<char, std::char_traits<char>, FrameStlAllocator<char>> FrameString;
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// The six planes of a view-projection matrix (normal.xyz, distance.w, normals
+// pointing inwards and normalized). The tests are conservative: a volume near
+// a corner may pass although it lies outside.
+struct Frustum {
+    glm::vec4 planes[6];
+
+    static Frustum fromMatrix(const glm::mat4& viewProjection);
+
+    bool intersectsSphere(const glm::vec3& center, float radius) const;
+    // box given by its center and half extent
+    bool intersectsBox(const glm::vec3& center, const glm::vec3& extent) const;
+    bool intersectsBounds(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const {
+        return intersectsBox((boundsMin + boundsMax) * 0.5f, (boundsMax - boundsMin) * 0.5f);
+    }
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <glad.h>
+
+// Measures GPU time between begin() and end() with GL_TIME_ELAPSED queries.
+// Two queries are kept in flight so reading last frame's result never stalls.
+class GpuTimer {
+public:
+    GpuTimer();
+    ~GpuTimer();
+
+    void begin();
+    void end();
+
+    // latest result that the GPU has finished with, without blocking
+    double lastMilliseconds();
+    // blocks until the most recent begin()/end() pair has been measured
+    double waitMilliseconds();
+
+private:
+    GpuTimer(const GpuTimer&);
+    GpuTimer& operator=(const GpuTimer&);
+
+    unsigned int queries[2];
+    bool pending[2];
+    unsigned int current;
+    double lastResult;
+};
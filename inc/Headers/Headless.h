@@ -0,0 +1,61 @@
+#pragma once
+
+#include <glad.h>
+#include <glm/glm.hpp>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "camera.h"
+
+struct HeadlessOptions {
+    unsigned int frames = 300;
+    // excluded from the statistics, shaders and caches settle first
+    unsigned int warmupFrames = 10;
+    // fixed simulation step so runs are reproducible regardless of frame time
+    float deltaTime = 1.0f / 60.0f;
+    std::string cameraPath;
+    std::string statsPath;
+    std::string snapshotDir;
+    // write a PNG every N frames, 0 for none
+    unsigned int snapshotInterval = 0;
+    // fail the run if a measured frame allocated from the heap
+    bool requireNoAllocations = false;
+};
+
+// Camera keyframes spread evenly over the run and interpolated linearly.
+// The file format is one "px py pz tx ty tz" position/target pair per line,
+// '#' starts a comment.
+class CameraPath {
+public:
+    bool load(const std::string& path);
+    // closed loop around the bounds at eye height
+    void orbit(const glm::vec3& boundsMin, const glm::vec3& boundsMax, float height, unsigned int keys = 8);
+    // t in [0, 1] over the whole path
+    void apply(Camera& camera, float t) const;
+
+private:
+    struct Key {
+        glm::vec3 position;
+        glm::vec3 target;
+    };
+    std::vector<Key> keys;
+};
+
+// Runs the renderer without a visible window or user input: the scene is
+// drawn into an offscreen framebuffer along a scripted camera path for a
+// fixed number of frames, and the frame time distribution is reported.
+// Each frame ends in glFinish so the times include the GPU (or llvmpipe) work.
+class Headless {
+public:
+    // renderFrame draws one frame into the given framebuffer using deltaTime
+    static int run(const HeadlessOptions& options, Camera& camera, unsigned int width, unsigned int height,
+                   const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+                   const std::function<void(unsigned int targetFBO, float deltaTime)>& renderFrame);
+
+    // prints mean/p50/p95/p99/min/max and writes them as JSON to statsPath unless it is empty
+    static void writeStats(const std::string& statsPath, std::vector<double> frameMilliseconds);
+
+private:
+    static bool writeSnapshot(const std::string& path, unsigned int width, unsigned int height);
+};
@@ -5,11 +5,66 @@
 #include "camera.h"
 #include "imgui.h"
 
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+enum class ShadingMode {
+    FORWARD,
+    CLUSTERED,
+    DEFERRED
+};
+
+// Keys the engine reacts to, as bits of InputFrame::keys
+enum InputKey {
+    INPUT_KEY_W,
+    INPUT_KEY_A,
+    INPUT_KEY_S,
+    INPUT_KEY_D,
+    INPUT_KEY_SPACE,
+    INPUT_KEY_V,
+    INPUT_KEY_G,
+    INPUT_KEY_M,
+    INPUT_KEY_T,
+    INPUT_KEY_Q,
+    INPUT_KEY_ESCAPE,
+    INPUT_KEY_COUNT
+};
+
+// Everything one frame of input can change, so a session can be recorded and replayed
+struct InputFrame {
+    uint32_t keys;
+    float mouseX;
+    float mouseY;
+    float scroll;
+    float deltaTime;
+
+    bool isDown(InputKey key) const { return (keys & (1u << key)) != 0; }
+
+    // folds a later frame in, so a press or mouse motion between two simulation steps is not lost
+    void merge(const InputFrame& later) {
+        keys |= later.keys;
+        mouseX += later.mouseX;
+        mouseY += later.mouseY;
+        scroll += later.scroll;
+        deltaTime += later.deltaTime;
+    }
+};
+
+// camera look and movement over step seconds, laser trigger; touches no GLFW or
+// InputManager state, so safe on the simulation thread
+void applyMotion(const InputFrame& frame, float step, Camera& camera, float& laserTimer, float laserDuration);
+
 class InputManager {
 public:
     InputManager(Camera& camera, float& deltaTime, float& laserTimer, float& laserDuration, bool& vsyncEnabled);
     
+    // sample(), applyToggles() and applyMotion() over deltaTime in one go
     void processInput(GLFWwindow* window);
+    // live key state plus the mouse motion and scroll accumulated by the callbacks since the last call
+    InputFrame sample(GLFWwindow* window);
+    // window, menu, VSync and shading mode keys; touches GLFW so main thread only
+    void applyToggles(GLFWwindow* window, const InputFrame& frame);
     static void framebuffer_size_callback(GLFWwindow* window, int width, int height);
     static void mouse_callback(GLFWwindow* window, double xposIn, double yposIn);
     static void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
@@ -17,6 +72,14 @@ public:
     
     static void setShowMenu(bool show) { showMenu = show; }
     static bool isShowMenu() { return showMenu; }
+    static ShadingMode getShadingMode() { return shadingMode; }
+    // true once per T press
+    static bool consumeTraceRequest() { bool requested = traceRequested; traceRequested = false; return requested; }
+
+    // called from framebuffer_size_callback so render targets are only ever resized there;
+    // remove the listener with the returned id before whatever it captures goes away
+    static unsigned int addResizeListener(const std::function<void(int, int)>& listener);
+    static void removeResizeListener(unsigned int id);
     
 private:
     Camera& camera;
@@ -27,9 +90,23 @@ private:
     bool& vsyncEnabled;
     
     static bool showMenu;
+    static ShadingMode shadingMode;
+    static bool gKeyPressed;
+    static bool mKeyPressed;
+    static bool tKeyPressed;
+    static bool traceRequested;
+    struct ResizeListener {
+        unsigned int id;
+        std::function<void(int, int)> callback;
+    };
+    static std::vector<ResizeListener> resizeListeners;
+    static unsigned int nextListenerId;
     static float lastX;
     static float lastY;
     static bool firstMouse;
+    static float mouseX;
+    static float mouseY;
+    static float scroll;
     static unsigned int SCR_WIDTH;
     static unsigned int SCR_HEIGHT;
 }; 
\ No newline at end of file
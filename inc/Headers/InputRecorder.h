@@ -0,0 +1,44 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "InputManager.h"
+
+// Session files are a small header followed by one fixed-size InputFrame
+// record per frame (20 bytes, in the recording machine's byte order).
+
+class InputRecorder {
+public:
+    InputRecorder() : frames(0) {}
+    ~InputRecorder() { close(); }
+
+    bool open(const std::string& path);
+    void write(const InputFrame& frame);
+    void close();
+    bool isOpen() const { return file.is_open(); }
+
+private:
+    InputRecorder(const InputRecorder&);
+    InputRecorder& operator=(const InputRecorder&);
+
+    std::ofstream file;
+    unsigned int frames;
+};
+
+class InputReplay {
+public:
+    InputReplay() : position(0) {}
+
+    // reads the whole session up front so replay never touches the disk mid-run
+    bool open(const std::string& path);
+    // false once every recorded frame has been handed out
+    bool next(InputFrame& frame);
+    bool isOpen() const { return !records.empty(); }
+    size_t frameCount() const { return records.size(); }
+
+private:
+    std::vector<InputFrame> records;
+    size_t position;
+};
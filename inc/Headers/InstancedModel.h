@@ -0,0 +1,119 @@
+#pragma once
+
+#include <glad.h>
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+
+#include "FrameAllocator.h"
+#include "Frustum.h"
+#include "Model.h"
+#include "OcclusionCuller.h"
+#include "SpatialIndex.h"
+#include "shader_m.h"
+
+// Texture unit of the depth pyramid while the cull shader runs
+const unsigned int HIZ_TEXTURE_UNIT = 15;
+
+// Max-depth pyramid of a depth buffer for occlusion tests on the GPU: every
+// texel holds the farthest depth of the pixels under it, level 0 at half the
+// depth buffer's size. Built with compute shaders, GL 4.3 only.
+class HiZPyramid {
+public:
+    HiZPyramid();
+    ~HiZPyramid();
+
+    // rebuilds from depthTexture (width x height); reallocates when the size changed
+    void build(unsigned int depthTexture, unsigned int width, unsigned int height);
+    bool isBuilt() const { return texture != 0; }
+    unsigned int getTexture() const { return texture; }
+    glm::ivec2 getSize() const { return size; }
+    glm::ivec2 getDepthSize() const { return glm::ivec2(depthWidth, depthHeight); }
+    int getLevelCount() const { return levels; }
+
+private:
+    HiZPyramid(const HiZPyramid&);
+    HiZPyramid& operator=(const HiZPyramid&);
+
+    unsigned int texture;
+    unsigned int depthWidth;
+    unsigned int depthHeight;
+    glm::ivec2 size;
+    int levels;
+    Shader downsampleShader;
+};
+
+// Many static copies of one model. With GL 4.3 the whole job stays on the
+// GPU: instance matrices and world bounds live in a storage buffer, a compute
+// shader tests each against the frustum and the depth pyramid of the previous
+// frame and appends the survivors to a visible list, and every mesh is drawn
+// with one glDrawElementsIndirect whose instance count the GPU wrote. The CPU
+// touches no instance per frame. Testing against last frame's depth can keep
+// an object that just came out from behind an occluder hidden for a frame.
+// On GL 3.3 the CPU finds the instances in the frustum through a
+// SpatialIndex, tests those against the OcclusionCuller and draws the
+// survivors one by one.
+class InstancedModel {
+public:
+    // GPU driven when asked for and the context has GL 4.3
+    InstancedModel(Model& model, bool preferGpu);
+    ~InstancedModel();
+
+    static bool isGpuCullingSupported();
+    bool isGpuDriven() const { return gpuDriven; }
+
+    // uploads the instances; their bounds come from the model's
+    void setInstances(const std::vector<glm::mat4>& matrices);
+    size_t getInstanceCount() const { return instances.size(); }
+
+    // GPU: dispatches the culling (hiZ may be unbuilt, then only the frustum
+    // counts); CPU: fills the visible list, occlusion may be null
+    void cull(const glm::mat4& viewProjection, const HiZPyramid* hiZ, OcclusionCuller* occlusion);
+    // GPU: draws with getShader(); CPU: with shader, which takes the usual model uniform
+    void draw(Shader& shader);
+    // the GPU path's program, lighting.frag on an instance fetching vertex shader
+    Shader& getShader() { return *instanceShader; }
+
+    // instances drawn by the last cull; reading the GPU's count waits for it, so
+    // only for statistics now and then
+    size_t readVisibleCount() const;
+
+private:
+    InstancedModel(const InstancedModel&);
+    InstancedModel& operator=(const InstancedModel&);
+
+    // std430 layout of one instance in the storage buffer
+    struct GpuInstance {
+        glm::mat4 model;
+        glm::mat4 normalMatrix;
+        glm::vec4 boundsMin;
+        glm::vec4 boundsMax;
+    };
+
+    // glDrawElementsIndirect's command
+    struct DrawElementsIndirectCommand {
+        unsigned int count;
+        unsigned int instanceCount;
+        unsigned int firstIndex;
+        int baseVertex;
+        unsigned int baseInstance;
+    };
+
+    Model& model;
+    bool gpuDriven;
+    std::vector<GpuInstance> instances;
+
+    // CPU path
+    SpatialIndex index;
+    // frame arena memory, valid for the frame of the last cull()
+    FrameVector<uint32_t> visible;
+
+    // GPU path
+    unsigned int instanceBuffer;
+    unsigned int visibleBuffer;
+    unsigned int counterBuffer;
+    unsigned int commandBuffer;
+    std::unique_ptr<Shader> cullShader;
+    std::unique_ptr<Shader> commandShader;
+    std::unique_ptr<Shader> instanceShader;
+};
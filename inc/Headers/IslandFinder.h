@@ -0,0 +1,33 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+#include "Mesh.h"
+
+// One connected piece of a model, split back into the model's meshes so every
+// part keeps its material; meshes the island does not touch stay empty. The
+// bounds are in model space.
+struct IslandGeometry {
+    vector<vector<Vertex>> vertices;
+    vector<vector<unsigned int>> indices;
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    size_t triangles;
+};
+
+// Connected components of a model's geometry. Triangles join their corners in
+// a union-find, and corners at the same position are welded through a spatial
+// hash, which also joins pieces across mesh (material) boundaries and UV seams.
+// Scratch storage comes from the frame arena, so only the islands allocate on
+// the heap.
+class IslandFinder {
+public:
+    // islands smaller than minTriangles are debris and dropped; returns the
+    // number of islands found (dropped ones included) and fills islands only
+    // when there is more than one. meshTransforms places meshes below moved
+    // scene graph nodes, so they weld in model space.
+    static size_t split(const vector<vector<Vertex>>& vertices, const vector<vector<unsigned int>>& indices,
+                        size_t minTriangles, vector<IslandGeometry>& islands, const glm::mat4* meshTransforms = nullptr);
+};
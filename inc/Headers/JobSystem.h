@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+
+// A job runs function(data, begin, end). The job system never allocates or
+// copies jobs: the caller keeps them alive until wait() on their counter returns.
+typedef void (*JobFunction)(void* data, size_t begin, size_t end);
+
+struct JobCounter {
+    std::atomic<int> pending;
+    JobCounter() : pending(0) {}
+};
+
+struct Job {
+    JobFunction function;
+    void* data;
+    size_t begin;
+    size_t end;
+    JobCounter* counter;
+};
+
+// Work-stealing job system. Every thread (the main thread included) owns a
+// Chase-Lev deque: it pushes and pops its own jobs at the bottom without
+// locks while idle threads steal from the top. Dependencies are expressed
+// with counters: wait() on the counter of the jobs a stage depends on, and
+// the waiting thread runs other jobs meanwhile instead of blocking. Jobs that
+// touch GL go through runOnMainThread(). Long jobs that must not stall a frame
+// go through runInBackground(), which only workers pick up.
+class JobSystem {
+public:
+    // workerCount threads besides the calling thread, which becomes the main thread;
+    // 0 uses one per spare hardware thread
+    static void initialize(unsigned int workerCount = 0);
+    static void shutdown();
+    // threads executing jobs, the main thread included
+    static unsigned int getThreadCount();
+    static bool isMainThread();
+
+    // counter.pending is raised by count and dropped as each job finishes; threads
+    // outside the job system run the jobs inline
+    static void run(Job* jobs, size_t count, JobCounter& counter);
+    // as run(), but into a shared queue the main thread never takes from, so a
+    // wait() or parallelFor on the main thread cannot end up running the job
+    // inline; without workers the jobs run inline right away
+    static void runInBackground(Job* jobs, size_t count, JobCounter& counter);
+    static void wait(JobCounter& counter);
+
+    // splits [0, count) into ranges of at most grain items and returns when all are done
+    static void parallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& body);
+
+    // queued for executeMainThreadJobs(), which the main thread calls once a frame and while waiting
+    static void runOnMainThread(const std::function<void()>& job);
+    static void executeMainThreadJobs();
+};
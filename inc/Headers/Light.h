@@ -0,0 +1,71 @@
+#pragma once
+
+#include <glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "shader_m.h"
+
+// Texture unit the light buffer is bound to; kept clear of the units Mesh::Draw uses
+const unsigned int LIGHT_TEXTURE_UNIT = 8;
+// Number of RGBA32F texels one light occupies in the buffer
+const unsigned int LIGHT_TEXELS = 4;
+
+struct PointLight {
+    glm::vec3 position;
+
+    glm::vec3 ambient;
+    glm::vec3 diffuse;
+    glm::vec3 specular;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    PointLight(const glm::vec3& position = glm::vec3(0.0f),
+               const glm::vec3& ambient = glm::vec3(0.2f),
+               const glm::vec3& diffuse = glm::vec3(0.5f),
+               const glm::vec3& specular = glm::vec3(1.0f),
+               float constant = 1.0f, float linear = 0.09f, float quadratic = 0.032f);
+
+    // distance at which the attenuated light drops below 5/256, i.e. is no longer visible
+    float radius() const;
+};
+
+// Sun: parallel light travelling along direction. Shaders leave it out
+// until bind() switched it on.
+struct DirectionalLight {
+    glm::vec3 direction;
+
+    glm::vec3 ambient;
+    glm::vec3 diffuse;
+    glm::vec3 specular;
+
+    DirectionalLight(const glm::vec3& direction = glm::vec3(-0.3f, -1.0f, -0.2f),
+                     const glm::vec3& ambient = glm::vec3(0.05f),
+                     const glm::vec3& diffuse = glm::vec3(0.6f),
+                     const glm::vec3& specular = glm::vec3(0.5f));
+
+    void bind(Shader& shader) const;
+};
+
+// Packs point lights into a texture buffer so shaders can loop over any number of them
+class LightBuffer {
+public:
+    LightBuffer();
+    ~LightBuffer();
+
+    void upload(const std::vector<PointLight>& lights);
+    void bind(Shader& shader) const;
+    unsigned int count() const { return lightCount; }
+
+private:
+    LightBuffer(const LightBuffer&);
+    LightBuffer& operator=(const LightBuffer&);
+
+    unsigned int buffer;
+    unsigned int texture;
+    size_t capacity;
+    unsigned int lightCount;
+    std::vector<glm::vec4> staging;
+};
@@ -13,12 +13,25 @@
 #include <unordered_map>
 using namespace std;
 
+// bones that may move one vertex
+const unsigned int MAX_BONE_INFLUENCE = 4;
+
 struct Vertex {
     glm::vec3 Position;
     glm::vec3 Normal;
     glm::vec2 TexCoords;
     glm::vec3 Tangent;
     glm::vec3 Bitangent;
+    // unused influences keep bone 0 with a weight of 0
+    int BoneIDs[MAX_BONE_INFLUENCE] = {};
+    float Weights[MAX_BONE_INFLUENCE] = {};
+};
+
+// Solid cylinder removed by a laser cut, in model space
+struct SliceCylinder {
+    glm::vec3 start;
+    glm::vec3 end;
+    float radius;
 };
 
 struct Texture {
@@ -33,14 +46,24 @@ public:
     vector<unsigned int> indices;
     vector<Texture> textures;
     unsigned int VAO;
+    // the model's scene graph node the mesh hangs from, 0 is the root
+    unsigned int node;
+    // moved by the model's bones rather than its node
+    bool skinned;
 
     Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures);
     void Draw(Shader &shader);
+    // the textures Draw binds, units 0 up, for callers issuing their own draws on VAO
+    void bindTextures(Shader &shader);
+    // Deletes the GL buffers and frees the CPU copy. Meshes are plain values that
+    // share their buffers when copied, so only the owning model calls this.
+    void release();
     vector<Mesh> sliceMesh(const Mesh& mesh, float xThreshold);
     Mesh sliceMeshCyl(const Mesh& mesh, const glm::vec3& cylinderAxisStart, const glm::vec3& cylinderAxisEnd, float cylinderRadius);
 
 private:
     unsigned int VBO, EBO;
+    vector<string> samplerNames;
     void setupMesh();
 };
 #endif
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "Mesh.h"
+
+// A solid region removed from a mesh. Each shape is a signed field that is
+// negative inside the removed region; the cutter keeps where every field is >= 0.
+struct CutShape {
+    enum Type {
+        PLANE,
+        CYLINDER
+    };
+    Type type;
+    // plane: a point on it, cylinder: the start of the axis
+    glm::vec3 origin;
+    // plane: normal pointing into the removed half, cylinder: unit axis
+    glm::vec3 axis;
+    float length;
+    float radius;
+
+    static CutShape plane(const glm::vec3& point, const glm::vec3& removedNormal);
+    static CutShape cylinder(const SliceCylinder& cylinder);
+
+    float distance(const glm::vec3& point) const;
+};
+
+struct CutStats {
+    size_t inputTriangles = 0;
+    size_t keptTriangles = 0;
+    size_t clippedTriangles = 0;
+    size_t capTriangles = 0;
+};
+
+// Cuts geometry against a union of shapes. Triangles fully outside are kept,
+// triangles straddling a surface are clipped there with the new corners'
+// normals, UVs and tangents interpolated along the edge, and with caps on
+// the cut is closed by triangulating each boundary loop (planar cuts only,
+// a cylinder through a mesh leaves an open tunnel). Kept geometry is compacted
+// in parallel over the job system; clipping and caps are serial since only the
+// triangles along the cut reach them. All temporaries live in the frame
+// arena, so only the output allocates on the heap.
+class MeshCutter {
+public:
+    static void cut(const vector<Vertex>& vertices, const vector<unsigned int>& indices,
+                    const CutShape* shapes, size_t shapeCount, bool caps,
+                    vector<Vertex>& outVertices, vector<unsigned int>& outIndices, CutStats* stats = nullptr);
+};
@@ -13,8 +13,12 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include "Animation.h"
+#include "AnimationCompressor.h"
 #include "Mesh.h"
+#include "SceneGraph.h"
 #include "shader_m.h"
+#include "Trace.h"
 
 #include <string>
 #include <iostream>
@@ -25,30 +29,83 @@ using namespace std;
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
+// How much assimp reworks a file on top of triangulating it and generating
+// normals, tangents and flipped UVs
+enum class ImportProfile {
+    // as the file comes, an OBJ gives every face corner its own vertex
+    RAW,
+    // welds identical vertices, drops degenerate triangles and stray points
+    // and lines, orders triangles for the post-transform cache and splits
+    // meshes past SPLIT_VERTEX_LIMIT vertices
+    STANDARD,
+    // STANDARD, then merges meshes sharing a material and flattens the node
+    // graph; fewest draw calls, for static models whose nodes nothing moves
+    MERGED
+};
+const char* importProfileName(ImportProfile profile);
+
+// what the profile did to a model: the counts after the basic import, the
+// counts drawn in the end, and the time of both
+struct ImportStats {
+    size_t verticesBefore = 0;
+    size_t verticesAfter = 0;
+    size_t trianglesBefore = 0;
+    size_t trianglesAfter = 0;
+    // meshes as placed by nodes, one draw call each
+    size_t meshesBefore = 0;
+    size_t meshesAfter = 0;
+    double importMilliseconds = 0.0;
+};
+
 class Model 
 {
 public:
     vector<Texture> textures_loaded;
     vector<Mesh> meshes;
+    // the file's node hierarchy, each mesh refers to its node
+    SceneGraph nodes;
+    // skeleton and clips; an Animator plays them, the model itself stays in its rest pose
+    vector<Bone> bones;
+    vector<AnimationClip> animations;
+    // what compressing the clips at import saved
+    AnimationCompressionStats animationStats;
+    // every node's local transform as imported
+    Pose restPose;
+    ImportStats importStats;
     string directory;
     bool gammaCorrection;
 
-    Model() : gammaCorrection(false) {}
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma) {
-        loadModel(path);
+    Model() : gammaCorrection(false) {
+        updateBounds();
+    }
+    Model(string const &path, bool gamma = false, ImportProfile profile = ImportProfile::STANDARD) : gammaCorrection(gamma) {
+        loadModel(path, profile);
+        updateBounds();
     }
     ~Model() {
         meshes.clear();
         textures_loaded.clear();
     }
 
-    void Draw(Shader &shader) {
-        for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
-    }
+    // modelMatrix and normalMatrix are the drawer's, already set on the shader;
+    // meshes below a moved node get them combined with their node's transform.
+    // With skinning, skinned meshes are drawn through the bound bone palette.
+    void Draw(Shader &shader, const glm::mat4& modelMatrix, const glm::mat3& normalMatrix, bool skinning = false);
+    bool hasSkeleton() const { return !bones.empty(); }
+    // frees every mesh's buffers; textures are shared with the model pieces were cut from
+    void release();
 
     vector<Model> sliceModel(float xThreshold);
     void sliceModelCylinder(const glm::vec3& cylinderAxisStart, const glm::vec3& cylinderAxisEnd, float cylinderRadius);
+    // The two halves of a cut. sliceGeometry only reads the meshes and runs on any
+    // thread, one output entry per mesh; replaceGeometry uploads the result on the
+    // GL thread and swaps it in, releasing the old buffers and dropping meshes that
+    // were cut away entirely. Cylinders are in model space; meshTransforms (from
+    // getMeshTransforms, taken on the GL thread) carries them into each mesh's node.
+    void sliceGeometry(const SliceCylinder* cylinders, size_t cylinderCount,
+                       vector<vector<Vertex>>& slicedVertices, vector<vector<unsigned int>>& slicedIndices,
+                       const glm::mat4* meshTransforms = nullptr) const;
+    void replaceGeometry(vector<vector<Vertex>>& slicedVertices, vector<vector<unsigned int>>& slicedIndices);
 
     enum {
         NUMDIM = 3,
@@ -58,13 +115,23 @@ public:
     };
 
     bool HitBoundingBox(const glm::vec3& minB, const glm::vec3& maxB, const glm::vec3& origin, const glm::vec3& dir, glm::vec3& coord);
-    glm::vec3 getBoundingBoxMin() const;
-    glm::vec3 getBoundingBoxMax() const;
+    // cached; recomputed on load and on replaceGeometry, call updateBounds after editing meshes directly
+    glm::vec3 getBoundingBoxMin() const { return boundsMin; }
+    glm::vec3 getBoundingBoxMax() const { return boundsMax; }
+    void updateBounds();
+    // mesh to model space for every mesh; false and empty when all meshes sit at the root
+    bool getMeshTransforms(vector<glm::mat4>& transforms);
 
 private:
-    void loadModel(string const &path);
-    void processNode(aiNode *node, const aiScene *scene);
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+
+    void loadModel(string const &path, ImportProfile profile);
+    void processNodes(const aiScene *scene);
     Mesh processMesh(aiMesh *mesh, const aiScene *scene);
+    void processAnimations(const aiScene *scene);
+    // bone names to indices into bones while loading
+    unordered_map<string, unsigned int> boneIndices;
     vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName);
 };
 
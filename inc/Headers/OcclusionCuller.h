@@ -0,0 +1,92 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <vector>
+
+#include "Mesh.h"
+
+class Model;
+
+// what the last render() and the tests since did
+struct OcclusionStats {
+    size_t occluderTriangles = 0;
+    // front facing, in front of the near plane and on screen
+    size_t rasterizedTriangles = 0;
+    double rasterMilliseconds = 0.0;
+    size_t tested = 0;
+    size_t culled = 0;
+};
+
+// Software occlusion culling on the CPU. A few large occluders are
+// rasterized into a small depth buffer, bands of rows in parallel on the job
+// system, 8 pixels at a time with AVX2 (build with -mavx2), 4 with SSE2 and
+// one at a time elsewhere. Objects then test their world AABB against it
+// before they are drawn. The buffer holds the nearest 1/w of any occluder per
+// pixel, which interpolates linearly across the screen. Back faces and
+// triangles crossing the near plane are left out, as GL culls the former, so
+// the buffer only ever hides less than the GPU would.
+class OcclusionCuller {
+public:
+    explicit OcclusionCuller(unsigned int width = 256, unsigned int height = 128);
+
+    // meshes of model reaching minExtent along an axis and not skinned, the ones worth rasterizing
+    static void selectOccluders(const Model& model, float minExtent, std::vector<unsigned int>& meshes);
+
+    // starts a frame; occluders are added afterwards and kept by pointer until render()
+    void beginFrame(const glm::mat4& viewProjection);
+    // triangle list with positions strideBytes apart, placed by matrix
+    void addOccluder(const glm::vec3* positions, size_t strideBytes, const unsigned int* indices, size_t indexCount,
+                     const glm::mat4& matrix);
+    void addOccluder(const Mesh& mesh, const glm::mat4& matrix) {
+        if (!mesh.vertices.empty())
+            addOccluder(&mesh.vertices[0].Position, sizeof(Vertex), mesh.indices.data(), mesh.indices.size(), matrix);
+    }
+    // rasterizes the frame's occluders; the GL thread waits for it
+    void render();
+
+    // false when the world AABB is hidden behind the occluders of the last render()
+    bool isVisible(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+    const OcclusionStats& getStats() const { return stats; }
+    // nearest 1/w per pixel, rows getStride() floats apart, bottom row first; 0 where nothing was drawn
+    const float* getDepth() const { return depth.data(); }
+    unsigned int getWidth() const { return width; }
+    unsigned int getHeight() const { return height; }
+    unsigned int getStride() const { return stride; }
+    // pixels per SIMD step of this build
+    static unsigned int getLaneCount();
+
+private:
+    struct Occluder {
+        const glm::vec3* positions;
+        size_t strideBytes;
+        const unsigned int* indices;
+        size_t triangleCount;
+        glm::mat4 matrix;
+        // first triangle in setups
+        size_t firstTriangle;
+    };
+
+    // a triangle ready for any band: edge and depth planes over pixel centers
+    struct TriangleSetup {
+        float edgeA[3], edgeB[3], edgeC[3];
+        float depthA, depthB, depthC;
+        // pixel bounds, inclusive; minY > maxY when it is not drawn
+        int minX, maxX, minY, maxY;
+    };
+
+    // triangles [begin, end) across all occluders
+    void setupTriangles(size_t begin, size_t end);
+    void rasterizeBand(unsigned int firstRow, unsigned int endRow);
+
+    unsigned int width;
+    unsigned int height;
+    unsigned int stride;
+    glm::mat4 viewProjection;
+    std::vector<float> depth;
+    std::vector<Occluder> occluders;
+    std::vector<TriangleSetup> setups;
+    size_t triangleCount;
+    OcclusionStats stats;
+};
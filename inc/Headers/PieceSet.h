@@ -0,0 +1,44 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+
+#include "Drawer.h"
+#include "IslandFinder.h"
+#include "SceneIndex.h"
+
+// Islands cut off a model, each a model and drawer of its own, so they can be
+// culled and moved independently of the original. Their drawers are dynamic
+// entries of the scene index, which culls and draws them with the rest.
+// The set is capped: past MAX_PIECES the oldest piece is released, which keeps
+// GPU and CPU memory bounded however many cuts a session makes.
+class PieceSet {
+public:
+    static const size_t MAX_PIECES = 128;
+
+    PieceSet(Shader& shader, SceneIndex& sceneIndex) : shader(shader), sceneIndex(sceneIndex) {}
+    ~PieceSet() { clear(); }
+
+    // GL thread; the piece keeps the parent's current transform and textures
+    void spawn(IslandGeometry& island, const Model& parent, const Drawer& parentDrawer);
+    void clear();
+
+    size_t size() const { return pieces.size(); }
+    Drawer& getDrawer(size_t i) { return *pieces[i].drawer; }
+
+private:
+    PieceSet(const PieceSet&);
+    PieceSet& operator=(const PieceSet&);
+
+    struct Piece {
+        std::unique_ptr<Model> model;
+        std::unique_ptr<Drawer> drawer;
+    };
+
+    void release(Piece& piece);
+
+    Shader& shader;
+    SceneIndex& sceneIndex;
+    std::vector<Piece> pieces;
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <glad.h>
+#include <glm/glm.hpp>
+#include <functional>
+
+#include "Frustum.h"
+#include "shader_m.h"
+
+// Texture units of the two shadow cubes, clear of the lights, clusters and bone palette
+const unsigned int SHADOW_STATIC_TEXTURE_UNIT = 12;
+const unsigned int SHADOW_DYNAMIC_TEXTURE_UNIT = 13;
+
+// Cube shadow map of one point light, kept as two cubes. Static casters are
+// rendered into a cached cube only when the light moves or invalidateStatic()
+// is called; dynamic casters go into a second cube every frame, each drawn
+// only into the faces whose frustum it touches. Shading takes the nearer of
+// the two depths. Depths are distances to the light over its range.
+class PointShadowMap {
+public:
+    // draws the casters of one cube face, culled against the face's frustum
+    typedef std::function<void(Shader& shader, const Frustum& face)> DrawCasters;
+
+    explicit PointShadowMap(unsigned int resolution = 1024);
+    ~PointShadowMap();
+
+    // light is the shadowed light's index in the LightBuffer
+    void setLight(int light, const glm::vec3& position, float range);
+    // static casters moved or changed shape
+    void invalidateStatic();
+
+    // leaves the framebuffer unbound and the viewport at the cube size
+    void render(const DrawCasters& drawStatic, const DrawCasters& drawDynamic);
+    // the shading programs (lighting, clustered, deferred light) before drawing
+    void bind(Shader& shader) const;
+    // points the samplers at their units with shadows off, for programs drawn before the first bind
+    static void bindDisabled(Shader& shader);
+
+    // the depth pass program, for AnimationSystem::bind
+    Shader& getShader() { return depthShader; }
+    // times the static cube was rerendered
+    unsigned int getStaticRenderCount() const { return staticRenders; }
+
+private:
+    PointShadowMap(const PointShadowMap&);
+    PointShadowMap& operator=(const PointShadowMap&);
+
+    unsigned int createCube();
+    void renderCube(unsigned int cube, const DrawCasters& drawCasters);
+
+    unsigned int resolution;
+    unsigned int fbo;
+    unsigned int staticCube;
+    unsigned int dynamicCube;
+
+    int light;
+    glm::vec3 position;
+    float range;
+    bool staticValid;
+    unsigned int staticRenders;
+
+    glm::mat4 faceMatrices[6];
+    Frustum faceFrusta[6];
+    Shader depthShader;
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "shader_m.h"
+#include "GpuTimer.h"
+
+// HDR scene target plus the bloom and tonemapping chain applied on top of it.
+// Bloom thresholds into a half resolution mip, walks down the chain with a
+// 13-tap filter and back up with a 9-tap tent, so every pixel costs a handful
+// of taps per level instead of a wide separable Gaussian at full resolution.
+class PostProcess {
+public:
+    PostProcess(unsigned int width, unsigned int height, unsigned int bloomMips);
+    ~PostProcess();
+
+    // only called from the framebuffer resize listener; targets are otherwise reused every frame
+    void resize(unsigned int width, unsigned int height);
+
+    // binds and clears the RGBA16F scene target
+    void beginScene();
+    unsigned int getSceneFBO() const { return sceneFBO; }
+    unsigned int getSceneDepthTexture() const { return sceneDepth; }
+
+    // bloom + tonemap into targetFBO
+    void apply(float bloomStrength, float bloomThreshold, float exposure, unsigned int targetFBO = 0);
+
+    enum Pass {
+        PASS_PREFILTER,
+        PASS_DOWNSAMPLE,
+        PASS_UPSAMPLE,
+        PASS_TONEMAP,
+        PASS_COUNT
+    };
+    static const char* passName(int pass);
+    // GPU time of the last finished frame, from timer queries
+    double getPassMilliseconds(int pass) { return timers[pass].lastMilliseconds(); }
+
+private:
+    PostProcess(const PostProcess&);
+    PostProcess& operator=(const PostProcess&);
+
+    void createTargets();
+    void destroyTargets();
+    void drawFullscreen();
+
+    unsigned int width;
+    unsigned int height;
+    unsigned int requestedMips;
+
+    unsigned int sceneFBO;
+    unsigned int sceneColor;
+    unsigned int sceneDepth;
+
+    unsigned int bloomFBO;
+    std::vector<unsigned int> bloomTextures;
+    std::vector<glm::ivec2> bloomSizes;
+
+    unsigned int fullscreenVAO;
+
+    Shader downsampleShader;
+    Shader upsampleShader;
+    Shader tonemapShader;
+
+    GpuTimer timers[PASS_COUNT];
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <glad.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "Trace.h"
+
+// Frame profiler for the render thread. Named scopes record CPU time from a
+// high resolution clock and GPU time from timestamp queries. Queries are
+// double buffered: a frame's results are read back two frames later, when
+// the GPU has long finished with them, so profiling never stalls the pipeline.
+class Profiler {
+public:
+    static void beginFrame();
+    static void endFrame();
+
+    // scopes must nest and are ignored outside beginFrame/endFrame;
+    // use PROFILE_SCOPE rather than calling these directly
+    static void beginScope(const char* name);
+    static void endScope();
+
+    // hierarchical table and frame time graph, call between ImGui::NewFrame and ImGui::Render
+    static void drawWindow();
+
+    struct Result {
+        const char* name;
+        int depth;
+        double cpuMilliseconds;
+        double gpuMilliseconds;
+    };
+    static const std::vector<Result>& getResults() { return results; }
+
+private:
+    typedef std::chrono::high_resolution_clock Clock;
+
+    struct Scope {
+        const char* name;
+        int depth;
+        Clock::time_point cpuBegin;
+        Clock::time_point cpuEnd;
+        unsigned int gpuBegin;
+        unsigned int gpuEnd;
+    };
+
+    struct Frame {
+        std::vector<Scope> scopes;
+        std::vector<unsigned int> queries;
+        unsigned int queriesUsed;
+        bool recorded;
+        // history slot of the frame the queries were recorded in; resolve() runs
+        // FRAMES_IN_FLIGHT frames later, when historyOffset has moved on
+        int historySlot;
+        Frame() : queriesUsed(0), recorded(false), historySlot(0) {}
+    };
+
+    static const int FRAMES_IN_FLIGHT = 2;
+    static const int HISTORY_SIZE = 240;
+
+    static unsigned int nextQuery(Frame& frame);
+    static void resolve(Frame& frame);
+
+    static Frame frames[FRAMES_IN_FLIGHT];
+    static int currentFrame;
+    static bool inFrame;
+    static std::vector<GLuint64> timestamps;
+    static std::vector<int> stack;
+    static std::vector<Result> results;
+    static Clock::time_point lastFrameStart;
+    static float cpuHistory[HISTORY_SIZE];
+    static float gpuHistory[HISTORY_SIZE];
+    static int historyOffset;
+};
+
+struct ProfileScope {
+    explicit ProfileScope(const char* name) { Profiler::beginScope(name); }
+    ~ProfileScope() { Profiler::endScope(); }
+};
+
+// profiled scopes also show up in the CPU trace
+#define PROFILE_SCOPE(name) TRACE_SCOPE(name); ProfileScope TRACE_CONCAT(profileScope, __LINE__)(name)
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// Node hierarchy of a model, as imported from the file's aiNode tree. Nodes
+// are stored breadth first in flat arrays, so every parent comes before its
+// children and the children of a node sit next to each other. A node keeps
+// its local transform and its transform relative to the model root. Setting a
+// local transform marks the node dirty, and update() rebuilds only the dirty
+// nodes and their descendants in a single forward pass, starting at the
+// first dirty node.
+class SceneGraph {
+public:
+    static const int NO_PARENT = -1;
+    // for meshes that do not follow a node (skinned ones follow their bones)
+    static const unsigned int NO_NODE = ~0u;
+
+    SceneGraph() : firstDirty(NOTHING_DIRTY), offsetNodes(0) {}
+
+    // parent must already exist (breadth-first order), NO_PARENT for the root
+    unsigned int addNode(int parent, const std::string& name, const glm::mat4& local);
+    void clear();
+
+    size_t size() const { return parents.size(); }
+    int getParent(unsigned int node) const { return parents[node]; }
+    const std::string& getName(unsigned int node) const { return names[node]; }
+    // first node with the name, -1 if there is none
+    int find(const std::string& name) const;
+
+    const glm::mat4& getLocal(unsigned int node) const { return locals[node]; }
+    void setLocal(unsigned int node, const glm::mat4& local);
+
+    // relative to the model root and only valid after update(); nodes outside
+    // the graph (meshes of a model built by hand) count as the root itself
+    glm::mat4 getWorld(unsigned int node) const { return node < worlds.size() ? worlds[node] : glm::mat4(1.0f); }
+    glm::mat3 getWorldNormal(unsigned int node) const { return node < worlds.size() ? worldNormals[node] : glm::mat3(1.0f); }
+    bool isIdentity(unsigned int node) const { return node >= worlds.size() || identity[node]; }
+    // every node at the model root, so nothing needs per-node matrices
+    bool isFlat() const { return offsetNodes == 0; }
+
+    // returns the number of nodes whose world transform was rebuilt
+    size_t update();
+
+private:
+    static const size_t NOTHING_DIRTY = ~size_t(0);
+
+    std::vector<int> parents;
+    std::vector<std::string> names;
+    std::vector<glm::mat4> locals;
+    std::vector<glm::mat4> worlds;
+    std::vector<glm::mat3> worldNormals;
+    std::vector<unsigned char> identity;
+    std::vector<unsigned char> dirty;
+    size_t firstDirty;
+    // nodes whose world transform is not the identity
+    size_t offsetNodes;
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+#include "Drawer.h"
+#include "FrameAllocator.h"
+#include "Frustum.h"
+#include "SpatialIndex.h"
+
+// The world bounds of every drawer in the scene, in one SpatialIndex. update()
+// moves the drawers whose matrices TransformSystem rebuilt, so culling and the
+// laser query the tree instead of testing each drawer's box. Drawers must be
+// removed before they are destroyed. Main thread only.
+class SceneIndex {
+public:
+    // what a drawer is to the passes, queries take a mask of these
+    enum Layer : uint32_t {
+        // the level: drawn opaque, a cached shadow caster and the occluder
+        STATIC = 1u << 0,
+        // drawn opaque and redrawn into the shadows every frame
+        DYNAMIC = 1u << 1,
+        // drawn by its own pass, but casts shadows like a dynamic drawer
+        EFFECT = 1u << 2
+    };
+
+    SceneIndex() {}
+
+    void add(Drawer& drawer, uint32_t layer);
+    void remove(Drawer& drawer);
+    // once a frame after TransformSystem::update()
+    void update();
+    // after the drawer's model changed its bounds without a transform change
+    void refresh(Drawer& drawer);
+
+    // drawers in any of the layers whose bounds touch the frustum
+    void queryFrustum(const Frustum& frustum, uint32_t layers, FrameVector<Drawer*>& drawers) const;
+    // drawers in any of the layers whose bounds the ray passes, in no particular order
+    void queryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, uint32_t layers,
+                  FrameVector<Drawer*>& drawers) const;
+    uint32_t getLayer(const Drawer& drawer) const;
+    size_t getCount() const { return index.getCount(); }
+
+private:
+    SceneIndex(const SceneIndex&);
+    SceneIndex& operator=(const SceneIndex&);
+
+    struct Entry {
+        Drawer* drawer;
+        uint32_t layer;
+        SpatialHandle handle;
+        // of the bounds, to pass the motion to SpatialIndex::move
+        glm::vec3 center;
+    };
+
+    void move(uint32_t slot);
+
+    SpatialIndex index;
+    std::vector<Entry> entries;
+    std::vector<uint32_t> freeEntries;
+    // entry slot per transform handle
+    std::vector<uint32_t> entryOfTransform;
+};
@@ -25,7 +25,26 @@
 #include "camera.h"
 #include "shader_m.h"
 #include "Drawer.h"
+#include "Animator.h"
 #include "InputManager.h"
+#include "InputRecorder.h"
+#include "Simulation.h"
+#include "JobSystem.h"
+#include "FrameAllocator.h"
+#include "SliceWorker.h"
+#include "PieceSet.h"
+#include "SceneIndex.h"
+#include "Light.h"
+#include "DeferredRenderer.h"
+#include "PointShadowMap.h"
+#include "CascadedShadowMap.h"
+#include "OcclusionCuller.h"
+#include "InstancedModel.h"
+#include "ClusteredLighting.h"
+#include "PostProcess.h"
+#include "Profiler.h"
+#include "Benchmark.h"
+#include "Headless.h"
 
 // Standard Library
 #include <iostream>
@@ -33,7 +52,10 @@
 
 class Setup {
 public:
-    static GLFWwindow* initializeWindow(unsigned int SCR_WIDTH, unsigned int SCR_HEIGHT, Camera& camera);
+    // visible = false creates a hidden window that only provides the GL context (headless runs);
+    // preferGL43 asks for a 4.3 core context first and settles for 3.3 where there is none
+    static GLFWwindow* initializeWindow(unsigned int SCR_WIDTH, unsigned int SCR_HEIGHT, Camera& camera, bool visible = true,
+                                        bool preferGL43 = false);
     static void initializeGLAD();
     static void initializeImGui(GLFWwindow* window);
     static void setupOpenGLState();
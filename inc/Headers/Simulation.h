@@ -0,0 +1,87 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "camera.h"
+#include "FrameAllocator.h"
+#include "InputManager.h"
+
+// Snapshot of everything the renderer reads from the simulation
+struct SimState {
+    glm::vec3 cameraPosition;
+    float yaw;
+    float pitch;
+    float zoom;
+    float laserTimer;
+};
+
+// Laser ray in world space that hit its check interval; the cut itself
+// uploads meshes, so it is carried out on the render thread
+struct SliceRequest {
+    glm::vec3 start;
+    glm::vec3 direction;
+};
+
+// Camera and laser simulation at a fixed rate, independent of the frame rate.
+// Single threaded, update() runs as many fixed steps as the frame time covers
+// (at most MAX_STEPS, so a slow frame cannot snowball) and the remainder
+// becomes the interpolation factor between the last two states. Threaded, a
+// simulation thread steps on its own clock and the renderer interpolates by
+// how far wall time has moved past the newest state.
+class Simulation {
+public:
+    static const int MAX_STEPS = 5;
+
+    Simulation(const Camera& camera, float laserDuration, float stepSeconds, bool threaded);
+    ~Simulation();
+
+    // main thread, once per rendered frame; merged into the input of the next step
+    void submitInput(const InputFrame& frame);
+    // single threaded only, advances by frameTime
+    void update(float frameTime);
+
+    // state between the previous and the newest step, written into the render camera
+    SimState interpolated(Camera& camera);
+    // cuts requested since the last call
+    void takeSliceRequests(FrameVector<SliceRequest>& requests);
+
+    float getStep() const { return step; }
+    // simulated seconds
+    double getTime();
+
+private:
+    Simulation(const Simulation&);
+    Simulation& operator=(const Simulation&);
+
+    typedef std::chrono::steady_clock Clock;
+
+    void runStep();
+    SimState capture() const;
+    void threadLoop();
+
+    Camera camera;
+    float laserTimer;
+    float laserDuration;
+    float step;
+
+    double time;
+    double lastSliceCheck;
+    float accumulator;
+
+    std::mutex mutex;
+    InputFrame pending;
+    uint32_t latestKeys;
+    SimState previous;
+    SimState current;
+    Clock::time_point currentWallTime;
+    std::vector<SliceRequest> sliceRequests;
+
+    bool threaded;
+    std::atomic<bool> quit;
+    std::thread thread;
+};
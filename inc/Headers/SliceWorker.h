@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Model.h"
+#include "Drawer.h"
+#include "IslandFinder.h"
+#include "PieceSet.h"
+#include "JobSystem.h"
+
+// Cuts a model in the background. The model's meshes stay the front buffer and
+// keep drawing while a job cuts their geometry into the back buffer; update()
+// swaps the result in at a frame boundary. Cuts submitted while a job runs are
+// coalesced and removed together by the next job in a single pass. When a
+// cut splits the model apart, the largest island stays in the model and every
+// other island is spawned into pieces with the drawer's transform. The job's
+// scratch comes from the frame arena, which the worker holds while it runs.
+//
+// When and how cuts coalesce depends on how fast the job runs, so a replay
+// sets a fixed latency instead: each batch is waited for and swapped in that
+// many frames after it started, and the next batch takes every cut submitted
+// meanwhile, which gives the same geometry on every run.
+// All methods belong to the main (GL) thread.
+class SliceWorker {
+public:
+    // islands below this are debris and vanish with the cut
+    static const size_t MIN_ISLAND_TRIANGLES = 16;
+    // frames from a replayed cut to its result
+    static const unsigned int REPLAY_LATENCY_FRAMES = 2;
+
+    SliceWorker(Drawer& drawer, PieceSet& pieces);
+    // waits for a running job, it reads the model
+    ~SliceWorker();
+
+    void submit(const SliceCylinder& cut);
+    // 0, the default, swaps a cut in at the first update() after its job finished
+    void setFixedLatency(unsigned int frames) { fixedLatency = frames; }
+    // once a frame: uploads a finished cut and starts the next batch; true when the meshes changed
+    bool update();
+    bool isBusy() const { return busy; }
+
+private:
+    SliceWorker(const SliceWorker&);
+    SliceWorker& operator=(const SliceWorker&);
+
+    static void sliceJob(void* data, size_t begin, size_t end);
+
+    Drawer& drawer;
+    Model& model;
+    PieceSet& pieces;
+    std::vector<IslandGeometry> islands;
+    size_t islandCount;
+    std::vector<SliceCylinder> pending;
+    std::vector<SliceCylinder> running;
+    // the model's mesh transforms when the batch started, empty when flat
+    std::vector<glm::mat4> meshTransforms;
+    std::vector<std::vector<Vertex>> slicedVertices;
+    std::vector<std::vector<unsigned int>> slicedIndices;
+
+    Job job;
+    JobCounter counter;
+    bool busy;
+    unsigned int fixedLatency;
+    // update() calls so far, and the one that swaps the running batch in under a fixed latency
+    uint64_t frame;
+    uint64_t readyFrame;
+};
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Frustum.h"
+
+typedef uint32_t SpatialHandle;
+const SpatialHandle INVALID_SPATIAL = 0xffffffffu;
+
+// a ray for the batched query, hits count up to maxDistance along direction
+struct SpatialRay {
+    glm::vec3 origin;
+    glm::vec3 direction;
+    float maxDistance;
+};
+
+struct SpatialHit {
+    uint32_t value;
+    // index into the batch, 0 for a single ray
+    unsigned int ray;
+    // where the ray enters the object's loose box, in units of direction
+    float distance;
+};
+
+// Dynamic AABB tree (a BVH built incrementally) over the world bounds of
+// scene objects. Each object sits in a leaf under a loose box, its bounds
+// grown by margin, so moving it within that box costs one containment test;
+// only when it leaves the box is the leaf taken out and reinserted where its
+// surface area grows the tree least. The parents above an insertion or
+// removal are refit on the way up and rotated AVL style wherever one child
+// is more than a level taller than the other, which keeps the depth
+// logarithmic for any order of insertions.
+//
+// Queries report the values given at insert() of every object whose loose
+// box passes the test, so they may return a little more than the exact
+// bounds would, never less. The batched queries walk the tree once for
+// several frusta or rays, each node tested only against those its parent
+// still touched. Not thread safe for updates; queries may run in parallel.
+class SpatialIndex {
+public:
+    explicit SpatialIndex(float margin = 0.1f);
+
+    SpatialHandle insert(const glm::vec3& boundsMin, const glm::vec3& boundsMax, uint32_t value);
+    void remove(SpatialHandle handle);
+    // new world bounds of the object; true when it left its loose box and was
+    // reinserted. displacement, its motion since the last call, stretches the
+    // new loose box ahead of it so a steady mover reinserts less often
+    bool move(SpatialHandle handle, const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+              const glm::vec3& displacement = glm::vec3(0.0f));
+    void clear();
+
+    uint32_t getValue(SpatialHandle handle) const { return nodes[handle].value; }
+    void getLooseBounds(SpatialHandle handle, glm::vec3& boundsMin, glm::vec3& boundsMax) const;
+    size_t getCount() const { return count; }
+    // levels below the root, 0 for a single object
+    int getHeight() const;
+
+    // the query results replace what values or hits held; the single result
+    // queries take a std::vector or a FrameVector for per-frame results
+    template <typename Allocator>
+    void queryBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax, std::vector<uint32_t, Allocator>& values) const;
+    template <typename Allocator>
+    void querySphere(const glm::vec3& center, float radius, std::vector<uint32_t, Allocator>& values) const;
+    template <typename Allocator>
+    void queryFrustum(const Frustum& frustum, std::vector<uint32_t, Allocator>& values) const;
+    // up to 32 frusta in one traversal (the faces of a cube shadow, cascades);
+    // masks[i] has bit f set when values[i] touches frusta[f]
+    void queryFrusta(const Frustum* frusta, unsigned int frustumCount, std::vector<uint32_t>& values,
+                     std::vector<uint32_t>& masks) const;
+    // hits in traversal order, not sorted by distance
+    template <typename Allocator>
+    void queryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+                  std::vector<SpatialHit, Allocator>& hits) const;
+    // up to 32 rays in one traversal
+    void queryRays(const SpatialRay* rays, unsigned int rayCount, std::vector<SpatialHit>& hits) const;
+
+private:
+    static const int NO_NODE = -1;
+
+    struct Node {
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+        // the next free node while on the free list
+        int parent;
+        int child1;
+        int child2;
+        // 0 for leaves, -1 while free
+        int height;
+        uint32_t value;
+
+        bool isLeaf() const { return child1 == NO_NODE; }
+    };
+
+    int allocateNode();
+    void freeNode(int node);
+    void insertLeaf(int leaf);
+    void removeLeaf(int leaf);
+    // rotates the taller child of node up when the heights differ by more than one; returns the subtree's new root
+    int balance(int node);
+    // bounds and height of node from its children, up to the root
+    void refitFrom(int node);
+
+    float margin;
+    std::vector<Node> nodes;
+    int root;
+    int freeList;
+    size_t count;
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// CPU event capture in Chrome trace-event format, for chrome://tracing or
+// Perfetto. Every thread appends complete events to its own ring of chunks,
+// so recording takes no locks and costs two clock reads plus a store. Once
+// a thread's ring is full its oldest chunk is recycled, so a dump always
+// holds the most recent events of a long session. write() reads the rings
+// while other threads keep recording and skips a chunk that was recycled
+// under it.
+//
+// Build with -DENGINE_NO_TRACE to compile every TRACE_* macro out.
+class Trace {
+public:
+    static uint64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // name must outlive the trace, in practice a string literal
+    static void record(const char* name, uint64_t beginNs, uint64_t endNs);
+    static void setThreadName(const char* name);
+
+    // dumps every event still in the rings as trace-event JSON
+    static bool write(const std::string& path);
+    // events overwritten by newer ones since the start
+    static size_t droppedEvents();
+
+private:
+    // 4096 events per chunk, a ring of at most 64 chunks (~6 MB) per thread
+    static const unsigned int CHUNK_EVENTS = 4096;
+    static const unsigned int MAX_CHUNKS = 64;
+
+    struct Event {
+        const char* name;
+        uint64_t begin;
+        uint64_t duration;
+    };
+
+    // an Event as the ring holds it; write() may read a slot while record()
+    // overwrites it, so the fields are relaxed atomics (plain moves on x86)
+    struct EventSlot {
+        std::atomic<const char*> name;
+        std::atomic<uint64_t> begin;
+        std::atomic<uint64_t> duration;
+    };
+
+    // a seqlock: sequence counts the chunks a thread has filled and changes,
+    // fenced, before a recycled chunk's events are overwritten; write() copies
+    // the events and keeps them only if the sequence still matches afterwards
+    struct Chunk {
+        EventSlot events[CHUNK_EVENTS];
+        std::atomic<unsigned int> count;
+        std::atomic<uint64_t> sequence;
+        Chunk() : count(0), sequence(0) {}
+    };
+
+    // chunk sequence s lives in ring[s % MAX_CHUNKS]
+    struct ThreadBuffer {
+        std::atomic<Chunk*> ring[MAX_CHUNKS];
+        std::atomic<uint64_t> tailSequence;
+        unsigned int id;
+        std::atomic<const char*> name;
+        std::atomic<size_t> dropped;
+        ThreadBuffer* next;
+    };
+
+    static ThreadBuffer* threadBuffer();
+
+    static std::atomic<ThreadBuffer*> buffers;
+    static std::atomic<unsigned int> nextThreadId;
+};
+
+struct TraceScope {
+    explicit TraceScope(const char* name) : name(name), begin(Trace::now()) {}
+    ~TraceScope() { Trace::record(name, begin, Trace::now()); }
+    const char* name;
+    uint64_t begin;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#ifdef ENGINE_NO_TRACE
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#else
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_THREAD_NAME(name) Trace::setThreadName(name)
+#endif
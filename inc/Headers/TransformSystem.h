@@ -0,0 +1,59 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+
+#include "FrameAllocator.h"
+
+enum class RotationMode {
+    NONE,
+    Y_ONLY,
+    ALL
+};
+
+typedef uint32_t TransformHandle;
+const TransformHandle INVALID_TRANSFORM = 0xffffffffu;
+
+// Structure-of-arrays store for object transforms. Positions, rotations
+// (quaternions) and scales each live in their own float arrays, world
+// matrices are cached, and a dirty bit per transform records what changed
+// since its matrix was built. Setters only write and flag; update() rebuilds
+// the dirty matrices four at a time with SSE, spread over the job system,
+// and a lone getWorldMatrix() on a dirty transform rebuilds just that one.
+//
+// The world matrix is translate * rotation * look-at * scale, with the
+// rotation given as X, Y then Z Euler degrees and the look-at turning the
+// object's +Z towards its target (yaw only or yaw and pitch).
+//
+// Main thread only, except that update() fans out to workers internally.
+class TransformSystem {
+public:
+    static TransformHandle create();
+    static void destroy(TransformHandle handle);
+    // avoids regrowing the arrays while many transforms are created
+    static void reserve(size_t count);
+
+    static void setPosition(TransformHandle handle, const glm::vec3& position);
+    static void setScale(TransformHandle handle, const glm::vec3& scale);
+    static void setRotation(TransformHandle handle, const glm::vec3& eulerDegrees);
+    static void setRotationMode(TransformHandle handle, RotationMode mode);
+    static void setTarget(TransformHandle handle, const glm::vec3& target);
+
+    static glm::vec3 getPosition(TransformHandle handle);
+    static glm::vec3 getScale(TransformHandle handle);
+    static glm::vec3 getRotation(TransformHandle handle);
+    static RotationMode getRotationMode(TransformHandle handle);
+    static glm::vec3 getTarget(TransformHandle handle);
+
+    // rebuilds every dirty matrix, once a frame after the simulation has moved things
+    static void update();
+    static glm::mat4 getWorldMatrix(TransformHandle handle);
+
+    // live transforms, and matrices rebuilt by the last update()
+    static size_t getCount();
+    static size_t getLastUpdateCount();
+    // every transform whose matrix was rebuilt since the last call, by update()
+    // or a lone getWorldMatrix(), so bounds kept elsewhere can follow
+    static void takeMoved(FrameVector<TransformHandle>& handles);
+};
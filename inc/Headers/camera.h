@@ -24,6 +24,8 @@ const float PITCH       =  0.0f;
 const float SPEED       =  2.5f;
 const float SENSITIVITY =  0.1f;
 const float ZOOM        =  45.0f;
+const float NEAR_PLANE  =  0.1f;
+const float FAR_PLANE   =  100.0f;
 
 class Camera {
 public:
@@ -62,6 +64,11 @@ public:
     // set the fixed height for FPS-style camera
     void setHeight(float height);
 
+    // places the camera and points it at target, used by scripted camera paths
+    void lookAt(const glm::vec3& position, const glm::vec3& target);
+    // sets the euler angles directly, used when interpolating between simulation states
+    void setOrientation(float yaw, float pitch);
+
 private:
     // calculates the front vector from the Camera's (updated) Euler Angles
     void updateCameraVectors();
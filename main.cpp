@@ -1,6 +1,37 @@
 #include "Setup.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+// command line
+struct EngineOptions {
+  bool benchLights = false;
+  bool benchJobs = false;
+  bool benchCut = false;
+  bool benchTransforms = false;
+  bool benchAnimation = false;
+  bool benchOcclusion = false;
+  bool benchSpatial = false;
+  bool headless = false;
+  HeadlessOptions headlessOptions;
+  std::string tracePath;
+  std::string recordPath;
+  std::string replayPath;
+  bool simThread = false;
+  float simRate = 60.0f;
+  bool occlusion = true;
+  bool sun = false;
+  unsigned int cascades = 3;
+  unsigned int instances = 0;
+  bool gpuCulling = false;
+  ImportProfile sceneImport = ImportProfile::MERGED;
+};
+
+int runEngine(GLFWwindow* window, const EngineOptions& options);
 void shaderViewSetup(Shader shader);
+glm::vec3 eyeballPosition(int index);
 
 // settings:
 unsigned int SCR_WIDTH = 1600;
@@ -22,20 +53,17 @@ glm::vec3 lightPos(0.0f, 3.0f, 0.0f);
 
 glm::vec3 girlpos = glm::vec3(0.0f);
 int currentEyeballs = 5;
-bool showMenu = false;
 bool shoot = false;
 
 // Laser properties
 glm::vec3 laserStart;
 glm::vec3 laserColor = glm::vec3(1.0f, 0.0f, 0.0f);
 float laserDuration = 0.2f;
+// render-side copy, the simulation owns the countdown
 float laserTimer = 0.0f;
 
 bool isSpacePressed = false;
 
-float sliceCheckInterval = 0.1f;
-float lastSliceCheck = 0.0f;
-
 // Bloom settings
 const unsigned int BLOOM_MIPS = 5;
 float bloomStrength = 2.0f;
@@ -43,15 +71,106 @@ float bloomThreshold = 0.8f;
 float exposure = 0.8f;
 
 bool vsyncEnabled = true;
-int main() {
+int main(int argc, char** argv) {
+  EngineOptions options;
+  HeadlessOptions& headlessOptions = options.headlessOptions;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--bench-lights") == 0)
+      options.benchLights = true;
+    else if (std::strcmp(argv[i], "--bench-jobs") == 0)
+      options.benchJobs = true;
+    else if (std::strcmp(argv[i], "--bench-cut") == 0)
+      options.benchCut = true;
+    else if (std::strcmp(argv[i], "--bench-transforms") == 0)
+      options.benchTransforms = true;
+    else if (std::strcmp(argv[i], "--bench-animation") == 0)
+      options.benchAnimation = true;
+    else if (std::strcmp(argv[i], "--bench-occlusion") == 0)
+      options.benchOcclusion = true;
+    else if (std::strcmp(argv[i], "--bench-spatial") == 0)
+      options.benchSpatial = true;
+    else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+      options.tracePath = argv[++i];
+    else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+      options.recordPath = argv[++i];
+    else if (std::strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+      options.replayPath = argv[++i];
+    else if (std::strcmp(argv[i], "--sim-thread") == 0)
+      options.simThread = true;
+    else if (std::strcmp(argv[i], "--sim-hz") == 0 && i + 1 < argc)
+      options.simRate = std::max(1.0f, static_cast<float>(std::atof(argv[++i])));
+    else if (std::strcmp(argv[i], "--headless") == 0)
+      options.headless = true;
+    else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+      headlessOptions.frames = std::atoi(argv[++i]);
+    else if (std::strcmp(argv[i], "--warmup") == 0 && i + 1 < argc)
+      headlessOptions.warmupFrames = std::atoi(argv[++i]);
+    else if (std::strcmp(argv[i], "--camera-path") == 0 && i + 1 < argc)
+      headlessOptions.cameraPath = argv[++i];
+    else if (std::strcmp(argv[i], "--stats") == 0 && i + 1 < argc)
+      headlessOptions.statsPath = argv[++i];
+    else if (std::strcmp(argv[i], "--snapshots") == 0 && i + 1 < argc)
+      headlessOptions.snapshotDir = argv[++i];
+    else if (std::strcmp(argv[i], "--snapshot-every") == 0 && i + 1 < argc)
+      headlessOptions.snapshotInterval = std::atoi(argv[++i]);
+    else if (std::strcmp(argv[i], "--require-no-alloc") == 0)
+      headlessOptions.requireNoAllocations = true;
+    else if (std::strcmp(argv[i], "--no-occlusion") == 0)
+      options.occlusion = false;
+    else if (std::strcmp(argv[i], "--sun") == 0)
+      options.sun = true;
+    else if (std::strcmp(argv[i], "--cascades") == 0 && i + 1 < argc)
+      options.cascades = static_cast<unsigned int>(std::max(2, std::atoi(argv[++i])));
+    else if (std::strcmp(argv[i], "--instances") == 0 && i + 1 < argc)
+      options.instances = static_cast<unsigned int>(std::max(0, std::atoi(argv[++i])));
+    else if (std::strcmp(argv[i], "--gpu-culling") == 0)
+      options.gpuCulling = true;
+    else if (std::strcmp(argv[i], "--import-profile") == 0 && i + 1 < argc) {
+      i++;
+      if (std::strcmp(argv[i], "raw") == 0)
+        options.sceneImport = ImportProfile::RAW;
+      else if (std::strcmp(argv[i], "standard") == 0)
+        options.sceneImport = ImportProfile::STANDARD;
+      else if (std::strcmp(argv[i], "merged") == 0)
+        options.sceneImport = ImportProfile::MERGED;
+      else
+        std::cout << "ERROR::OPTIONS::UNKNOWN_IMPORT_PROFILE: " << argv[i] << std::endl;
+    }
+  }
+  TRACE_THREAD_NAME("main");
+
+  // the calling thread becomes the job system's main thread
+  JobSystem::initialize();
+  FrameAllocator::initialize();
+  if (options.benchJobs || options.benchCut || options.benchTransforms || options.benchAnimation || options.benchOcclusion ||
+      options.benchSpatial) {
+    if (options.benchJobs)
+      Benchmark::runJobScaling();
+    if (options.benchCut)
+      Benchmark::runCutting();
+    if (options.benchTransforms)
+      Benchmark::runTransforms();
+    if (options.benchAnimation)
+      Benchmark::runAnimation();
+    if (options.benchOcclusion)
+      Benchmark::runOcclusion();
+    if (options.benchSpatial)
+      Benchmark::runSpatial();
+    JobSystem::shutdown();
+    return 0;
+  }
+
   // Initialize GLFW and create window
-  GLFWwindow* window = Setup::initializeWindow(SCR_WIDTH, SCR_HEIGHT, camera);
+  GLFWwindow* window = Setup::initializeWindow(SCR_WIDTH, SCR_HEIGHT, camera, !options.headless, options.gpuCulling);
   if (!window) {
+    JobSystem::shutdown();
     return -1;
   }
 
-  // Set initial VSync state
-  glfwSwapInterval(1);
+  // Set initial VSync state, headless runs never present and replays measure
+  // the frame time rather than the refresh rate
+  vsyncEnabled = !options.headless && options.replayPath.empty();
+  glfwSwapInterval(vsyncEnabled ? 1 : 0);
 
   camera.setHeight(2.0f); // Set camera height to 2 units
 
@@ -63,10 +182,26 @@ int main() {
 
   // Configure OpenGL state
   Setup::setupOpenGLState();
+  AnimationSystem::initialize();
 
   // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
   stbi_set_flip_vertically_on_load(true);
 
+  // everything owning GL objects lives in runEngine so it is released
+  // before the context goes away
+  int result = runEngine(window, options);
+  AnimationSystem::shutdown();
+  if (!options.tracePath.empty())
+    Trace::write(options.tracePath);
+
+  // Cleanup (ImGui first, it still needs the window; glfwTerminate destroys it)
+  FrameAllocator::shutdown();
+  JobSystem::shutdown();
+  Setup::cleanup();
+  return result;
+}
+
+int runEngine(GLFWwindow* window, const EngineOptions& options) {
   // build and compile shaders
   // -------------------------
 
@@ -74,6 +209,7 @@ int main() {
   GLenum err;
 
   Shader lightingShader("res/shaders/lighting.vert","res/shaders/lighting.frag");
+  Shader clusteredShader("res/shaders/lighting.vert","res/shaders/lighting_clustered.frag");
   Shader lightCubeShader("res/shaders/lightCube.vert","res/shaders/lightCube.frag");
   Shader laserShader("res/shaders/lazer.vert", "res/shaders/lazer.frag");
   Shader lineShader("res/shaders/line.vert", "res/shaders/line.frag");
@@ -85,8 +221,9 @@ int main() {
 
   //  load models``
   //  -----------
+  // the static scene is merged into few meshes, the rest keep their nodes for animation and cutting
   Model girlModel("res/Objects/girl.obj");
-  Model ourModel("res/Objects/scean.obj");
+  Model ourModel("res/Objects/scean.obj", false, options.sceneImport);
   Model eyeballModel("res/Objects/eyeball.obj");
   Model lightCubeModel("res/Objects/untitled.obj");
   Model laserModel("res/Objects/cylender.obj");
@@ -101,162 +238,539 @@ int main() {
   lightingShader.setInt("material.specular", 1);
   lightingShader.setFloat("material.shininess", 1.0f);
 
-  lightingShader.setVec3("light.position", lightPos);
-  lightingShader.setVec3("viewPos", camera.Position);
+  clusteredShader.use();
+  clusteredShader.setInt("material.diffuse", 0);
+  clusteredShader.setInt("material.specular", 1);
+  clusteredShader.setFloat("material.shininess", 1.0f);
+  PointShadowMap::bindDisabled(lightingShader);
+  PointShadowMap::bindDisabled(clusteredShader);
+  CascadedShadowMap::bindDisabled(lightingShader);
+  CascadedShadowMap::bindDisabled(clusteredShader);
 
   // light properties
-  lightingShader.setVec3("light.ambient", 0.2f, 0.2f, 0.2f);
-  lightingShader.setVec3("light.diffuse", 0.5f, 0.5f, 0.5f);
-  lightingShader.setVec3("light.specular", 1.0f, 1.0f, 1.0f);
-  lightingShader.setFloat("light.constant", 1.0f);
-  lightingShader.setFloat("light.linear", 0.09f);
-  lightingShader.setFloat("light.quadratic", 0.032f);
+  std::vector<PointLight> lights;
+  lights.push_back(PointLight(lightPos, glm::vec3(0.2f), glm::vec3(0.5f), glm::vec3(1.0f), 1.0f, 0.09f, 0.032f));
+  LightBuffer lightBuffer;
+  lightBuffer.upload(lights);
+  // shadows of the first light; the scene is static and cached, everything else is redrawn each frame
+  PointShadowMap pointShadow;
+  // an outdoor sun with cascaded shadows, only with --sun; the scene is lit from inside otherwise
+  DirectionalLight sun;
+  std::unique_ptr<CascadedShadowMap> sunShadow;
+  if (options.sun)
+    sunShadow.reset(new CascadedShadowMap(options.cascades));
+
+  int framebufferWidth, framebufferHeight;
+  glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+  SCR_WIDTH = framebufferWidth;
+  SCR_HEIGHT = framebufferHeight;
+  DeferredRenderer deferred(framebufferWidth, framebufferHeight);
+  ClusteredLighting clustered;
+  PostProcess postProcess(framebufferWidth, framebufferHeight, BLOOM_MIPS);
+  // the listener refers to locals of this function, so it goes on every way out of it
+  struct ResizeListenerScope {
+    unsigned int id;
+    ~ResizeListenerScope() { InputManager::removeResizeListener(id); }
+  } resizeListener = { InputManager::addResizeListener([&deferred, &postProcess](int width, int height) {
+    SCR_WIDTH = width;
+    SCR_HEIGHT = height;
+    deferred.resize(width, height);
+    postProcess.resize(width, height);
+  }) };
 
   // Set up laser shader
   laserShader.use();
   laserShader.setVec3("laserColor", laserColor);
 
+  // world bounds of every drawer, culled and ray tested as one tree
+  SceneIndex sceneIndex;
+
   Drawer scene(ourModel,lightingShader);
   scene.setScale(glm::vec3(1.0f));
+  sceneIndex.add(scene, SceneIndex::STATIC);
   
   Drawer girl(girlModel,lightingShader);
   girl.setRotationMode(RotationMode::Y_ONLY);
-  
-  Drawer eyeball(eyeballModel,lightingShader);
-  eyeball.setScale(glm::vec3(0.05f));
+  // plays the first clip when the model comes with a skeleton and animations
+  Animator girlAnimator(girlModel, girl.getTransform());
+  if (girlAnimator.isActive()) {
+    girlAnimator.play(0);
+    girl.setAnimator(&girlAnimator);
+  }
+  sceneIndex.add(girl, SceneIndex::DYNAMIC);
+  AnimationSystem::bind(lightingShader);
+  AnimationSystem::bind(clusteredShader);
+  AnimationSystem::bind(deferred.getGeometryShader());
+  AnimationSystem::bind(pointShadow.getShader());
+  if (sunShadow)
+    AnimationSystem::bind(sunShadow->getShader());
+  // islands cut off the girl
+  PieceSet girlPieces(lightingShader, sceneIndex);
+
+  // a drawer per eyeball, so each has its own bounds in the index
+  std::vector<std::unique_ptr<Drawer>> eyeballs;
+  for (int i = 0; i < currentEyeballs; i++) {
+    eyeballs.push_back(std::unique_ptr<Drawer>(new Drawer(eyeballModel, lightingShader)));
+    eyeballs.back()->setScale(glm::vec3(0.05f));
+    sceneIndex.add(*eyeballs.back(), SceneIndex::DYNAMIC);
+  }
+  // they circle the camera, placed once a frame before the transforms update
+  auto placeEyeballs = [&]() {
+    for (size_t i = 0; i < eyeballs.size(); i++) {
+      eyeballs[i]->setPosition(eyeballPosition(static_cast<int>(i)));
+      eyeballs[i]->setTarget(girlpos);
+    }
+  };
 
   Drawer laser(laserModel,laserShader);
   laser.setScale(glm::vec3(0.5f, 0.5f, 10.0f));
   laser.setRotationMode(RotationMode::ALL);
+  sceneIndex.add(laser, SceneIndex::EFFECT);
 
   Drawer lightCube(lightCubeModel,lightCubeShader);
   lightCube.setPosition(lightPos);
   lightCube.setScale(glm::vec3(0.4f));
 
+  // the scene's large meshes hide the girl and the eyeballs behind walls
+  OcclusionCuller occlusion;
+  std::vector<unsigned int> sceneOccluders;
+  if (options.occlusion) {
+    glm::vec3 sceneExtent = ourModel.getBoundingBoxMax() - ourModel.getBoundingBoxMin();
+    OcclusionCuller::selectOccluders(ourModel, 0.1f * std::max(sceneExtent.x, std::max(sceneExtent.y, sceneExtent.z)),
+                                     sceneOccluders);
+  }
+  auto unoccluded = [&](const Drawer& drawer) {
+    if (!options.occlusion)
+      return true;
+    glm::vec3 boundsMin, boundsMax;
+    drawer.getWorldBounds(boundsMin, boundsMax);
+    return occlusion.isVisible(boundsMin, boundsMax);
+  };
+
+  // a crowd of eyeballs scattered over the scene, culled and drawn by the GPU
+  // with --gpu-culling on GL 4.3, by the CPU otherwise
+  InstancedModel crowd(eyeballModel, options.gpuCulling);
+  std::unique_ptr<HiZPyramid> hiZ;
+  if (options.instances > 0) {
+    glm::vec3 sceneMin = ourModel.getBoundingBoxMin();
+    glm::vec3 sceneMax = ourModel.getBoundingBoxMax();
+    std::vector<glm::mat4> matrices(options.instances);
+    std::srand(7);
+    for (size_t i = 0; i < matrices.size(); i++) {
+      glm::vec3 t(std::rand() / (float)RAND_MAX, std::rand() / (float)RAND_MAX, std::rand() / (float)RAND_MAX);
+      glm::mat4 matrix = glm::translate(glm::mat4(1.0f), glm::mix(sceneMin, sceneMax, t));
+      matrix = glm::rotate(matrix, glm::radians(360.0f * std::rand() / (float)RAND_MAX), glm::vec3(0.0f, 1.0f, 0.0f));
+      matrices[i] = glm::scale(matrix, glm::vec3(0.05f));
+    }
+    crowd.setInstances(matrices);
+    if (crowd.isGpuDriven()) {
+      hiZ.reset(new HiZPyramid());
+      Shader& crowdShader = crowd.getShader();
+      crowdShader.use();
+      crowdShader.setInt("material.diffuse", 0);
+      crowdShader.setInt("material.specular", 1);
+      crowdShader.setFloat("material.shininess", 1.0f);
+      PointShadowMap::bindDisabled(crowdShader);
+      CascadedShadowMap::bindDisabled(crowdShader);
+    }
+    std::cout << options.instances << " instances, " << (crowd.isGpuDriven() ? "GPU" : "CPU") << " culling" << std::endl;
+  }
+  // after the opaque pass of any shading mode, forward shaded
+  auto drawCrowd = [&]() {
+    if (crowd.getInstanceCount() == 0)
+      return;
+    PROFILE_SCOPE("instances");
+    Shader& shader = crowd.isGpuDriven() ? crowd.getShader() : lightingShader;
+    if (crowd.isGpuDriven())
+      shaderViewSetup(shader);
+    lightBuffer.bind(shader);
+    pointShadow.bind(shader);
+    if (sunShadow) {
+      sun.bind(shader);
+      sunShadow->bind(shader);
+    }
+    crowd.draw(shader);
+  };
+
+
+  // Opaque objects go through either the forward shader or the G-buffer pass,
+  // culled to the camera by the scene index; the level is the occluder, everything else is tested against it
+  // The visible drawers are drawn in the profiler's groups: the level, the girl with her pieces, the eyeballs
+  enum OpaqueGroup { GROUP_SCENE, GROUP_GIRL, GROUP_EYEBALLS };
+  auto opaqueGroup = [&](const Drawer* drawer) -> OpaqueGroup {
+    if (sceneIndex.getLayer(*drawer) == SceneIndex::STATIC)
+      return GROUP_SCENE;
+    for (size_t i = 0; i < eyeballs.size(); i++) {
+      if (eyeballs[i].get() == drawer)
+        return GROUP_EYEBALLS;
+    }
+    return GROUP_GIRL;
+  };
+  auto drawOpaque = [&](Shader& shader) {
+    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, NEAR_PLANE, FAR_PLANE);
+    FrameVector<Drawer*> visible;
+    sceneIndex.queryFrustum(Frustum::fromMatrix(projection * camera.GetViewMatrix()), SceneIndex::STATIC | SceneIndex::DYNAMIC,
+                            visible);
+    FrameVector<unsigned char> groups(visible.size());
+    for (size_t i = 0; i < visible.size(); i++)
+      groups[i] = static_cast<unsigned char>(opaqueGroup(visible[i]));
+    auto drawGroup = [&](OpaqueGroup group) {
+      for (size_t i = 0; i < visible.size(); i++) {
+        if (groups[i] != group)
+          continue;
+        if (group != GROUP_SCENE && !unoccluded(*visible[i]))
+          continue;
+        visible[i]->draw(shader);
+      }
+    };
+    {
+      PROFILE_SCOPE("scene");
+      drawGroup(GROUP_SCENE);
+    }
+    {
+      PROFILE_SCOPE("girl");
+      drawGroup(GROUP_GIRL);
+    }
+    PROFILE_SCOPE("eyeballs");
+    drawGroup(GROUP_EYEBALLS);
+  };
+
+  // Shadow casters, culled per cube face; the light cube is the light itself and casts nothing
+  PointShadowMap::DrawCasters drawStaticShadows = [&](Shader& shader, const Frustum& face) {
+    FrameVector<Drawer*> casters;
+    sceneIndex.queryFrustum(face, SceneIndex::STATIC, casters);
+    for (size_t i = 0; i < casters.size(); i++)
+      casters[i]->draw(shader);
+  };
+  PointShadowMap::DrawCasters drawDynamicShadows = [&](Shader& shader, const Frustum& face) {
+    FrameVector<Drawer*> casters;
+    sceneIndex.queryFrustum(face, SceneIndex::DYNAMIC | SceneIndex::EFFECT, casters);
+    for (size_t i = 0; i < casters.size(); i++) {
+      if (casters[i] == &laser && laserTimer <= 0)
+        continue;
+      casters[i]->draw(shader);
+    }
+  };
+  // the sun redraws a cascade whole, so it takes both sets
+  CascadedShadowMap::DrawCasters drawSunShadows = [&](Shader& shader, const Frustum& cascade) {
+    drawStaticShadows(shader, cascade);
+    drawDynamicShadows(shader, cascade);
+  };
 
   // Check for OpenGL errors
   while ((err = glGetError()) != GL_NO_ERROR) {
     std::cout << "OpenGL error after buffer setup: " << err << std::endl;
   }
 
-  // render loop
-  // -----------
-  while (!glfwWindowShouldClose(window)) {
-    // Input processing
-    glfwPollEvents();
-    InputManager inputManager(camera, deltaTime, laserTimer, laserDuration, vsyncEnabled);
-    inputManager.processInput(window);
-
-    if (showMenu) {
-      ImGui_ImplOpenGL3_NewFrame();
-      ImGui_ImplGlfw_NewFrame();
-      ImGui::NewFrame();
-      ImGui::ShowDemoWindow();
-    }
+  // Collision for a laser ray the simulation reported; the cut itself runs on the
+  // job system and girlSlicer swaps the new meshes in at a later frame boundary.
+  // The scene index finds what the ray passes, only the girl's box is then tested exactly
+  SliceWorker girlSlicer(girl, girlPieces);
+  auto cutAlong = [&](const SliceRequest& request) {
+    PROFILE_SCOPE("slicing");
+    glm::vec3 minBounds = girlModel.getBoundingBoxMin();
+    glm::vec3 maxBounds = girlModel.getBoundingBoxMax();
+    glm::vec3 intersectionPoint;
 
-    // Frame time calculation
-    float currentFrame = static_cast<float>(glfwGetTime());
-    deltaTime = currentFrame - lastFrame;
-    lastFrame = currentFrame;
-
-    // FPS counter
-    nbFrames++;
-    if (currentFrame - lastTime >= 1.0) { // If last print was more than 1 sec ago
-      std::cout << 1000.0/double(nbFrames) << " ms/frame (" << nbFrames << " FPS)" << std::endl;
-      nbFrames = 0;
-      lastTime = currentFrame;
+    girl.setTarget(camera.Position);
+    glm::mat4 modelMatrix = girl.calculateModelMatrix();
+    // the girl turned towards the camera since the index last saw her
+    sceneIndex.update();
+    FrameVector<Drawer*> hits;
+    sceneIndex.queryRay(request.start, request.direction, std::numeric_limits<float>::max(), SceneIndex::DYNAMIC, hits);
+    if (std::find(hits.begin(), hits.end(), &girl) == hits.end())
+      return;
+    glm::mat4 inverseModel = glm::inverse(modelMatrix);
+
+    glm::vec4 modelSpaceStart = inverseModel * glm::vec4(request.start, 1.0f);
+    glm::vec4 modelSpaceDir = inverseModel * glm::vec4(request.direction, 0.0f);
+    glm::vec3 modelStart = glm::vec3(modelSpaceStart);
+    glm::vec3 modelDirection = glm::normalize(glm::vec3(modelSpaceDir));
+
+    if (girlModel.HitBoundingBox(minBounds, maxBounds, modelStart, modelDirection, intersectionPoint)) {
+      SliceCylinder cut = { modelStart, modelStart + modelDirection * 50.0f, 0.2f };
+      girlSlicer.submit(cut);
     }
+  };
 
-    // Scene rendering
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  // Everything between input and UI, shared by the window loop and headless runs
+  auto renderScene = [&](unsigned int targetFBO) {
     shaderViewSetup(lightingShader);
+    shaderViewSetup(clusteredShader);
     shaderViewSetup(laserShader);
     shaderViewSetup(lineShader);
-    scene.draw();
+    girl.setTarget(camera.Position);
+    placeEyeballs();
+    {
+      PROFILE_SCOPE("transforms");
+      TransformSystem::update();
+      sceneIndex.update();
+    }
+    {
+      PROFILE_SCOPE("animation");
+      AnimationSystem::update(deltaTime, camera.Position);
+    }
+    {
+      PROFILE_SCOPE("point shadow");
+      pointShadow.setLight(0, lights[0].position, lights[0].radius());
+      pointShadow.render(drawStaticShadows, drawDynamicShadows);
+    }
+    if (sunShadow) {
+      PROFILE_SCOPE("sun shadow");
+      sunShadow->update(sun, camera.GetViewMatrix(), glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT,
+                        NEAR_PLANE, FAR_PLANE);
+      sunShadow->render(drawSunShadows);
+    }
+    if (options.occlusion) {
+      PROFILE_SCOPE("occlusion");
+      glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, NEAR_PLANE, FAR_PLANE);
+      occlusion.beginFrame(projection * camera.GetViewMatrix());
+      glm::mat4 sceneMatrix = scene.calculateModelMatrix();
+      for (size_t i = 0; i < sceneOccluders.size(); i++) {
+        const Mesh& mesh = ourModel.meshes[sceneOccluders[i]];
+        occlusion.addOccluder(mesh, sceneMatrix * ourModel.nodes.getWorld(mesh.node));
+      }
+      occlusion.render();
+    }
+    if (crowd.getInstanceCount() > 0) {
+      PROFILE_SCOPE("instance cull");
+      glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, NEAR_PLANE, FAR_PLANE);
+      crowd.cull(projection * camera.GetViewMatrix(), hiZ.get(), options.occlusion ? &occlusion : nullptr);
+    }
 
-    // Get bounding box info
-    glm::vec3 minBounds = girlModel.getBoundingBoxMin();
-    glm::vec3 maxBounds = girlModel.getBoundingBoxMax();
-    glm::vec3 intersectionPoint;
+    // Scene rendering into the HDR target
+    postProcess.beginScene();
+
+    ShadingMode shadingMode = InputManager::getShadingMode();
+    if (shadingMode == ShadingMode::DEFERRED) {
+      PROFILE_SCOPE("deferred shading");
+      glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, NEAR_PLANE, FAR_PLANE);
+      glm::mat4 view = camera.GetViewMatrix();
+      deferred.beginGeometryPass(view, projection);
+      drawOpaque(deferred.getGeometryShader());
+      deferred.endGeometryPass();
+      pointShadow.bind(deferred.getLightShader());
+      if (sunShadow)
+        sunShadow->bind(deferred.getSunShader());
+      deferred.lightingPass(lightBuffer, view, projection, camera.Position, postProcess.getSceneFBO(),
+                            sunShadow ? &sun : nullptr);
+    } else if (shadingMode == ShadingMode::CLUSTERED) {
+      PROFILE_SCOPE("clustered shading");
+      clustered.update(lights, camera.GetViewMatrix(), glm::radians(camera.Zoom),
+                       (float)SCR_WIDTH / (float)SCR_HEIGHT, NEAR_PLANE, FAR_PLANE);
+      lightBuffer.bind(clusteredShader);
+      clustered.bind(clusteredShader, SCR_WIDTH, SCR_HEIGHT);
+      pointShadow.bind(clusteredShader);
+      if (sunShadow) {
+        sun.bind(clusteredShader);
+        sunShadow->bind(clusteredShader);
+      }
+      drawOpaque(clusteredShader);
+    } else {
+      PROFILE_SCOPE("forward shading");
+      lightBuffer.bind(lightingShader);
+      pointShadow.bind(lightingShader);
+      if (sunShadow) {
+        sun.bind(lightingShader);
+        sunShadow->bind(lightingShader);
+      }
+      drawOpaque(lightingShader);
+    }
+    drawCrowd();
+    // next frame's occlusion test for the crowd reads this frame's depth
+    if (hiZ) {
+      PROFILE_SCOPE("hi-z");
+      hiZ->build(postProcess.getSceneDepthTexture(), SCR_WIDTH, SCR_HEIGHT);
+    }
 
-    // Draw girl and bounding box
-    girl.setupBoundingBox(lineShader);
-    girl.setTarget(camera.Position);
-    girl.draw();
+    // Debug lines and the laser stay on the forward path
+    {
+      PROFILE_SCOPE("bounding box");
+      girl.setupBoundingBox(lineShader);
+    }
 
     if (laserTimer > 0) {
+      PROFILE_SCOPE("laser");
       // Laser setup and drawing
       laserStart = camera.Position + camera.Front * 2.0f - glm::vec3(0.0f, 0.5f, 0.0f);
       glm::vec3 laserTarget = camera.Position + camera.Front * 50.0f - glm::vec3(0.0f, 0.5f, 0.0f);
-      glm::vec3 laserDirection = glm::normalize(laserTarget - laserStart);
-      laserTimer -= deltaTime;
 
       laser.setPosition(laserStart);
       laser.setTarget(laserTarget);
-      
+    
       laserShader.use();
       laserShader.setVec3("laserColor", glm::vec3(1.0f, 0.0f, 0.0f));
       laser.draw();
+    }
+
+    // Bloom and tonemapping to the window
+    {
+      PROFILE_SCOPE("post-process");
+      postProcess.apply(bloomStrength, bloomThreshold, exposure, targetFBO);
+    }
+  };
+
+  if (options.benchLights) {
+    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, NEAR_PLANE, FAR_PLANE);
+    girl.setTarget(camera.Position);
+    placeEyeballs();
+    TransformSystem::update();
+    sceneIndex.update();
+    Benchmark::runLighting(deferred, lightingShader, lightBuffer, drawOpaque, camera.GetViewMatrix(), projection,
+                           camera.Position, ourModel.getBoundingBoxMin(), ourModel.getBoundingBoxMax());
+    return 0;
+  }
+
+  if (options.headless) {
+    return Headless::run(options.headlessOptions, camera, SCR_WIDTH, SCR_HEIGHT, ourModel.getBoundingBoxMin(), ourModel.getBoundingBoxMax(),
+                         [&](unsigned int targetFBO, float frameDeltaTime) {
+                           deltaTime = frameDeltaTime;
+                           renderScene(targetFBO);
+                         });
+  }
 
-      // Collision and slicing
-      float currentTime = static_cast<float>(glfwGetTime());
-      if (currentTime - lastSliceCheck >= sliceCheckInterval) {
-        lastSliceCheck = currentTime;
-
-        glm::mat4 modelMatrix = girl.calculateModelMatrix();
-        glm::mat4 inverseModel = glm::inverse(modelMatrix);
-        
-        glm::vec4 modelSpaceStart = inverseModel * glm::vec4(laserStart, 1.0f);
-        glm::vec4 modelSpaceDir = inverseModel * glm::vec4(laserDirection, 0.0f);
-        glm::vec3 modelStart = glm::vec3(modelSpaceStart);
-        glm::vec3 modelDirection = glm::normalize(glm::vec3(modelSpaceDir));
-
-        if (girlModel.HitBoundingBox(minBounds, maxBounds, modelStart, modelDirection, intersectionPoint)) {
-          girlModel.sliceModelCylinder(modelStart, modelStart + modelDirection * 50.0f, 0.2f);
-          girl.setModel(girlModel);
+  InputRecorder recorder;
+  if (!options.recordPath.empty())
+    recorder.open(options.recordPath);
+  InputReplay replay;
+  if (!options.replayPath.empty() && !replay.open(options.replayPath))
+    return -1;
+  std::vector<double> replayFrameMilliseconds;
+  replayFrameMilliseconds.reserve(replay.frameCount());
+
+  // replays need the accumulator to see exactly the recorded frame times, so they stay single threaded
+  bool simThread = options.simThread && !replay.isOpen();
+  Simulation simulation(camera, laserDuration, 1.0f / options.simRate, simThread);
+  // and cuts land a fixed number of frames after they were made, not when their job happens to finish
+  if (replay.isOpen())
+    girlSlicer.setFixedLatency(SliceWorker::REPLAY_LATENCY_FRAMES);
+  // lives across frames, its key edge state (V) must persist
+  InputManager inputManager(camera, deltaTime, laserTimer, laserDuration, vsyncEnabled);
+  // the first replayed frame would otherwise include all of the loading time
+  lastFrame = static_cast<float>(glfwGetTime());
+
+  // render loop
+  // -----------
+  while (!glfwWindowShouldClose(window)) {
+    TRACE_SCOPE("frame");
+    FrameAllocator::beginFrame();
+    Profiler::beginFrame();
+
+    bool showMenu;
+    {
+      TRACE_SCOPE("update");
+      // Frame time calculation
+      float currentFrame = static_cast<float>(glfwGetTime());
+      deltaTime = currentFrame - lastFrame;
+      lastFrame = currentFrame;
+      if (replay.isOpen())
+        replayFrameMilliseconds.push_back(deltaTime * 1000.0);
+
+      // GL work queued by jobs since the last frame
+      JobSystem::executeMainThreadJobs();
+
+      // Input processing, a replay substitutes the recorded frame and its deltaTime
+      glfwPollEvents();
+      InputFrame input = inputManager.sample(window);
+      if (replay.isOpen()) {
+        if (!replay.next(input)) {
+          glfwSetWindowShouldClose(window, true);
+          break;
         }
+        deltaTime = input.deltaTime;
+      }
+      recorder.write(input);
+      inputManager.applyToggles(window, input);
+
+      // fixed rate camera and laser simulation, interpolated into the render camera
+      simulation.submitInput(input);
+      simulation.update(deltaTime);
+      laserTimer = simulation.interpolated(camera).laserTimer;
+      FrameVector<SliceRequest> sliceRequests;
+      simulation.takeSliceRequests(sliceRequests);
+      for (size_t i = 0; i < sliceRequests.size(); i++)
+        cutAlong(sliceRequests[i]);
+      {
+        PROFILE_SCOPE("slice upload");
+        // new geometry, new bounds for the same transform
+        if (girlSlicer.update())
+          sceneIndex.refresh(girl);
+      }
+      if (InputManager::consumeTraceRequest())
+        Trace::write(options.tracePath.empty() ? "trace.json" : options.tracePath);
+
+      showMenu = InputManager::isShowMenu();
+      if (showMenu) {
+        ImGui_ImplOpenGL3_NewFrame();
+        ImGui_ImplGlfw_NewFrame();
+        ImGui::NewFrame();
+        ImGui::ShowDemoWindow();
       }
-    }
 
-    // Render eyeballs
-    for (int i = 0; i < currentEyeballs; i++) {
-      float angle = (2.0f * glm::pi<float>() * i) / (currentEyeballs);
-      float radius = 1.0f;
-      
-      glm::vec3 Up = camera.Up;
-      glm::vec3 Right = camera.Right;
-
-      glm::vec3 eyeballPos = glm::vec3(
-        radius * (cos(angle)*Up.x + sin(angle)*Right.x),
-        radius * (cos(angle)*Up.y + sin(angle)*Right.y),
-        radius * (cos(angle)*Up.z + sin(angle)*Right.z)
-      ) + camera.Position + camera.Front * 2.0f;
-              
-      eyeball.setPosition(eyeballPos);
-      eyeball.setTarget(girlpos);
-      eyeball.draw();
+      // FPS counter
+      nbFrames++;
+      if (currentFrame - lastTime >= 1.0) { // If last print was more than 1 sec ago
+        std::cout << 1000.0/double(nbFrames) << " ms/frame (" << nbFrames << " FPS), "
+                  << FrameAllocator::getLastFrameHeapAllocations() << " heap allocations last frame" << std::endl;
+        for (int pass = 0; pass < PostProcess::PASS_COUNT; pass++)
+          std::cout << "  " << PostProcess::passName(pass) << ": " << postProcess.getPassMilliseconds(pass) << " ms GPU" << std::endl;
+        if (options.occlusion) {
+          const OcclusionStats& stats = occlusion.getStats();
+          std::cout << "  occlusion: " << stats.rasterizedTriangles << " of " << stats.occluderTriangles
+                    << " occluder triangles in " << stats.rasterMilliseconds << " ms, "
+                    << stats.culled << " of " << stats.tested << " objects culled" << std::endl;
+        }
+        if (crowd.getInstanceCount() > 0)
+          std::cout << "  instances: " << crowd.readVisibleCount() << " of " << crowd.getInstanceCount() << " drawn" << std::endl;
+        nbFrames = 0;
+        lastTime = currentFrame;
+      }
     }
 
-    // Final render
-    if (showMenu) {
-      ImGui::Render();
-      ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    {
+      TRACE_SCOPE("render");
+      renderScene(0);
+
+      // Final render
+      if (showMenu) {
+        PROFILE_SCOPE("ImGui");
+        Profiler::drawWindow();
+        ImGui::Render();
+        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+      }
+    }
+    Profiler::endFrame();
+    {
+      TRACE_SCOPE("swap");
+      glfwSwapBuffers(window);
     }
-    glfwSwapBuffers(window);
   }
 
-  // Cleanup
-  glfwDestroyWindow(window);
-  glfwTerminate();
-  Setup::cleanup();
+  if (replay.isOpen())
+    Headless::writeStats(options.headlessOptions.statsPath, replayFrameMilliseconds);
   return 0;
 }
 
 void shaderViewSetup(Shader shader) {
     shader.use();
-    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom),(float)SCR_WIDTH / (float)SCR_HEIGHT,0.1f, 100.0f);
+    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom),(float)SCR_WIDTH / (float)SCR_HEIGHT,NEAR_PLANE, FAR_PLANE);
     glm::mat4 view = camera.GetViewMatrix();
     shader.setMat4("projection", projection);
     shader.setMat4("view", view);
+    shader.setVec3("viewPos", camera.Position);
+}
+
+glm::vec3 eyeballPosition(int index) {
+    float angle = (2.0f * glm::pi<float>() * index) / (currentEyeballs);
+    float radius = 1.0f;
+
+    glm::vec3 Up = camera.Up;
+    glm::vec3 Right = camera.Right;
+
+    return glm::vec3(
+      radius * (cos(angle)*Up.x + sin(angle)*Right.x),
+      radius * (cos(angle)*Up.y + sin(angle)*Right.y),
+      radius * (cos(angle)*Up.z + sin(angle)*Right.z)
+    ) + camera.Position + camera.Front * 2.0f;
 }
 
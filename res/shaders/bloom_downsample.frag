@@ -0,0 +1,69 @@
+#version 330 core
+out vec3 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D srcTexture;
+uniform vec2 srcTexelSize;
+uniform bool prefilter;
+uniform float threshold;
+
+float luma(vec3 c)
+{
+    return dot(c, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// Karis average: weights each group by 1/(1+luma) so single bright pixels don't flicker
+vec3 karis(vec3 a, vec3 b, vec3 c, vec3 d)
+{
+    vec4 sum = vec4(0.0);
+    sum += vec4(a, 1.0) / (1.0 + luma(a));
+    sum += vec4(b, 1.0) / (1.0 + luma(b));
+    sum += vec4(c, 1.0) / (1.0 + luma(c));
+    sum += vec4(d, 1.0) / (1.0 + luma(d));
+    return sum.rgb / sum.a;
+}
+
+void main()
+{
+    vec2 t = srcTexelSize;
+    // 13 taps in a 4x4 texel footprint:
+    // a - b - c
+    // - j - k -
+    // d - e - f
+    // - l - m -
+    // g - h - i
+    vec3 a = texture(srcTexture, TexCoords + t * vec2(-2.0,  2.0)).rgb;
+    vec3 b = texture(srcTexture, TexCoords + t * vec2( 0.0,  2.0)).rgb;
+    vec3 c = texture(srcTexture, TexCoords + t * vec2( 2.0,  2.0)).rgb;
+    vec3 d = texture(srcTexture, TexCoords + t * vec2(-2.0,  0.0)).rgb;
+    vec3 e = texture(srcTexture, TexCoords).rgb;
+    vec3 f = texture(srcTexture, TexCoords + t * vec2( 2.0,  0.0)).rgb;
+    vec3 g = texture(srcTexture, TexCoords + t * vec2(-2.0, -2.0)).rgb;
+    vec3 h = texture(srcTexture, TexCoords + t * vec2( 0.0, -2.0)).rgb;
+    vec3 i = texture(srcTexture, TexCoords + t * vec2( 2.0, -2.0)).rgb;
+    vec3 j = texture(srcTexture, TexCoords + t * vec2(-1.0,  1.0)).rgb;
+    vec3 k = texture(srcTexture, TexCoords + t * vec2( 1.0,  1.0)).rgb;
+    vec3 l = texture(srcTexture, TexCoords + t * vec2(-1.0, -1.0)).rgb;
+    vec3 m = texture(srcTexture, TexCoords + t * vec2( 1.0, -1.0)).rgb;
+
+    vec3 color;
+    if (prefilter) {
+        color = karis(j, k, l, m) * 0.5
+              + karis(a, b, d, e) * 0.125
+              + karis(b, c, e, f) * 0.125
+              + karis(d, e, g, h) * 0.125
+              + karis(e, f, h, i) * 0.125;
+        // soft threshold: keep only the energy above the threshold
+        float brightness = max(color.r, max(color.g, color.b));
+        float contribution = max(brightness - threshold, 0.0) / max(brightness, 0.0001);
+        color *= contribution;
+    } else {
+        color = e * 0.125
+              + (a + c + g + i) * 0.03125
+              + (b + d + f + h) * 0.0625
+              + (j + k + l + m) * 0.125;
+    }
+
+    FragColor = max(color, vec3(0.0001));
+}
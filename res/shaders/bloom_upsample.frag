@@ -0,0 +1,24 @@
+#version 330 core
+out vec3 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D srcTexture;
+uniform vec2 srcTexelSize;
+
+void main()
+{
+    vec2 t = srcTexelSize;
+    // 3x3 tent filter
+    vec3 a = texture(srcTexture, TexCoords + t * vec2(-1.0,  1.0)).rgb;
+    vec3 b = texture(srcTexture, TexCoords + t * vec2( 0.0,  1.0)).rgb;
+    vec3 c = texture(srcTexture, TexCoords + t * vec2( 1.0,  1.0)).rgb;
+    vec3 d = texture(srcTexture, TexCoords + t * vec2(-1.0,  0.0)).rgb;
+    vec3 e = texture(srcTexture, TexCoords).rgb;
+    vec3 f = texture(srcTexture, TexCoords + t * vec2( 1.0,  0.0)).rgb;
+    vec3 g = texture(srcTexture, TexCoords + t * vec2(-1.0, -1.0)).rgb;
+    vec3 h = texture(srcTexture, TexCoords + t * vec2( 0.0, -1.0)).rgb;
+    vec3 i = texture(srcTexture, TexCoords + t * vec2( 1.0, -1.0)).rgb;
+
+    FragColor = (e * 4.0 + (b + d + f + h) * 2.0 + (a + c + g + i)) / 16.0;
+}
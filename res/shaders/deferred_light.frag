@@ -0,0 +1,99 @@
+#version 330 core
+out vec4 FragColor;
+
+struct Light {
+    vec3 position;
+    float radius;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+flat in int lightIndex;
+
+uniform sampler2D gAlbedoSpec;
+uniform sampler2D gNormal;
+uniform sampler2D gMaterial;
+uniform sampler2D gDepth;
+
+uniform samplerBuffer lights;
+uniform mat4 inverseViewProjection;
+uniform vec2 screenSize;
+uniform vec3 viewPos;
+
+// point light shadow of light shadowLight (-1: none), see PointShadowMap
+uniform int shadowLight;
+uniform samplerCube shadowStatic;
+uniform samplerCube shadowDynamic;
+uniform float shadowRange;
+
+// 1 lit, 0 shadowed; the nearer of the cached static and the per-frame dynamic depth
+float pointShadow(vec3 lightPos, vec3 fragPos, vec3 norm)
+{
+    // pushed off the surface along the normal against acne
+    vec3 toFrag = fragPos + norm * 0.02 - lightPos;
+    float depth = length(toFrag) / shadowRange;
+    float closest = min(texture(shadowStatic, toFrag).r, texture(shadowDynamic, toFrag).r);
+    return depth - 0.05 / shadowRange > closest ? 0.0 : 1.0;
+}
+
+Light fetchLight(int i)
+{
+    vec4 t0 = texelFetch(lights, i * 4);
+    vec4 t1 = texelFetch(lights, i * 4 + 1);
+    vec4 t2 = texelFetch(lights, i * 4 + 2);
+    vec4 t3 = texelFetch(lights, i * 4 + 3);
+    return Light(t0.xyz, t0.w, t1.xyz, t2.xyz, t3.xyz, t1.w, t2.w, t3.w);
+}
+
+void main()
+{
+    vec2 uv = gl_FragCoord.xy / screenSize;
+    float depth = texture(gDepth, uv).r;
+    if (depth == 1.0)
+        discard;
+
+    // rebuild the world position from depth
+    vec4 ndc = vec4(uv * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    vec4 world = inverseViewProjection * ndc;
+    vec3 fragPos = world.xyz / world.w;
+
+    Light light = fetchLight(lightIndex);
+    float distance = length(light.position - fragPos);
+    if (distance > light.radius)
+        discard;
+
+    vec3 color = texture(gAlbedoSpec, uv).rgb;
+    vec3 norm = texture(gNormal, uv).xyz;
+    vec4 params = texture(gMaterial, uv);
+    vec3 specColor = params.rgb;
+    float shininess = params.a * 256.0;
+
+    // ambient
+    vec3 ambient = light.ambient * color;
+
+    // diffuse
+    vec3 lightDir = normalize(light.position - fragPos);
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 diffuse = light.diffuse * diff * color;
+
+    // specular
+    vec3 viewDir = normalize(viewPos - fragPos);
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(norm, halfwayDir), 0.0), shininess);
+    vec3 specular = vec3(0.3) * light.specular * spec * specColor;
+
+    // attenuation, windowed so the light ends exactly at its radius
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    float window = clamp(1.0 - pow(distance / light.radius, 4.0), 0.0, 1.0);
+    attenuation *= window * window;
+
+    float shadow = lightIndex == shadowLight ? pointShadow(light.position, fragPos, norm) : 1.0;
+
+    FragColor = vec4((ambient + (diffuse + specular) * shadow) * attenuation, 1.0);
+}
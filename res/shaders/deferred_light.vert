@@ -0,0 +1,19 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+flat out int lightIndex;
+
+uniform samplerBuffer lights;
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    // [position, radius] is the first texel of every light
+    vec4 positionRadius = texelFetch(lights, gl_InstanceID * 4);
+    // inflate the low poly sphere so its faces enclose the real light radius
+    vec3 worldPos = positionRadius.xyz + aPos * positionRadius.w * 1.05;
+    lightIndex = gl_InstanceID;
+
+    gl_Position = projection * view * vec4(worldPos, 1.0);
+}
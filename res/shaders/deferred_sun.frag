@@ -0,0 +1,65 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D gAlbedoSpec;
+uniform sampler2D gNormal;
+uniform sampler2D gMaterial;
+uniform sampler2D gDepth;
+
+uniform mat4 inverseViewProjection;
+uniform vec3 viewPos;
+
+// directional sun light, see DirectionalLight::bind, and its cascaded shadows, see CascadedShadowMap
+uniform bool sunEnabled;
+uniform vec3 sunDirection;
+uniform vec3 sunAmbient;
+uniform vec3 sunDiffuse;
+uniform vec3 sunSpecular;
+uniform sampler2DArrayShadow sunShadow;
+uniform mat4 cascadeMatrices[4];
+uniform int cascadeCount;
+
+// 1 lit, 0 shadowed; the first cascade whose map covers the point, lit beyond the last
+float sunShadowFactor(vec3 fragPos, vec3 norm)
+{
+    // pushed off the surface along the normal against acne
+    vec4 position = vec4(fragPos + norm * 0.02, 1.0);
+    for (int i = 0; i < cascadeCount; i++) {
+        vec3 coords = (cascadeMatrices[i] * position).xyz * 0.5 + 0.5;
+        if (all(greaterThan(coords, vec3(0.0))) && all(lessThan(coords, vec3(1.0))))
+            return texture(sunShadow, vec4(coords.xy, float(i), coords.z));
+    }
+    return 1.0;
+}
+
+vec3 shadeSun(vec3 fragPos, vec3 norm, vec3 viewDir, vec3 color, vec3 specColor, float shininess)
+{
+    vec3 lightDir = -sunDirection;
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(norm, halfwayDir), 0.0), shininess);
+    vec3 diffuse = sunDiffuse * diff * color;
+    vec3 specular = vec3(0.3) * sunSpecular * spec * specColor;
+    return sunAmbient * color + (diffuse + specular) * sunShadowFactor(fragPos, norm);
+}
+
+void main()
+{
+    float depth = texture(gDepth, TexCoords).r;
+    if (depth == 1.0)
+        discard;
+
+    // rebuild the world position from depth
+    vec4 ndc = vec4(TexCoords * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    vec4 world = inverseViewProjection * ndc;
+    vec3 fragPos = world.xyz / world.w;
+
+    vec3 color = texture(gAlbedoSpec, TexCoords).rgb;
+    vec3 norm = texture(gNormal, TexCoords).xyz;
+    vec4 params = texture(gMaterial, TexCoords);
+    vec3 viewDir = normalize(viewPos - fragPos);
+
+    FragColor = vec4(shadeSun(fragPos, norm, viewDir, color, params.rgb, params.a * 256.0), 1.0);
+}
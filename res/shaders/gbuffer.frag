@@ -0,0 +1,26 @@
+#version 330 core
+layout (location = 0) out vec4 gAlbedoSpec;
+layout (location = 1) out vec4 gNormal;
+layout (location = 2) out vec4 gMaterial;
+
+struct Material {
+    sampler2D diffuse;
+    sampler2D specular;    
+    float shininess;
+}; 
+
+in VS_OUT {
+    vec3 FragPos;
+    vec3 Normal;
+    vec2 TexCoords;
+} fs_in;
+
+uniform Material material;
+
+void main()
+{
+    gAlbedoSpec = vec4(texture(material.diffuse, fs_in.TexCoords).rgb, 1.0);
+    gNormal = vec4(normalize(fs_in.Normal), 0.0);
+    // the specular color as the forward path reads it, shininess in alpha
+    gMaterial = vec4(texture(material.specular, fs_in.TexCoords).rgb, material.shininess / 256.0);
+}
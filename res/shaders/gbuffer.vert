@@ -0,0 +1,49 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 5) in ivec4 aBoneIds;
+layout (location = 6) in vec4 aWeights;
+
+out VS_OUT {
+    vec3 FragPos;
+    vec3 Normal;
+    vec2 TexCoords;
+} vs_out;
+
+uniform mat4 model;
+uniform mat3 normalMatrix;
+uniform mat4 view;
+uniform mat4 projection;
+
+// skinned meshes read their bones from the palette of the character being drawn
+uniform bool skinned;
+uniform samplerBuffer bonePalette;
+uniform int paletteOffset;
+
+mat4 boneMatrix(int bone)
+{
+    int texel = paletteOffset + bone * 3;
+    return transpose(mat4(texelFetch(bonePalette, texel),
+                          texelFetch(bonePalette, texel + 1),
+                          texelFetch(bonePalette, texel + 2),
+                          vec4(0.0, 0.0, 0.0, 1.0)));
+}
+
+void main()
+{
+    vec4 position = vec4(aPos, 1.0);
+    vec3 normal = aNormal;
+    if (skinned) {
+        mat4 skin = aWeights.x * boneMatrix(aBoneIds.x) + aWeights.y * boneMatrix(aBoneIds.y)
+                  + aWeights.z * boneMatrix(aBoneIds.z) + aWeights.w * boneMatrix(aBoneIds.w);
+        position = skin * position;
+        normal = mat3(skin) * normal;
+    }
+
+    vs_out.FragPos = vec3(model * position);
+    vs_out.Normal = normalMatrix * normal;  
+    vs_out.TexCoords = aTexCoords;
+    
+    gl_Position = projection * view * vec4(vs_out.FragPos, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,155 @@
+#version 330 core
+out vec4 FragColor;
+
+struct Material {
+    sampler2D diffuse;
+    sampler2D specular;
+    float shininess;
+};
+
+struct Light {
+    vec3 position;
+    float radius;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+in VS_OUT {
+    vec3 FragPos;
+    vec3 Normal;
+    vec2 TexCoords;
+} fs_in;
+
+uniform vec3 viewPos;
+uniform mat4 view;
+uniform Material material;
+uniform samplerBuffer lights;
+
+// filled by ClusteredLighting: (offset, count) per cluster and the light index lists
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer clusterIndices;
+uniform float clusterZScale;
+uniform float clusterZBias;
+uniform vec2 clusterTileSize;
+
+const uvec3 clusterDims = uvec3(16u, 9u, 24u);
+
+// point light shadow of light shadowLight (-1: none), see PointShadowMap
+uniform int shadowLight;
+uniform samplerCube shadowStatic;
+uniform samplerCube shadowDynamic;
+uniform float shadowRange;
+
+// directional sun light, see DirectionalLight::bind, and its cascaded shadows, see CascadedShadowMap
+uniform bool sunEnabled;
+uniform vec3 sunDirection;
+uniform vec3 sunAmbient;
+uniform vec3 sunDiffuse;
+uniform vec3 sunSpecular;
+uniform sampler2DArrayShadow sunShadow;
+uniform mat4 cascadeMatrices[4];
+uniform int cascadeCount;
+
+// 1 lit, 0 shadowed; the nearer of the cached static and the per-frame dynamic depth
+float pointShadow(vec3 lightPos, vec3 fragPos, vec3 norm)
+{
+    // pushed off the surface along the normal against acne
+    vec3 toFrag = fragPos + norm * 0.02 - lightPos;
+    float depth = length(toFrag) / shadowRange;
+    float closest = min(texture(shadowStatic, toFrag).r, texture(shadowDynamic, toFrag).r);
+    return depth - 0.05 / shadowRange > closest ? 0.0 : 1.0;
+}
+
+// 1 lit, 0 shadowed; the first cascade whose map covers the point, lit beyond the last
+float sunShadowFactor(vec3 fragPos, vec3 norm)
+{
+    // pushed off the surface along the normal against acne
+    vec4 position = vec4(fragPos + norm * 0.02, 1.0);
+    for (int i = 0; i < cascadeCount; i++) {
+        vec3 coords = (cascadeMatrices[i] * position).xyz * 0.5 + 0.5;
+        if (all(greaterThan(coords, vec3(0.0))) && all(lessThan(coords, vec3(1.0))))
+            return texture(sunShadow, vec4(coords.xy, float(i), coords.z));
+    }
+    return 1.0;
+}
+
+vec3 shadeSun(vec3 fragPos, vec3 norm, vec3 viewDir, vec3 color, vec3 specColor, float shininess)
+{
+    vec3 lightDir = -sunDirection;
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(norm, halfwayDir), 0.0), shininess);
+    vec3 diffuse = sunDiffuse * diff * color;
+    vec3 specular = vec3(0.3) * sunSpecular * spec * specColor;
+    return sunAmbient * color + (diffuse + specular) * sunShadowFactor(fragPos, norm);
+}
+
+// 4 texels per light, see LightBuffer::upload
+Light fetchLight(int i)
+{
+    vec4 t0 = texelFetch(lights, i * 4);
+    vec4 t1 = texelFetch(lights, i * 4 + 1);
+    vec4 t2 = texelFetch(lights, i * 4 + 2);
+    vec4 t3 = texelFetch(lights, i * 4 + 3);
+    return Light(t0.xyz, t0.w, t1.xyz, t2.xyz, t3.xyz, t1.w, t2.w, t3.w);
+}
+
+vec3 shadeLight(Light light, vec3 norm, vec3 viewDir, vec3 color, vec3 specColor, float shadow)
+{
+    float distance = length(light.position - fs_in.FragPos);
+    if (distance > light.radius)
+        return vec3(0.0);
+
+    // ambient
+    vec3 ambient = light.ambient * color;
+
+    // diffuse
+    vec3 lightDir = normalize(light.position - fs_in.FragPos);
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 diffuse = light.diffuse * diff * color;
+
+    // specular
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(norm, halfwayDir), 0.0), material.shininess);
+    vec3 specular = vec3(0.3) * light.specular * spec * specColor;
+
+    // attenuation, windowed so the light ends exactly at its radius
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    float window = clamp(1.0 - pow(distance / light.radius, 4.0), 0.0, 1.0);
+    attenuation *= window * window;
+
+    return (ambient + (diffuse + specular) * shadow) * attenuation;
+}
+
+void main()
+{
+    vec3 color = texture(material.diffuse, fs_in.TexCoords).rgb;
+    vec3 specColor = texture(material.specular, fs_in.TexCoords).rgb;
+    vec3 norm = normalize(fs_in.Normal);
+    vec3 viewDir = normalize(viewPos - fs_in.FragPos);
+
+    // find this fragment's cluster: screen tile + exponential depth slice
+    float depth = -(view * vec4(fs_in.FragPos, 1.0)).z;
+    uint slice = uint(clamp(log(depth) * clusterZScale + clusterZBias, 0.0, float(clusterDims.z - 1u)));
+    uvec2 tile = min(uvec2(gl_FragCoord.xy / clusterTileSize), clusterDims.xy - 1u);
+    int cluster = int((slice * clusterDims.y + tile.y) * clusterDims.x + tile.x);
+    uvec2 range = texelFetch(clusterGrid, cluster).rg;
+
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < range.y; i++) {
+        int lightIndex = int(texelFetch(clusterIndices, int(range.x + i)).r);
+        Light light = fetchLight(lightIndex);
+        float shadow = lightIndex == shadowLight ? pointShadow(light.position, fs_in.FragPos, norm) : 1.0;
+        result += shadeLight(light, norm, viewDir, color, specColor, shadow);
+    }
+    if (sunEnabled)
+        result += shadeSun(fs_in.FragPos, norm, viewDir, color, specColor, material.shininess);
+
+    FragColor = vec4(result, 1.0);
+}
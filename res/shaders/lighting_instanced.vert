@@ -0,0 +1,40 @@
+#version 430 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+
+out VS_OUT {
+    vec3 FragPos;
+    vec3 Normal;
+    vec2 TexCoords;
+} vs_out;
+
+// see InstancedModel::GpuInstance
+struct Instance {
+    mat4 model;
+    mat4 normalMatrix;
+    vec4 boundsMin;
+    vec4 boundsMax;
+};
+
+// the instances and the ones the cull shader kept, one per drawn instance
+layout(std430, binding = 0) readonly buffer Instances { Instance instances[]; };
+layout(std430, binding = 1) readonly buffer Visible { uint visible[]; };
+
+// the mesh's node transform within the model
+uniform mat4 node;
+uniform mat3 nodeNormal;
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    uint index = visible[gl_InstanceID];
+    mat4 model = instances[index].model * node;
+
+    vs_out.FragPos = vec3(model * vec4(aPos, 1.0));
+    vs_out.Normal = mat3(instances[index].normalMatrix) * nodeNormal * aNormal;
+    vs_out.TexCoords = aTexCoords;
+
+    gl_Position = projection * view * vec4(vs_out.FragPos, 1.0);
+}
@@ -0,0 +1,36 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 5) in ivec4 aBoneIds;
+layout (location = 6) in vec4 aWeights;
+
+out vec3 FragPos;
+
+uniform mat4 model;
+uniform mat4 lightSpace;
+
+// same skinning as lighting.vert; shared by the point and the sun shadow passes
+uniform bool skinned;
+uniform samplerBuffer bonePalette;
+uniform int paletteOffset;
+
+mat4 boneMatrix(int bone)
+{
+    int texel = paletteOffset + bone * 3;
+    return transpose(mat4(texelFetch(bonePalette, texel),
+                          texelFetch(bonePalette, texel + 1),
+                          texelFetch(bonePalette, texel + 2),
+                          vec4(0.0, 0.0, 0.0, 1.0)));
+}
+
+void main()
+{
+    vec4 position = vec4(aPos, 1.0);
+    if (skinned) {
+        mat4 skin = aWeights.x * boneMatrix(aBoneIds.x) + aWeights.y * boneMatrix(aBoneIds.y)
+                  + aWeights.z * boneMatrix(aBoneIds.z) + aWeights.w * boneMatrix(aBoneIds.w);
+        position = skin * position;
+    }
+
+    FragPos = vec3(model * position);
+    gl_Position = lightSpace * vec4(FragPos, 1.0);
+}
@@ -0,0 +1,11 @@
+#version 330 core
+in vec3 FragPos;
+
+uniform vec3 lightPos;
+uniform float range;
+
+void main()
+{
+    // linear distance, so every face compares the same quantity
+    gl_FragDepth = length(FragPos - lightPos) / range;
+}
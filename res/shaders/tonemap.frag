@@ -0,0 +1,19 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D scene;
+uniform sampler2D bloom;
+uniform float bloomStrength;
+uniform float exposure;
+
+void main()
+{
+    vec3 hdr = texture(scene, TexCoords).rgb;
+    hdr += texture(bloom, TexCoords).rgb * bloomStrength;
+
+    // exposure tonemapping
+    vec3 mapped = vec3(1.0) - exp(-hdr * exposure);
+    FragColor = vec4(mapped, 1.0);
+}
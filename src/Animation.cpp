@@ -0,0 +1,153 @@
+#include "Animation.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    const float SQRT2 = 1.41421356f;
+    // 15 bits per smallest-three component, the top bits carry the dropped index
+    const float ROTATION_STEPS = 32767.0f;
+    const float VALUE_STEPS = 65535.0f;
+
+    // index of the last key at or before time (in key units) within
+    // [start, start + count), and how far time is towards the next key
+    size_t findKey(const std::vector<PackedKey>& keys, size_t start, size_t count, float time, float& factor) {
+        const PackedKey* first = keys.data() + start;
+        size_t low = 0, high = count;
+        while (low < high) {
+            size_t middle = (low + high) / 2;
+            if (first[middle].time <= time)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+        size_t next = low;
+        if (next == 0 || count == 1) {
+            factor = 0.0f;
+            return start;
+        }
+        if (next == count) {
+            factor = 0.0f;
+            return start + count - 1;
+        }
+        size_t key = next - 1;
+        float span = static_cast<float>(first[next].time - first[key].time);
+        factor = span > 0.0f ? (time - first[key].time) / span : 0.0f;
+        return start + key;
+    }
+
+    glm::vec3 unpackValue(const PackedKey& key, const glm::vec3& min, const glm::vec3& extent) {
+        return min + extent * (glm::vec3(key.value[0], key.value[1], key.value[2]) * (1.0f / VALUE_STEPS));
+    }
+}
+
+PackedKey packRotation(glm::quat rotation) {
+    rotation = glm::normalize(rotation);
+    float components[4] = { rotation.x, rotation.y, rotation.z, rotation.w };
+    int largest = 0;
+    for (int i = 1; i < 4; i++) {
+        if (std::fabs(components[i]) > std::fabs(components[largest]))
+            largest = i;
+    }
+    // q and -q are the same rotation, so the dropped component is always positive
+    // and the other three lie within +-1/sqrt(2)
+    float sign = components[largest] < 0.0f ? -1.0f : 1.0f;
+    uint16_t packed[3];
+    int n = 0;
+    for (int i = 0; i < 4; i++) {
+        if (i == largest)
+            continue;
+        float value = glm::clamp(components[i] * sign * SQRT2, -1.0f, 1.0f);
+        packed[n++] = static_cast<uint16_t>(std::lround((value * 0.5f + 0.5f) * ROTATION_STEPS));
+    }
+    PackedKey key;
+    key.time = 0;
+    key.value[0] = static_cast<uint16_t>(packed[0] | ((largest >> 1) << 15));
+    key.value[1] = static_cast<uint16_t>(packed[1] | ((largest & 1) << 15));
+    key.value[2] = packed[2];
+    return key;
+}
+
+glm::quat unpackRotation(const PackedKey& key) {
+    int largest = ((key.value[0] >> 15) << 1) | (key.value[1] >> 15);
+    const float scale = 2.0f / (ROTATION_STEPS * SQRT2);
+    float a = (key.value[0] & 0x7fff) * scale - 1.0f / SQRT2;
+    float b = (key.value[1] & 0x7fff) * scale - 1.0f / SQRT2;
+    float c = key.value[2] * scale - 1.0f / SQRT2;
+    float d = std::sqrt(std::max(0.0f, 1.0f - a * a - b * b - c * c));
+    // a, b and c are the other components in x, y, z, w order
+    switch (largest) {
+    case 0: return glm::quat(c, d, a, b);
+    case 1: return glm::quat(c, a, d, b);
+    case 2: return glm::quat(c, a, b, d);
+    default: return glm::quat(d, a, b, c);
+    }
+}
+
+void Pose::resize(size_t nodes) {
+    translations.resize(nodes, glm::vec3(0.0f));
+    rotations.resize(nodes, glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+    scales.resize(nodes, glm::vec3(1.0f));
+}
+
+glm::mat4 Pose::localMatrix(size_t node) const {
+    glm::mat3 rotation = glm::mat3_cast(rotations[node]);
+    const glm::vec3& scale = scales[node];
+    return glm::mat4(glm::vec4(rotation[0] * scale.x, 0.0f),
+                     glm::vec4(rotation[1] * scale.y, 0.0f),
+                     glm::vec4(rotation[2] * scale.z, 0.0f),
+                     glm::vec4(translations[node], 1.0f));
+}
+
+void AnimationClip::sample(float time, Pose& pose) const {
+    if (duration > 0.0f) {
+        time = std::fmod(time, duration);
+        if (time < 0.0f)
+            time += duration;
+    }
+    time *= timeScale;
+
+    float factor;
+    for (size_t c = 0; c < channelNodes.size(); c++) {
+        unsigned int node = channelNodes[c];
+        if (node >= pose.size())
+            continue;
+        if (translationCount[c] > 0) {
+            size_t key = findKey(translationKeys, translationStart[c], translationCount[c], time, factor);
+            glm::vec3 value = unpackValue(translationKeys[key], translationMin[c], translationExtent[c]);
+            if (factor > 0.0f)
+                value = glm::mix(value, unpackValue(translationKeys[key + 1], translationMin[c], translationExtent[c]), factor);
+            pose.translations[node] = value;
+        }
+        if (rotationCount[c] > 0) {
+            size_t key = findKey(rotationKeys, rotationStart[c], rotationCount[c], time, factor);
+            glm::quat value = unpackRotation(rotationKeys[key]);
+            if (factor > 0.0f)
+                value = nlerp(value, unpackRotation(rotationKeys[key + 1]), factor);
+            pose.rotations[node] = value;
+        }
+        if (scaleCount[c] > 0) {
+            size_t key = findKey(scaleKeys, scaleStart[c], scaleCount[c], time, factor);
+            glm::vec3 value = unpackValue(scaleKeys[key], scaleMin[c], scaleExtent[c]);
+            if (factor > 0.0f)
+                value = glm::mix(value, unpackValue(scaleKeys[key + 1], scaleMin[c], scaleExtent[c]), factor);
+            pose.scales[node] = value;
+        }
+    }
+}
+
+size_t AnimationClip::memoryBytes() const {
+    size_t channels = channelNodes.size();
+    return name.size() + channels * (7 * sizeof(unsigned int) + 4 * sizeof(glm::vec3)) +
+           (translationKeys.size() + rotationKeys.size() + scaleKeys.size()) * sizeof(PackedKey);
+}
+
+void blendPoses(Pose& pose, const Pose& other, float weight) {
+    size_t count = std::min(pose.size(), other.size());
+    for (size_t i = 0; i < count; i++)
+        pose.translations[i] = glm::mix(pose.translations[i], other.translations[i], weight);
+    for (size_t i = 0; i < count; i++)
+        pose.rotations[i] = nlerp(pose.rotations[i], other.rotations[i], weight);
+    for (size_t i = 0; i < count; i++)
+        pose.scales[i] = glm::mix(pose.scales[i], other.scales[i], weight);
+}
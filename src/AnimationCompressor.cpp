@@ -0,0 +1,140 @@
+#include "AnimationCompressor.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    const float TIME_STEPS = 65535.0f;
+    const float VALUE_STEPS = 65535.0f;
+
+    // Greedy: each segment starts at the last kept key and grows while
+    // interpolating across it stays within tolerance of every key it skips
+    template <typename T, typename Interpolate, typename Distance>
+    void reduceKeys(const std::vector<float>& times, const std::vector<T>& values, float tolerance,
+                    Interpolate interpolate, Distance distance, std::vector<size_t>& kept) {
+        kept.clear();
+        size_t count = std::min(times.size(), values.size());
+        if (count == 0)
+            return;
+
+        bool constant = true;
+        for (size_t k = 1; k < count && constant; k++)
+            constant = distance(values[0], values[k]) <= tolerance;
+        kept.push_back(0);
+        if (constant)
+            return;
+
+        size_t anchor = 0;
+        for (size_t end = 2; end < count; end++) {
+            float span = times[end] - times[anchor];
+            bool fits = true;
+            for (size_t k = anchor + 1; k < end && fits; k++) {
+                float t = span > 0.0f ? (times[k] - times[anchor]) / span : 0.0f;
+                fits = distance(interpolate(values[anchor], values[end], t), values[k]) <= tolerance;
+            }
+            if (!fits) {
+                kept.push_back(end - 1);
+                anchor = end - 1;
+            }
+        }
+        kept.push_back(count - 1);
+    }
+
+    glm::vec3 mixVec3(const glm::vec3& a, const glm::vec3& b, float t) {
+        return glm::mix(a, b, t);
+    }
+
+    float vec3Distance(const glm::vec3& a, const glm::vec3& b) {
+        return glm::length(a - b);
+    }
+
+    // angle of the rotation between a and b, through the chord between the two
+    // quaternions since acos of a dot close to 1 has too little precision
+    float rotationDistance(const glm::quat& a, glm::quat b) {
+        if (glm::dot(a, b) < 0.0f)
+            b = -b;
+        glm::quat chord = a - b;
+        return 4.0f * std::asin(std::min(1.0f, 0.5f * std::sqrt(glm::dot(chord, chord))));
+    }
+
+    uint16_t packTime(float seconds, float timeScale) {
+        return static_cast<uint16_t>(std::max(0L, std::min(65535L, std::lround(seconds * timeScale))));
+    }
+
+    void packVec3Track(const std::vector<float>& times, const std::vector<glm::vec3>& values, const std::vector<size_t>& kept,
+                       float timeScale, std::vector<PackedKey>& keys, glm::vec3& min, glm::vec3& extent) {
+        min = glm::vec3(0.0f);
+        extent = glm::vec3(0.0f);
+        if (kept.empty())
+            return;
+        min = values[kept[0]];
+        glm::vec3 max = min;
+        for (size_t i = 1; i < kept.size(); i++) {
+            min = glm::min(min, values[kept[i]]);
+            max = glm::max(max, values[kept[i]]);
+        }
+        extent = max - min;
+        for (size_t i = 0; i < kept.size(); i++) {
+            PackedKey key;
+            key.time = packTime(times[kept[i]], timeScale);
+            for (int c = 0; c < 3; c++) {
+                float t = extent[c] > 0.0f ? (values[kept[i]][c] - min[c]) / extent[c] : 0.0f;
+                key.value[c] = static_cast<uint16_t>(std::lround(glm::clamp(t, 0.0f, 1.0f) * VALUE_STEPS));
+            }
+            keys.push_back(key);
+        }
+    }
+}
+
+AnimationClip AnimationCompressor::compress(const std::string& name, float duration, const std::vector<AnimationChannel>& channels,
+                                            const AnimationTolerance& tolerance, AnimationCompressionStats* stats) {
+    AnimationClip clip;
+    clip.name = name;
+    clip.duration = duration;
+    clip.timeScale = duration > 0.0f ? TIME_STEPS / duration : 0.0f;
+
+    std::vector<size_t> kept;
+    size_t rawKeys = 0;
+    size_t rawBytes = 0;
+    for (size_t c = 0; c < channels.size(); c++) {
+        const AnimationChannel& channel = channels[c];
+        clip.channelNodes.push_back(channel.node);
+        rawKeys += channel.translations.size() + channel.rotations.size() + channel.scales.size();
+        rawBytes += 7 * sizeof(unsigned int) +
+                    channel.translations.size() * (sizeof(float) + sizeof(glm::vec3)) +
+                    channel.rotations.size() * (sizeof(float) + sizeof(glm::quat)) +
+                    channel.scales.size() * (sizeof(float) + sizeof(glm::vec3));
+
+        glm::vec3 min, extent;
+        reduceKeys(channel.translationTimes, channel.translations, tolerance.translation, mixVec3, vec3Distance, kept);
+        clip.translationStart.push_back(static_cast<unsigned int>(clip.translationKeys.size()));
+        clip.translationCount.push_back(static_cast<unsigned int>(kept.size()));
+        packVec3Track(channel.translationTimes, channel.translations, kept, clip.timeScale, clip.translationKeys, min, extent);
+        clip.translationMin.push_back(min);
+        clip.translationExtent.push_back(extent);
+
+        reduceKeys(channel.rotationTimes, channel.rotations, tolerance.rotation, nlerp, rotationDistance, kept);
+        clip.rotationStart.push_back(static_cast<unsigned int>(clip.rotationKeys.size()));
+        clip.rotationCount.push_back(static_cast<unsigned int>(kept.size()));
+        for (size_t i = 0; i < kept.size(); i++) {
+            PackedKey key = packRotation(channel.rotations[kept[i]]);
+            key.time = packTime(channel.rotationTimes[kept[i]], clip.timeScale);
+            clip.rotationKeys.push_back(key);
+        }
+
+        reduceKeys(channel.scaleTimes, channel.scales, tolerance.scale, mixVec3, vec3Distance, kept);
+        clip.scaleStart.push_back(static_cast<unsigned int>(clip.scaleKeys.size()));
+        clip.scaleCount.push_back(static_cast<unsigned int>(kept.size()));
+        packVec3Track(channel.scaleTimes, channel.scales, kept, clip.timeScale, clip.scaleKeys, min, extent);
+        clip.scaleMin.push_back(min);
+        clip.scaleExtent.push_back(extent);
+    }
+
+    if (stats) {
+        stats->rawKeys += rawKeys;
+        stats->keptKeys += clip.translationKeys.size() + clip.rotationKeys.size() + clip.scaleKeys.size();
+        stats->rawBytes += rawBytes + name.size();
+        stats->compressedBytes += clip.memoryBytes();
+    }
+    return clip;
+}
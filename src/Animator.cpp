@@ -0,0 +1,200 @@
+#include "Animator.h"
+#include "JobSystem.h"
+#include "Trace.h"
+
+#include <algorithm>
+
+namespace {
+    // evaluation every frame up close, then every 2nd, 4th and 8th frame
+    const float FULL_RATE_DISTANCE = 15.0f;
+    const float HALF_RATE_DISTANCE = 30.0f;
+    const float QUARTER_RATE_DISTANCE = 60.0f;
+    // animators per parallelFor range
+    const size_t ANIMATORS_PER_JOB = 4;
+
+    std::vector<Animator*> animators;
+    std::vector<Animator*> evaluating;
+    // palettes of every animator back to back, in texels
+    std::vector<glm::vec4> staging;
+    bool layoutChanged = false;
+    unsigned int frame = 0;
+    size_t lastEvaluated = 0;
+
+    unsigned int buffer = 0;
+    unsigned int texture = 0;
+    size_t capacity = 0;
+}
+
+Animator::Animator(const Model& model, TransformHandle transform)
+    : model(model), transform(transform), clip(0), previousClip(0), time(0.0f), previousTime(0.0f),
+      fade(0.0f), fadeDuration(0.0f), speed(1.0f), pendingTime(0.0f), interval(1), paletteOffset(0) {
+    pose = model.restPose;
+    AnimationSystem::add(this);
+}
+
+Animator::~Animator() {
+    AnimationSystem::remove(this);
+}
+
+void Animator::play(size_t newClip, float fadeSeconds) {
+    if (newClip >= model.animations.size())
+        return;
+    if (fadeSeconds > 0.0f && newClip != clip) {
+        previousClip = clip;
+        previousTime = time;
+        fade = 0.0f;
+        fadeDuration = fadeSeconds;
+    } else {
+        fadeDuration = 0.0f;
+    }
+    clip = newClip;
+    time = 0.0f;
+}
+
+void Animator::evaluate(float deltaTime, glm::vec4* palette) {
+    const std::vector<AnimationClip>& clips = model.animations;
+    float step = deltaTime * speed;
+    time += step;
+
+    // channels only cover the nodes they animate, the rest keep their rest transform
+    pose.translations = model.restPose.translations;
+    pose.rotations = model.restPose.rotations;
+    pose.scales = model.restPose.scales;
+    clips[clip].sample(time, pose);
+    const Pose* result = &pose;
+    if (fade < fadeDuration) {
+        fade += step;
+        previousTime += step;
+        fadePose.translations = model.restPose.translations;
+        fadePose.rotations = model.restPose.rotations;
+        fadePose.scales = model.restPose.scales;
+        clips[previousClip].sample(previousTime, fadePose);
+        blendPoses(fadePose, pose, std::min(fade / fadeDuration, 1.0f));
+        result = &fadePose;
+    }
+
+    // node to model space, parents come first in the graph
+    const SceneGraph& nodes = model.nodes;
+    globals.resize(result->size());
+    for (size_t i = 0; i < globals.size(); i++) {
+        int parent = nodes.getParent(static_cast<unsigned int>(i));
+        glm::mat4 local = result->localMatrix(i);
+        globals[i] = parent != SceneGraph::NO_PARENT ? globals[parent] * local : local;
+    }
+
+    // rows of the affine skinning matrices, see boneMatrix() in the vertex shaders
+    for (size_t b = 0; b < model.bones.size(); b++) {
+        const Bone& bone = model.bones[b];
+        glm::mat4 skin = globals[bone.node] * bone.offset;
+        for (unsigned int row = 0; row < PALETTE_TEXELS; row++)
+            palette[b * PALETTE_TEXELS + row] = glm::vec4(skin[0][row], skin[1][row], skin[2][row], skin[3][row]);
+    }
+}
+
+void AnimationSystem::initialize() {
+    glGenBuffers(1, &buffer);
+    glGenTextures(1, &texture);
+
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, PALETTE_TEXELS * sizeof(glm::vec4), NULL, GL_DYNAMIC_DRAW);
+    capacity = PALETTE_TEXELS;
+
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void AnimationSystem::shutdown() {
+    glDeleteTextures(1, &texture);
+    glDeleteBuffers(1, &buffer);
+    texture = buffer = 0;
+    capacity = 0;
+}
+
+void AnimationSystem::add(Animator* animator) {
+    animators.push_back(animator);
+    layoutChanged = true;
+}
+
+void AnimationSystem::remove(Animator* animator) {
+    animators.erase(std::remove(animators.begin(), animators.end(), animator), animators.end());
+    layoutChanged = true;
+}
+
+unsigned int AnimationSystem::updateInterval(float distance) {
+    if (distance < FULL_RATE_DISTANCE)
+        return 1;
+    if (distance < HALF_RATE_DISTANCE)
+        return 2;
+    if (distance < QUARTER_RATE_DISTANCE)
+        return 4;
+    return 8;
+}
+
+void AnimationSystem::update(float deltaTime, const glm::vec3& viewPosition) {
+    TRACE_SCOPE("animation");
+    // a new layout moves palettes around, so every animator writes its own again
+    bool evaluateAll = layoutChanged;
+    if (layoutChanged) {
+        size_t offset = 0;
+        for (size_t i = 0; i < animators.size(); i++) {
+            animators[i]->paletteOffset = offset;
+            if (animators[i]->isActive())
+                offset += animators[i]->model.bones.size() * PALETTE_TEXELS;
+        }
+        staging.resize(offset);
+        layoutChanged = false;
+    }
+
+    // who evaluates this frame is decided here, the transforms belong to this thread;
+    // the index staggers animators on the same interval across frames
+    frame++;
+    evaluating.clear();
+    for (size_t i = 0; i < animators.size(); i++) {
+        Animator* animator = animators[i];
+        if (!animator->isActive())
+            continue;
+        animator->pendingTime += deltaTime;
+        float distance = 0.0f;
+        if (animator->transform != INVALID_TRANSFORM)
+            distance = glm::length(TransformSystem::getPosition(animator->transform) - viewPosition);
+        animator->interval = updateInterval(distance);
+        if (evaluateAll || (frame + i) % animator->interval == 0)
+            evaluating.push_back(animator);
+    }
+    lastEvaluated = evaluating.size();
+    if (evaluating.empty())
+        return;
+
+    JobSystem::parallelFor(evaluating.size(), ANIMATORS_PER_JOB, [](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            Animator* animator = evaluating[i];
+            animator->evaluate(animator->pendingTime, staging.data() + animator->paletteOffset);
+            animator->pendingTime = 0.0f;
+        }
+    });
+
+    if (buffer == 0 || staging.empty())
+        return;
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    if (staging.size() > capacity) {
+        capacity = staging.size();
+        glBufferData(GL_TEXTURE_BUFFER, capacity * sizeof(glm::vec4), NULL, GL_DYNAMIC_DRAW);
+    }
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, staging.size() * sizeof(glm::vec4), staging.data());
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void AnimationSystem::bind(Shader& shader) {
+    glActiveTexture(GL_TEXTURE0 + PALETTE_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+    glActiveTexture(GL_TEXTURE0);
+
+    shader.use();
+    shader.setInt("bonePalette", PALETTE_TEXTURE_UNIT);
+}
+
+size_t AnimationSystem::getLastEvaluatedCount() {
+    return lastEvaluated;
+}
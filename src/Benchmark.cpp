@@ -0,0 +1,784 @@
+#include "Animator.h"
+#include "Benchmark.h"
+#include "FrameAllocator.h"
+#include "Frustum.h"
+#include "GpuTimer.h"
+#include "JobSystem.h"
+#include "MeshCutter.h"
+#include "OcclusionCuller.h"
+#include "SpatialIndex.h"
+#include "TransformSystem.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    const int WARMUP_FRAMES = 5;
+    const int MEASURED_FRAMES = 30;
+
+    std::vector<PointLight> randomLights(unsigned int count, const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+        std::mt19937 rng(1234);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        std::vector<PointLight> lights;
+        lights.reserve(count);
+        for (unsigned int i = 0; i < count; i++) {
+            glm::vec3 t(unit(rng), unit(rng), unit(rng));
+            glm::vec3 color(0.3f + 0.7f * unit(rng), 0.3f + 0.7f * unit(rng), 0.3f + 0.7f * unit(rng));
+            // short range lights (~5 units) like the ones a level would place
+            lights.push_back(PointLight(glm::mix(boundsMin, boundsMax, t), color * 0.05f, color, color,
+                                        1.0f, 0.7f, 1.8f));
+        }
+        return lights;
+    }
+
+    const int JOB_ITERATIONS = 20;
+    const size_t SCENE_OBJECTS = 200000;
+    const size_t SCENE_MESHES = 64;
+    const size_t MESH_VERTICES = 50000;
+
+    struct SyntheticScene {
+        std::vector<glm::mat4> transforms;
+        std::vector<unsigned char> visible;
+        std::vector<std::vector<glm::vec3> > meshes;
+        std::vector<glm::vec3> meshMin, meshMax;
+        Frustum frustum;
+    };
+
+    void buildSyntheticScene(SyntheticScene& scene) {
+        std::mt19937 rng(1234);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        scene.transforms.resize(SCENE_OBJECTS);
+        scene.visible.resize(SCENE_OBJECTS);
+        for (size_t i = 0; i < SCENE_OBJECTS; i++) {
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(unit(rng), unit(rng), unit(rng)) * 200.0f);
+            model = glm::rotate(model, unit(rng) * 3.14159f, glm::normalize(glm::vec3(unit(rng), unit(rng), 1.0f)));
+            scene.transforms[i] = glm::scale(model, glm::vec3(0.5f + unit(rng) * 0.4f));
+        }
+        scene.meshes.resize(SCENE_MESHES);
+        scene.meshMin.resize(SCENE_MESHES);
+        scene.meshMax.resize(SCENE_MESHES);
+        for (size_t m = 0; m < SCENE_MESHES; m++) {
+            scene.meshes[m].resize(MESH_VERTICES);
+            for (size_t v = 0; v < MESH_VERTICES; v++)
+                scene.meshes[m][v] = glm::vec3(unit(rng), unit(rng), unit(rng)) * 10.0f;
+        }
+
+        // planes of a 60 degree camera at the origin looking down -z
+        scene.frustum = Frustum::fromMatrix(glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 300.0f));
+    }
+
+    // world AABB of the unit cube under each transform against the frustum planes
+    void cullObjects(SyntheticScene& scene, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const glm::mat4& model = scene.transforms[i];
+            glm::vec3 center(model[3]);
+            glm::vec3 extent = glm::abs(glm::vec3(model[0])) + glm::abs(glm::vec3(model[1])) + glm::abs(glm::vec3(model[2]));
+            scene.visible[i] = scene.frustum.intersectsBox(center, extent);
+        }
+    }
+
+    void meshBounds(SyntheticScene& scene, size_t begin, size_t end) {
+        for (size_t m = begin; m < end; m++) {
+            glm::vec3 minBounds(std::numeric_limits<float>::max());
+            glm::vec3 maxBounds(std::numeric_limits<float>::lowest());
+            const std::vector<glm::vec3>& vertices = scene.meshes[m];
+            for (size_t v = 0; v < vertices.size(); v++) {
+                minBounds = glm::min(minBounds, vertices[v]);
+                maxBounds = glm::max(maxBounds, vertices[v]);
+            }
+            scene.meshMin[m] = minBounds;
+            scene.meshMax[m] = maxBounds;
+        }
+    }
+
+    const int CUT_ITERATIONS = 10;
+    const int TRANSFORM_COUNT = 100000;
+    const int TRANSFORM_ITERATIONS = 20;
+
+    const int ANIMATED_CHARACTERS = 500;
+    const unsigned int SKELETON_BONES = 64;
+    const unsigned int CLIP_KEYS = 61;
+    const float CLIP_SECONDS = 2.0f;
+    const int ANIMATION_FRAMES = 64;
+
+    // a chain of bones with one clip keying every bone's rotation and translation
+    void buildSyntheticSkeleton(Model& model) {
+        std::mt19937 rng(1234);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        for (unsigned int b = 0; b < SKELETON_BONES; b++) {
+            unsigned int node = model.nodes.addNode(static_cast<int>(b) - 1, "bone" + std::to_string(b),
+                                                    glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.1f, 0.0f)));
+            Bone bone = { node, glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -0.1f * b, 0.0f)) };
+            model.bones.push_back(bone);
+        }
+        model.restPose.resize(SKELETON_BONES);
+
+        // baked like an exporter does it: every bone keyed every frame, most of them
+        // only rotating, along smooth curves
+        std::vector<AnimationChannel> channels(SKELETON_BONES);
+        for (unsigned int b = 0; b < SKELETON_BONES; b++) {
+            AnimationChannel& channel = channels[b];
+            channel.node = b;
+            float amplitude = 0.3f * unit(rng);
+            float phase = 3.14159265f * unit(rng);
+            glm::vec3 axis = glm::normalize(glm::vec3(unit(rng), unit(rng), 1.0f));
+            for (unsigned int k = 0; k < CLIP_KEYS; k++) {
+                float time = CLIP_SECONDS * k / (CLIP_KEYS - 1);
+                float angle = 2.0f * 3.14159265f * time / CLIP_SECONDS + phase;
+                channel.translationTimes.push_back(time);
+                channel.translations.push_back(glm::vec3(0.0f, b == 0 ? 0.05f * std::sin(2.0f * angle) : 0.1f, 0.0f));
+                channel.rotationTimes.push_back(time);
+                channel.rotations.push_back(glm::angleAxis(amplitude * std::sin(angle), axis));
+            }
+        }
+        model.animations.push_back(AnimationCompressor::compress("synthetic", CLIP_SECONDS, channels, AnimationTolerance(),
+                                                                 &model.animationStats));
+    }
+
+    const unsigned int SPHERE_RINGS = 256;
+    const unsigned int SPHERE_SEGMENTS = 512;
+
+    // unit sphere with shared vertices, about 260k triangles
+    void buildSphere(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+        for (unsigned int ring = 0; ring <= SPHERE_RINGS; ring++) {
+            float theta = 3.14159265f * ring / SPHERE_RINGS;
+            for (unsigned int segment = 0; segment <= SPHERE_SEGMENTS; segment++) {
+                float phi = 2.0f * 3.14159265f * segment / SPHERE_SEGMENTS;
+                Vertex vertex;
+                vertex.Position = glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+                vertex.Normal = vertex.Position;
+                vertex.TexCoords = glm::vec2(float(segment) / SPHERE_SEGMENTS, float(ring) / SPHERE_RINGS);
+                vertex.Tangent = glm::vec3(-std::sin(phi), 0.0f, std::cos(phi));
+                vertex.Bitangent = glm::cross(vertex.Normal, vertex.Tangent);
+                vertices.push_back(vertex);
+            }
+        }
+        for (unsigned int ring = 0; ring < SPHERE_RINGS; ring++) {
+            for (unsigned int segment = 0; segment < SPHERE_SEGMENTS; segment++) {
+                unsigned int a = ring * (SPHERE_SEGMENTS + 1) + segment;
+                unsigned int b = a + SPHERE_SEGMENTS + 1;
+                indices.push_back(a);
+                indices.push_back(a + 1);
+                indices.push_back(b);
+                indices.push_back(a + 1);
+                indices.push_back(b + 1);
+                indices.push_back(b);
+            }
+        }
+    }
+
+    const int MAZE_CELLS = 24;
+    const float MAZE_CELL_SIZE = 10.0f;
+    const float WALL_HEIGHT = 4.0f;
+    const float WALL_THICKNESS = 0.3f;
+    const int OCCLUDEES = 20000;
+    const int OCCLUSION_FRAMES = 60;
+
+    struct Box {
+        glm::vec3 min, max;
+    };
+
+    // 12 triangles, counter-clockwise seen from outside
+    void appendBox(const Box& box, std::vector<glm::vec3>& positions, std::vector<unsigned int>& indices) {
+        glm::vec3 size = box.max - box.min;
+        glm::vec3 x(size.x, 0.0f, 0.0f), y(0.0f, size.y, 0.0f), z(0.0f, 0.0f, size.z);
+        // corner and two sides of each face, the sides' cross product pointing out
+        glm::vec3 faces[6][3] = {
+            { box.min + x, y, z }, { box.min, z, y },
+            { box.min + y, z, x }, { box.min, x, z },
+            { box.min + z, x, y }, { box.min, y, x },
+        };
+        for (int f = 0; f < 6; f++) {
+            unsigned int first = static_cast<unsigned int>(positions.size());
+            positions.push_back(faces[f][0]);
+            positions.push_back(faces[f][0] + faces[f][1]);
+            positions.push_back(faces[f][0] + faces[f][1] + faces[f][2]);
+            positions.push_back(faces[f][0] + faces[f][2]);
+            unsigned int quad[6] = { first, first + 1, first + 2, first, first + 2, first + 3 };
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+
+    // whether the segment from origin to target passes through box
+    bool segmentHits(const glm::vec3& origin, const glm::vec3& target, const Box& box) {
+        glm::vec3 direction = target - origin;
+        float enter = 0.0f, exit = 1.0f;
+        for (int axis = 0; axis < 3; axis++) {
+            if (std::fabs(direction[axis]) < 1e-8f) {
+                if (origin[axis] < box.min[axis] || origin[axis] > box.max[axis])
+                    return false;
+                continue;
+            }
+            float t0 = (box.min[axis] - origin[axis]) / direction[axis];
+            float t1 = (box.max[axis] - origin[axis]) / direction[axis];
+            enter = std::max(enter, std::min(t0, t1));
+            exit = std::min(exit, std::max(t0, t1));
+        }
+        return enter < exit;
+    }
+
+    const int SPATIAL_SIZES[3] = { 1000, 10000, 100000 };
+    const float SPATIAL_EXTENT = 500.0f;
+    const int SPATIAL_QUERIES = 200;
+    const int SPATIAL_MOVE_FRAMES = 30;
+
+    // times query (filling values) against the linear scan with test over
+    // every box, and counts the boxes the scan finds but the query misses
+    template <typename Test, typename Query>
+    void compareQueries(const char* name, const std::vector<Box>& boxes, int queries, Test test, Query query) {
+        std::vector<uint32_t> values;
+        values.reserve(boxes.size());
+        size_t linearResults = 0, treeResults = 0, missed = 0;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int q = 0; q < queries; q++) {
+            for (size_t i = 0; i < boxes.size(); i++)
+                linearResults += test(q, boxes[i]) ? 1 : 0;
+        }
+        double linearMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        for (int q = 0; q < queries; q++) {
+            query(q, values);
+            treeResults += values.size();
+        }
+        double treeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::vector<unsigned char> found(boxes.size());
+        for (int q = 0; q < queries; q++) {
+            query(q, values);
+            std::fill(found.begin(), found.end(), 0);
+            for (size_t v = 0; v < values.size(); v++)
+                found[values[v]] = 1;
+            for (size_t i = 0; i < boxes.size(); i++)
+                missed += test(q, boxes[i]) && !found[i] ? 1 : 0;
+        }
+
+        std::cout << std::setw(7) << boxes.size() << " | " << std::left << std::setw(15) << name << std::right << " | "
+                  << std::setw(9) << std::fixed << std::setprecision(4) << linearMs / queries << " | "
+                  << std::setw(8) << treeMs / queries << " | "
+                  << std::setw(8) << std::setprecision(1) << static_cast<double>(linearResults) / queries << " | "
+                  << std::setw(8) << static_cast<double>(treeResults) / queries << " | "
+                  << std::setw(6) << missed << std::endl;
+    }
+}
+
+void Benchmark::runLighting(DeferredRenderer& deferred, Shader& forwardShader, LightBuffer& lightBuffer,
+                            const std::function<void(Shader&)>& drawOpaque,
+                            const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos,
+                            const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+    const unsigned int lightCounts[] = { 1, 16, 128, 1024 };
+    GpuTimer timer;
+
+    forwardShader.use();
+    forwardShader.setMat4("view", view);
+    forwardShader.setMat4("projection", projection);
+    forwardShader.setVec3("viewPos", viewPos);
+
+    std::cout << "lights | forward ms | deferred ms" << std::endl;
+    for (size_t c = 0; c < sizeof(lightCounts) / sizeof(lightCounts[0]); c++) {
+        lightBuffer.upload(randomLights(lightCounts[c], boundsMin, boundsMax));
+
+        double forwardTotal = 0.0;
+        for (int frame = 0; frame < WARMUP_FRAMES + MEASURED_FRAMES; frame++) {
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            timer.begin();
+            lightBuffer.bind(forwardShader);
+            drawOpaque(forwardShader);
+            timer.end();
+            double ms = timer.waitMilliseconds();
+            if (frame >= WARMUP_FRAMES)
+                forwardTotal += ms;
+        }
+
+        double deferredTotal = 0.0;
+        for (int frame = 0; frame < WARMUP_FRAMES + MEASURED_FRAMES; frame++) {
+            timer.begin();
+            deferred.beginGeometryPass(view, projection);
+            drawOpaque(deferred.getGeometryShader());
+            deferred.endGeometryPass();
+            deferred.lightingPass(lightBuffer, view, projection, viewPos);
+            timer.end();
+            double ms = timer.waitMilliseconds();
+            if (frame >= WARMUP_FRAMES)
+                deferredTotal += ms;
+        }
+
+        std::cout << std::setw(6) << lightCounts[c] << " | "
+                  << std::setw(10) << std::fixed << std::setprecision(3) << forwardTotal / MEASURED_FRAMES << " | "
+                  << std::setw(11) << deferredTotal / MEASURED_FRAMES << std::endl;
+    }
+}
+
+void Benchmark::runJobScaling() {
+    SyntheticScene scene;
+    buildSyntheticScene(scene);
+    unsigned int hardware = std::max(std::thread::hardware_concurrency(), 1u);
+
+    std::cout << SCENE_OBJECTS << " objects culled, " << SCENE_MESHES << " meshes of " << MESH_VERTICES
+              << " vertices bounded, " << JOB_ITERATIONS << " iterations" << std::endl;
+    std::cout << "threads | cull ms | bounds ms | speedup" << std::endl;
+    double baseline = 0.0;
+    for (unsigned int threads = 1; threads <= hardware; threads++) {
+        JobSystem::initialize(threads - 1);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int i = 0; i < JOB_ITERATIONS; i++)
+            JobSystem::parallelFor(SCENE_OBJECTS, 2048, [&scene](size_t begin, size_t end) { cullObjects(scene, begin, end); });
+        std::chrono::steady_clock::time_point culled = std::chrono::steady_clock::now();
+        for (int i = 0; i < JOB_ITERATIONS; i++)
+            JobSystem::parallelFor(SCENE_MESHES, 1, [&scene](size_t begin, size_t end) { meshBounds(scene, begin, end); });
+        std::chrono::steady_clock::time_point bounded = std::chrono::steady_clock::now();
+
+        double cullMs = std::chrono::duration<double, std::milli>(culled - start).count() / JOB_ITERATIONS;
+        double boundsMs = std::chrono::duration<double, std::milli>(bounded - culled).count() / JOB_ITERATIONS;
+        if (threads == 1)
+            baseline = cullMs + boundsMs;
+        std::cout << std::setw(7) << threads << " | "
+                  << std::setw(7) << std::fixed << std::setprecision(3) << cullMs << " | "
+                  << std::setw(9) << boundsMs << " | "
+                  << std::setw(6) << std::setprecision(2) << baseline / (cullMs + boundsMs) << "x" << std::endl;
+    }
+
+    size_t visible = 0;
+    for (size_t i = 0; i < scene.visible.size(); i++)
+        visible += scene.visible[i];
+    std::cout << visible << " objects visible" << std::endl;
+
+    // back to the default worker count
+    JobSystem::initialize();
+}
+
+void Benchmark::runCutting() {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    buildSphere(vertices, indices);
+    size_t triangles = indices.size() / 3;
+
+    std::vector<CutShape> single(1, CutShape::cylinder(SliceCylinder{ glm::vec3(0.0f, 0.1f, -2.0f), glm::vec3(0.0f, 0.1f, 2.0f), 0.2f }));
+    std::vector<CutShape> batch;
+    for (int i = 0; i < 8; i++) {
+        float angle = i * 3.14159265f / 8.0f;
+        glm::vec3 direction(std::cos(angle), 0.3f, std::sin(angle));
+        batch.push_back(CutShape::cylinder(SliceCylinder{ -2.0f * direction, 2.0f * direction, 0.1f }));
+    }
+    std::vector<CutShape> plane(1, CutShape::plane(glm::vec3(0.1f, 0.0f, 0.0f), glm::normalize(glm::vec3(1.0f, 0.2f, 0.1f))));
+
+    struct Case {
+        const char* name;
+        const std::vector<CutShape>* shapes;
+        bool caps;
+    };
+    const Case cases[] = {
+        { "cylinder", &single, false },
+        { "8 cylinders", &batch, false },
+        { "plane + caps", &plane, true }
+    };
+
+    std::cout << triangles << " triangles, " << JobSystem::getThreadCount() << " threads, "
+              << CUT_ITERATIONS << " iterations" << std::endl;
+    std::cout << "cut          | ms      | Mtri/s  | clipped | cap tris" << std::endl;
+    std::vector<Vertex> outVertices;
+    std::vector<unsigned int> outIndices;
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        CutStats stats;
+        // the first cut sizes the output; each cut is a frame, so the scratch arena is recycled
+        MeshCutter::cut(vertices, indices, cases[c].shapes->data(), cases[c].shapes->size(), cases[c].caps, outVertices, outIndices, &stats);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int i = 0; i < CUT_ITERATIONS; i++) {
+            FrameAllocator::beginFrame();
+            MeshCutter::cut(vertices, indices, cases[c].shapes->data(), cases[c].shapes->size(), cases[c].caps, outVertices, outIndices, &stats);
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / CUT_ITERATIONS;
+        std::cout << std::left << std::setw(12) << cases[c].name << std::right << " | "
+                  << std::setw(7) << std::fixed << std::setprecision(3) << ms << " | "
+                  << std::setw(7) << std::setprecision(2) << triangles / (ms * 1000.0) << " | "
+                  << std::setw(7) << stats.clippedTriangles << " | "
+                  << std::setw(8) << stats.capTriangles << std::endl;
+    }
+}
+
+void Benchmark::runTransforms() {
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::vector<glm::vec3> positions(TRANSFORM_COUNT), rotations(TRANSFORM_COUNT), scales(TRANSFORM_COUNT);
+    std::vector<TransformHandle> handles(TRANSFORM_COUNT);
+    TransformSystem::reserve(TransformSystem::getCount() + TRANSFORM_COUNT);
+    for (int i = 0; i < TRANSFORM_COUNT; i++) {
+        positions[i] = glm::vec3(unit(rng), unit(rng), unit(rng)) * 100.0f;
+        rotations[i] = glm::vec3(unit(rng), unit(rng), unit(rng)) * 180.0f;
+        scales[i] = glm::vec3(1.0f + 0.5f * unit(rng));
+        handles[i] = TransformSystem::create();
+        TransformSystem::setRotation(handles[i], rotations[i]);
+        TransformSystem::setScale(handles[i], scales[i]);
+    }
+
+    // moves every stride-th transform, then times the batch update
+    auto timeUpdate = [&](int stride) {
+        double total = 0.0;
+        for (int iteration = 0; iteration < TRANSFORM_ITERATIONS; iteration++) {
+            glm::vec3 offset(0.01f * (iteration + 1));
+            for (int i = 0; i < TRANSFORM_COUNT; i += stride)
+                TransformSystem::setPosition(handles[i], positions[i] + offset);
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            TransformSystem::update();
+            total += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+        return total / TRANSFORM_ITERATIONS;
+    };
+
+    std::cout << TRANSFORM_COUNT << " transforms, " << JobSystem::getThreadCount() << " threads, "
+              << TRANSFORM_ITERATIONS << " iterations" << std::endl;
+    std::cout << "update            | ms" << std::endl;
+    auto print = [](const char* name, double ms) {
+        std::cout << std::left << std::setw(17) << name << std::right << " | "
+                  << std::setw(7) << std::fixed << std::setprecision(3) << ms << std::endl;
+    };
+    TransformSystem::update();
+    print("all dirty", timeUpdate(1));
+    print("10% dirty", timeUpdate(10));
+    print("none dirty", timeUpdate(TRANSFORM_COUNT + 1));
+
+    for (int i = 0; i < TRANSFORM_COUNT; i++) {
+        TransformSystem::setRotationMode(handles[i], RotationMode::ALL);
+        TransformSystem::setTarget(handles[i], glm::vec3(0.0f));
+    }
+    TransformSystem::update();
+    print("look-at all dirty", timeUpdate(1));
+
+    // what every query used to cost: three axis rotations on top of the translation
+    std::vector<glm::mat4> matrices(TRANSFORM_COUNT);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int iteration = 0; iteration < TRANSFORM_ITERATIONS; iteration++) {
+        for (int i = 0; i < TRANSFORM_COUNT; i++) {
+            glm::mat4 matrix = glm::translate(glm::mat4(1.0f), positions[i]);
+            matrix = glm::rotate(matrix, glm::radians(rotations[i].x), glm::vec3(1.0f, 0.0f, 0.0f));
+            matrix = glm::rotate(matrix, glm::radians(rotations[i].y), glm::vec3(0.0f, 1.0f, 0.0f));
+            matrix = glm::rotate(matrix, glm::radians(rotations[i].z), glm::vec3(0.0f, 0.0f, 1.0f));
+            matrices[i] = glm::scale(matrix, scales[i]);
+        }
+    }
+    print("glm, serial", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / TRANSFORM_ITERATIONS);
+
+    for (int i = 0; i < TRANSFORM_COUNT; i++)
+        TransformSystem::destroy(handles[i]);
+}
+
+void Benchmark::runAnimation() {
+    Model model;
+    buildSyntheticSkeleton(model);
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<TransformHandle> handles(ANIMATED_CHARACTERS);
+    std::vector<Animator*> characters(ANIMATED_CHARACTERS);
+    for (int i = 0; i < ANIMATED_CHARACTERS; i++) {
+        handles[i] = TransformSystem::create();
+        characters[i] = new Animator(model, handles[i]);
+        characters[i]->play(0);
+        characters[i]->setSpeed(0.8f + 0.4f * unit(rng));
+    }
+
+    // places the characters around the viewer within radius and times the updates
+    auto timeUpdate = [&](float radius, size_t& evaluated) {
+        for (int i = 0; i < ANIMATED_CHARACTERS; i++) {
+            float angle = 6.2831853f * unit(rng);
+            float distance = radius * unit(rng);
+            TransformSystem::setPosition(handles[i], glm::vec3(std::cos(angle), 0.0f, std::sin(angle)) * distance);
+        }
+        TransformSystem::update();
+        AnimationSystem::update(1.0f / 60.0f, glm::vec3(0.0f));
+        evaluated = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < ANIMATION_FRAMES; frame++) {
+            AnimationSystem::update(1.0f / 60.0f, glm::vec3(0.0f));
+            evaluated += AnimationSystem::getLastEvaluatedCount();
+        }
+        evaluated /= ANIMATION_FRAMES;
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / ANIMATION_FRAMES;
+    };
+
+    const AnimationCompressionStats& stats = model.animationStats;
+    std::cout << ANIMATED_CHARACTERS << " characters, " << SKELETON_BONES << " bones, "
+              << JobSystem::getThreadCount() << " threads" << std::endl;
+    std::cout << "clip: " << stats.keptKeys << " of " << stats.rawKeys << " keys kept, "
+              << stats.rawBytes << " -> " << stats.compressedBytes << " bytes" << std::endl;
+    std::cout << "viewer            | ms/frame | evaluated/frame" << std::endl;
+    auto print = [](const char* name, double ms, size_t evaluated) {
+        std::cout << std::left << std::setw(17) << name << std::right << " | "
+                  << std::setw(8) << std::fixed << std::setprecision(3) << ms << " | "
+                  << std::setw(15) << evaluated << std::endl;
+    };
+    size_t evaluated;
+    double ms = timeUpdate(1.0f, evaluated);
+    print("all close", ms, evaluated);
+    ms = timeUpdate(100.0f, evaluated);
+    print("spread over 100", ms, evaluated);
+
+    for (int i = 0; i < ANIMATED_CHARACTERS; i++) {
+        delete characters[i];
+        TransformSystem::destroy(handles[i]);
+    }
+}
+
+void Benchmark::runOcclusion() {
+    // a maze of rooms seen from eye height, with small boxes on the floor
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    float extent = MAZE_CELLS * MAZE_CELL_SIZE;
+    glm::vec3 origin(-0.5f * extent, 0.0f, -0.5f * extent);
+    std::vector<Box> walls;
+    for (int i = 0; i <= MAZE_CELLS; i++) {
+        for (int j = 0; j < MAZE_CELLS; j++) {
+            bool border = i == 0 || i == MAZE_CELLS;
+            // a door now and then, so rooms see into their neighbours
+            if (border || unit(rng) < 0.6f) {
+                glm::vec3 start = origin + glm::vec3(j * MAZE_CELL_SIZE, 0.0f, i * MAZE_CELL_SIZE);
+                Box wall = { start - glm::vec3(0.0f, 0.0f, WALL_THICKNESS * 0.5f),
+                             start + glm::vec3(MAZE_CELL_SIZE, WALL_HEIGHT, WALL_THICKNESS * 0.5f) };
+                walls.push_back(wall);
+            }
+            if (border || unit(rng) < 0.6f) {
+                glm::vec3 start = origin + glm::vec3(i * MAZE_CELL_SIZE, 0.0f, j * MAZE_CELL_SIZE);
+                Box wall = { start - glm::vec3(WALL_THICKNESS * 0.5f, 0.0f, 0.0f),
+                             start + glm::vec3(WALL_THICKNESS * 0.5f, WALL_HEIGHT, MAZE_CELL_SIZE) };
+                walls.push_back(wall);
+            }
+        }
+    }
+    std::vector<std::vector<glm::vec3> > wallPositions(walls.size());
+    std::vector<std::vector<unsigned int> > wallIndices(walls.size());
+    for (size_t w = 0; w < walls.size(); w++)
+        appendBox(walls[w], wallPositions[w], wallIndices[w]);
+
+    std::vector<Box> boxes(OCCLUDEES);
+    for (int i = 0; i < OCCLUDEES; i++) {
+        glm::vec3 corner = origin + glm::vec3(unit(rng) * extent, 0.0f, unit(rng) * extent);
+        boxes[i].min = corner;
+        boxes[i].max = corner + glm::vec3(0.3f + 0.4f * unit(rng));
+    }
+
+    OcclusionCuller culler;
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 300.0f);
+    glm::vec3 eye(origin.x + 0.5f * MAZE_CELL_SIZE + 0.01f, 1.7f, origin.z + 0.5f * MAZE_CELL_SIZE + 0.01f);
+    double rasterMs = 0.0, testMs = 0.0;
+    size_t inFrustum = 0, culled = 0, wronglyCulled = 0;
+    for (int frame = 0; frame < WARMUP_FRAMES + OCCLUSION_FRAMES; frame++) {
+        // turns on the spot in the corner room, looking across the maze
+        float yaw = 1.5707963f * frame / (WARMUP_FRAMES + OCCLUSION_FRAMES);
+        glm::vec3 forward(std::sin(yaw), -0.05f, std::cos(yaw));
+        glm::mat4 viewProjection = projection * glm::lookAt(eye, eye + forward, glm::vec3(0.0f, 1.0f, 0.0f));
+        Frustum frustum = Frustum::fromMatrix(viewProjection);
+
+        culler.beginFrame(viewProjection);
+        for (size_t w = 0; w < walls.size(); w++)
+            culler.addOccluder(wallPositions[w].data(), sizeof(glm::vec3), wallIndices[w].data(), wallIndices[w].size(),
+                               glm::mat4(1.0f));
+        culler.render();
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::vector<int> hidden;
+        for (int i = 0; i < OCCLUDEES; i++) {
+            if (!frustum.intersectsBounds(boxes[i].min, boxes[i].max))
+                continue;
+            if (frame >= WARMUP_FRAMES)
+                inFrustum++;
+            if (!culler.isVisible(boxes[i].min, boxes[i].max))
+                hidden.push_back(i);
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (frame < WARMUP_FRAMES)
+            continue;
+        rasterMs += culler.getStats().rasterMilliseconds;
+        testMs += ms;
+        culled += hidden.size();
+
+        // a culled box must be hidden from the eye at its center and (almost) every corner
+        for (size_t h = 0; h < hidden.size(); h++) {
+            const Box& box = boxes[hidden[h]];
+            glm::vec3 center = (box.min + box.max) * 0.5f;
+            for (int p = 0; p < 9; p++) {
+                glm::vec3 corner((p & 1) ? box.max.x : box.min.x, (p & 2) ? box.max.y : box.min.y,
+                                 (p & 4) ? box.max.z : box.min.z);
+                glm::vec3 target = p == 8 ? center : glm::mix(center, corner, 0.98f);
+                bool blocked = false;
+                for (size_t w = 0; w < walls.size() && !blocked; w++)
+                    blocked = segmentHits(eye, target, walls[w]);
+                if (!blocked) {
+                    wronglyCulled++;
+                    break;
+                }
+            }
+        }
+    }
+
+    std::cout << walls.size() << " walls (" << walls.size() * 12 << " triangles) as occluders, " << OCCLUDEES
+              << " boxes, " << culler.getWidth() << "x" << culler.getHeight() << " depth, "
+              << OcclusionCuller::getLaneCount() << " pixels per SIMD step, "
+              << JobSystem::getThreadCount() << " threads" << std::endl;
+    std::cout << "raster ms | test ms | in frustum/frame | occluded/frame | wrongly culled" << std::endl;
+    std::cout << std::setw(9) << std::fixed << std::setprecision(3) << rasterMs / OCCLUSION_FRAMES << " | "
+              << std::setw(7) << testMs / OCCLUSION_FRAMES << " | "
+              << std::setw(16) << inFrustum / OCCLUSION_FRAMES << " | "
+              << std::setw(14) << culled / OCCLUSION_FRAMES << " | "
+              << std::setw(14) << wronglyCulled << std::endl;
+}
+
+void Benchmark::runSpatial() {
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    // viewers spread over the world, each with a camera, a look ray, a box and
+    // a sphere around it, and the six faces of a cube shadow at its position
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 300.0f);
+    glm::mat4 faceProjection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 50.0f);
+    const glm::vec3 faceDirections[6] = {
+        glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+        glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+    };
+    const glm::vec3 faceUps[6] = {
+        glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f),
+        glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)
+    };
+    const float VOLUME_RADIUS = 20.0f;
+    std::vector<Frustum> frusta(SPATIAL_QUERIES), faces(SPATIAL_QUERIES * 6);
+    std::vector<SpatialRay> rays(SPATIAL_QUERIES * 32);
+    std::vector<glm::vec3> centers(SPATIAL_QUERIES);
+    for (int q = 0; q < SPATIAL_QUERIES; q++) {
+        glm::vec3 eye = glm::vec3(unit(rng), unit(rng), unit(rng)) * SPATIAL_EXTENT * 0.8f;
+        glm::vec3 forward = glm::normalize(glm::vec3(unit(rng), 0.3f * unit(rng), unit(rng)));
+        frusta[q] = Frustum::fromMatrix(projection * glm::lookAt(eye, eye + forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+        for (int f = 0; f < 6; f++)
+            faces[q * 6 + f] = Frustum::fromMatrix(faceProjection * glm::lookAt(eye, eye + faceDirections[f], faceUps[f]));
+        for (int r = 0; r < 32; r++) {
+            glm::vec3 direction = glm::normalize(forward + 0.2f * glm::vec3(unit(rng), unit(rng), unit(rng)));
+            SpatialRay ray = { eye, direction, 300.0f };
+            rays[q * 32 + r] = ray;
+        }
+        centers[q] = eye;
+    }
+
+    auto rayTest = [](const SpatialRay& ray, const Box& box) {
+        return segmentHits(ray.origin, ray.origin + ray.direction * ray.maxDistance, box);
+    };
+    auto sphereTest = [](const glm::vec3& center, float radius, const Box& box) {
+        glm::vec3 offset = center - glm::clamp(center, box.min, box.max);
+        return glm::dot(offset, offset) <= radius * radius;
+    };
+
+    std::cout << SPATIAL_QUERIES << " queries; batched rows are per 6 faces or 32 rays, the linear scan tests each apart" << std::endl;
+    std::cout << "objects | query           | linear ms | tree ms  | linear   | tree     | missed" << std::endl;
+    for (int size = 0; size < 3; size++) {
+        std::vector<Box> boxes(SPATIAL_SIZES[size]);
+        for (size_t i = 0; i < boxes.size(); i++) {
+            glm::vec3 center = glm::vec3(unit(rng), unit(rng), unit(rng)) * SPATIAL_EXTENT;
+            glm::vec3 half(0.25f + 0.5f * (unit(rng) + 1.0f));
+            boxes[i].min = center - half;
+            boxes[i].max = center + half;
+        }
+        SpatialIndex index;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < boxes.size(); i++)
+            index.insert(boxes[i].min, boxes[i].max, static_cast<uint32_t>(i));
+        double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::vector<uint32_t> faceValues, masks;
+        std::vector<SpatialHit> hits;
+        compareQueries("frustum", boxes, SPATIAL_QUERIES,
+            [&](int q, const Box& box) { return frusta[q].intersectsBounds(box.min, box.max); },
+            [&](int q, std::vector<uint32_t>& values) { index.queryFrustum(frusta[q], values); });
+        compareQueries("ray", boxes, SPATIAL_QUERIES,
+            [&](int q, const Box& box) { return rayTest(rays[q * 32], box); },
+            [&](int q, std::vector<uint32_t>& values) {
+                index.queryRay(rays[q * 32].origin, rays[q * 32].direction, rays[q * 32].maxDistance, hits);
+                values.clear();
+                for (size_t h = 0; h < hits.size(); h++)
+                    values.push_back(hits[h].value);
+            });
+        compareQueries("sphere", boxes, SPATIAL_QUERIES,
+            [&](int q, const Box& box) { return sphereTest(centers[q], VOLUME_RADIUS, box); },
+            [&](int q, std::vector<uint32_t>& values) { index.querySphere(centers[q], VOLUME_RADIUS, values); });
+        compareQueries("box", boxes, SPATIAL_QUERIES,
+            [&](int q, const Box& box) {
+                return glm::all(glm::lessThanEqual(centers[q] - VOLUME_RADIUS, box.max)) &&
+                       glm::all(glm::lessThanEqual(box.min, centers[q] + VOLUME_RADIUS));
+            },
+            [&](int q, std::vector<uint32_t>& values) {
+                index.queryBox(centers[q] - VOLUME_RADIUS, centers[q] + VOLUME_RADIUS, values);
+            });
+        auto inAnyFace = [&](int q, const Box& box) {
+            for (int f = 0; f < 6; f++) {
+                if (faces[q * 6 + f].intersectsBounds(box.min, box.max))
+                    return true;
+            }
+            return false;
+        };
+        compareQueries("6 faces apart", boxes, SPATIAL_QUERIES, inAnyFace,
+            [&](int q, std::vector<uint32_t>& values) {
+                values.clear();
+                for (int f = 0; f < 6; f++) {
+                    index.queryFrustum(faces[q * 6 + f], faceValues);
+                    values.insert(values.end(), faceValues.begin(), faceValues.end());
+                }
+            });
+        compareQueries("6 faces batched", boxes, SPATIAL_QUERIES, inAnyFace,
+            [&](int q, std::vector<uint32_t>& values) { index.queryFrusta(&faces[q * 6], 6, values, masks); });
+        auto onAnyRay = [&](int q, const Box& box) {
+            for (int r = 0; r < 32; r++) {
+                if (rayTest(rays[q * 32 + r], box))
+                    return true;
+            }
+            return false;
+        };
+        compareQueries("32 rays apart", boxes, SPATIAL_QUERIES, onAnyRay,
+            [&](int q, std::vector<uint32_t>& values) {
+                values.clear();
+                for (int r = 0; r < 32; r++) {
+                    const SpatialRay& ray = rays[q * 32 + r];
+                    index.queryRay(ray.origin, ray.direction, ray.maxDistance, hits);
+                    for (size_t h = 0; h < hits.size(); h++)
+                        values.push_back(hits[h].value);
+                }
+            });
+        compareQueries("32 rays batched", boxes, SPATIAL_QUERIES, onAnyRay,
+            [&](int q, std::vector<uint32_t>& values) {
+                index.queryRays(&rays[q * 32], 32, hits);
+                values.clear();
+                for (size_t h = 0; h < hits.size(); h++)
+                    values.push_back(hits[h].value);
+            });
+
+        // every object drifts a little each frame; most stay inside their loose box
+        std::vector<SpatialHandle> handles(boxes.size());
+        std::vector<glm::vec3> velocities(boxes.size());
+        index.clear();
+        for (size_t i = 0; i < boxes.size(); i++) {
+            handles[i] = index.insert(boxes[i].min, boxes[i].max, static_cast<uint32_t>(i));
+            velocities[i] = glm::vec3(unit(rng), unit(rng), unit(rng)) * 0.05f;
+        }
+        size_t reinserted = 0;
+        start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < SPATIAL_MOVE_FRAMES; frame++) {
+            for (size_t i = 0; i < boxes.size(); i++) {
+                boxes[i].min += velocities[i];
+                boxes[i].max += velocities[i];
+                reinserted += index.move(handles[i], boxes[i].min, boxes[i].max, velocities[i]) ? 1 : 0;
+            }
+        }
+        double moveMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << std::setw(7) << boxes.size() << " | build " << std::setprecision(3) << buildMs << " ms, height "
+                  << index.getHeight() << ", moving all " << moveMs / SPATIAL_MOVE_FRAMES << " ms/frame with "
+                  << reinserted / SPATIAL_MOVE_FRAMES << " reinserted" << std::endl;
+    }
+}
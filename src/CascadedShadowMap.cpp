@@ -0,0 +1,176 @@
+#include "CascadedShadowMap.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace {
+    // casters this far beyond a cascade's sphere towards the sun still cast into it
+    const float CASTER_MARGIN = 100.0f;
+    // radii are rounded up to this, so float noise cannot resize a cascade
+    const float RADIUS_STEP = 1.0f / 16.0f;
+    // a cascade whose wanted center moved this part of its radius away is rendered early
+    const float STALE_FRACTION = 0.25f;
+
+    const char* const CASCADE_MATRIX_NAMES[MAX_CASCADES] = {
+        "cascadeMatrices[0]", "cascadeMatrices[1]", "cascadeMatrices[2]", "cascadeMatrices[3]"
+    };
+}
+
+CascadedShadowMap::CascadedShadowMap(unsigned int cascades, unsigned int resolution)
+    : resolution(resolution), cascadeCount(std::max(2u, std::min(cascades, MAX_CASCADES))),
+      splitLambda(0.75f), shadowDistance(100.0f), sunDirection(0.0f), frame(0), lastRendered(0),
+      depthShader("res/shaders/shadow.vert", "res/shaders/shadow_sun.frag") {
+    for (unsigned int i = 0; i < MAX_CASCADES; i++) {
+        splits[i] = 0.0f;
+        radii[i] = 0.0f;
+        rendered[i] = false;
+    }
+    glGenFramebuffers(1, &fbo);
+    createMaps();
+}
+
+CascadedShadowMap::~CascadedShadowMap() {
+    destroyMaps();
+    glDeleteFramebuffers(1, &fbo);
+}
+
+void CascadedShadowMap::createMaps() {
+    glGenTextures(1, &depthArray);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, depthArray);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, resolution, resolution, cascadeCount, 0,
+                 GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    // hardware comparison with linear filtering, a 2x2 PCF per lookup
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthArray, 0, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::FRAMEBUFFER:: Cascaded shadow framebuffer is not complete!" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    for (unsigned int i = 0; i < MAX_CASCADES; i++)
+        rendered[i] = false;
+}
+
+void CascadedShadowMap::destroyMaps() {
+    glDeleteTextures(1, &depthArray);
+}
+
+void CascadedShadowMap::setCascadeCount(unsigned int count) {
+    count = std::max(2u, std::min(count, MAX_CASCADES));
+    if (count == cascadeCount)
+        return;
+    cascadeCount = count;
+    destroyMaps();
+    createMaps();
+}
+
+void CascadedShadowMap::update(const DirectionalLight& sun, const glm::mat4& view, float fovY, float aspect,
+                               float nearPlane, float farPlane) {
+    glm::vec3 direction = glm::normalize(sun.direction);
+    if (direction != sunDirection) {
+        sunDirection = direction;
+        for (unsigned int i = 0; i < MAX_CASCADES; i++)
+            rendered[i] = false;
+    }
+
+    // practical split scheme
+    float farDistance = std::min(farPlane, shadowDistance);
+    for (unsigned int i = 0; i < cascadeCount; i++) {
+        float p = float(i + 1) / cascadeCount;
+        float logarithmic = nearPlane * std::pow(farDistance / nearPlane, p);
+        float uniform = nearPlane + (farDistance - nearPlane) * p;
+        splits[i] = splitLambda * logarithmic + (1.0f - splitLambda) * uniform;
+    }
+
+    glm::mat4 inverseView = glm::inverse(view);
+    float tanY = std::tan(fovY * 0.5f);
+    float tanX = tanY * aspect;
+    // squared slope of the slice's corner edges
+    float k2 = tanX * tanX + tanY * tanY;
+    glm::vec3 up = std::fabs(sunDirection.y) > 0.99f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    float sliceNear = nearPlane;
+    for (unsigned int i = 0; i < cascadeCount; i++) {
+        // smallest sphere around the slice, centered on the view axis; it only
+        // depends on the projection, so turning the camera keeps its size
+        float sliceFar = splits[i];
+        float centerDepth = std::min(0.5f * (sliceNear + sliceFar) * (1.0f + k2), sliceFar);
+        float radius = std::sqrt((sliceFar - centerDepth) * (sliceFar - centerDepth) + k2 * sliceFar * sliceFar);
+        radius = std::ceil(radius / RADIUS_STEP) * RADIUS_STEP;
+        glm::vec3 center = glm::vec3(inverseView * glm::vec4(0.0f, 0.0f, -centerDepth, 1.0f));
+
+        glm::vec3 eye = center - sunDirection * (radius + CASTER_MARGIN);
+        glm::mat4 lightView = glm::lookAt(eye, center, up);
+        glm::mat4 projection = glm::ortho(-radius, radius, -radius, radius, 0.0f, 2.0f * radius + CASTER_MARGIN);
+
+        // move the map in whole texels: where the world origin lands is rounded to a texel
+        glm::vec4 origin = projection * lightView * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        glm::vec2 texels = glm::vec2(origin) * (resolution * 0.5f);
+        glm::vec2 offset = (glm::round(texels) - texels) * (2.0f / resolution);
+        projection[3][0] += offset.x;
+        projection[3][1] += offset.y;
+
+        wantedMatrices[i] = projection * lightView;
+        wantedCenters[i] = center;
+        radii[i] = radius;
+        sliceNear = sliceFar;
+    }
+}
+
+void CascadedShadowMap::render(const DrawCasters& drawCasters) {
+    frame++;
+    lastRendered = 0;
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, resolution, resolution);
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(2.0f, 4.0f);
+
+    for (unsigned int i = 0; i < cascadeCount; i++) {
+        // cascade i > 0 every 2^i frames, on frames none of the others use
+        bool due = i == 0 || frame % (1u << i) == (1u << (i - 1)) - 1;
+        bool stale = !rendered[i] || glm::length(wantedCenters[i] - renderedCenters[i]) > radii[i] * STALE_FRACTION;
+        if (!due && !stale)
+            continue;
+
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthArray, 0, i);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        depthShader.use();
+        depthShader.setMat4("lightSpace", wantedMatrices[i]);
+        drawCasters(depthShader, Frustum::fromMatrix(wantedMatrices[i]));
+
+        renderedMatrices[i] = wantedMatrices[i];
+        renderedCenters[i] = wantedCenters[i];
+        rendered[i] = true;
+        lastRendered++;
+    }
+
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void CascadedShadowMap::bind(Shader& shader) const {
+    glActiveTexture(GL_TEXTURE0 + SUN_SHADOW_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, depthArray);
+    glActiveTexture(GL_TEXTURE0);
+
+    shader.use();
+    shader.setInt("sunShadow", SUN_SHADOW_TEXTURE_UNIT);
+    shader.setInt("cascadeCount", static_cast<int>(cascadeCount));
+    for (unsigned int i = 0; i < cascadeCount; i++)
+        shader.setMat4(CASCADE_MATRIX_NAMES[i], renderedMatrices[i]);
+}
+
+void CascadedShadowMap::bindDisabled(Shader& shader) {
+    shader.use();
+    shader.setInt("sunShadow", SUN_SHADOW_TEXTURE_UNIT);
+    shader.setInt("cascadeCount", 0);
+}
@@ -0,0 +1,232 @@
+#include "ClusteredLighting.h"
+#include "JobSystem.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define CLUSTER_USE_SSE 1
+#endif
+
+ClusteredLighting::ClusteredLighting()
+    : boundsFovY(0.0f), boundsAspect(0.0f), boundsNear(0.0f), boundsFar(0.0f), zScale(0.0f), zBias(0.0f),
+      assignmentCount(0), indexCapacity(0) {
+    bounds.resize(CLUSTER_COUNT);
+    gridData.resize(CLUSTER_COUNT * 2, 0);
+    for (unsigned int z = 0; z < CLUSTER_Z; z++)
+        slices[z].counts.resize(CLUSTER_X * CLUSTER_Y);
+
+    glGenBuffers(1, &gridBuffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, gridBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, gridData.size() * sizeof(unsigned int), gridData.data(), GL_DYNAMIC_DRAW);
+    glGenTextures(1, &gridTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, gridTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, gridBuffer);
+
+    indexCapacity = 1024;
+    glGenBuffers(1, &indexBuffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, indexBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, indexCapacity * sizeof(unsigned int), NULL, GL_DYNAMIC_DRAW);
+    glGenTextures(1, &indexTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, indexTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, indexBuffer);
+
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+ClusteredLighting::~ClusteredLighting() {
+    glDeleteTextures(1, &gridTexture);
+    glDeleteTextures(1, &indexTexture);
+    glDeleteBuffers(1, &gridBuffer);
+    glDeleteBuffers(1, &indexBuffer);
+}
+
+void ClusteredLighting::buildClusterBounds(float fovY, float aspect, float zNear, float zFar) {
+    if (fovY == boundsFovY && aspect == boundsAspect && zNear == boundsNear && zFar == boundsFar)
+        return;
+    boundsFovY = fovY;
+    boundsAspect = aspect;
+    boundsNear = zNear;
+    boundsFar = zFar;
+
+    // slice = log(depth) * zScale + zBias, the same mapping the shader uses
+    zScale = CLUSTER_Z / std::log(zFar / zNear);
+    zBias = -zScale * std::log(zNear);
+
+    float tanY = std::tan(fovY * 0.5f);
+    float tanX = tanY * aspect;
+
+    for (unsigned int z = 0; z < CLUSTER_Z; z++) {
+        float sliceNear = zNear * std::pow(zFar / zNear, float(z) / CLUSTER_Z);
+        float sliceFar = zNear * std::pow(zFar / zNear, float(z + 1) / CLUSTER_Z);
+        for (unsigned int y = 0; y < CLUSTER_Y; y++) {
+            for (unsigned int x = 0; x < CLUSTER_X; x++) {
+                // tile corners in NDC, pushed out to the slice's near and far depth (view space looks down -z)
+                float ndcX0 = 2.0f * x / CLUSTER_X - 1.0f;
+                float ndcX1 = 2.0f * (x + 1) / CLUSTER_X - 1.0f;
+                float ndcY0 = 2.0f * y / CLUSTER_Y - 1.0f;
+                float ndcY1 = 2.0f * (y + 1) / CLUSTER_Y - 1.0f;
+
+                glm::vec3 bmin(std::numeric_limits<float>::max());
+                glm::vec3 bmax(std::numeric_limits<float>::lowest());
+                float depths[2] = { sliceNear, sliceFar };
+                float ndcXs[2] = { ndcX0, ndcX1 };
+                float ndcYs[2] = { ndcY0, ndcY1 };
+                for (int d = 0; d < 2; d++) {
+                    for (int i = 0; i < 2; i++) {
+                        for (int j = 0; j < 2; j++) {
+                            glm::vec3 corner(ndcXs[i] * tanX * depths[d], ndcYs[j] * tanY * depths[d], -depths[d]);
+                            bmin = glm::min(bmin, corner);
+                            bmax = glm::max(bmax, corner);
+                        }
+                    }
+                }
+
+                ClusterBounds& cluster = bounds[(z * CLUSTER_Y + y) * CLUSTER_X + x];
+                cluster.min = bmin;
+                cluster.max = bmax;
+            }
+        }
+    }
+}
+
+void ClusteredLighting::binSlice(unsigned int slice) {
+    SliceOutput& out = slices[slice];
+    size_t maxCandidates = viewLights.size() + 3;
+    out.indices = FrameVector<unsigned int>();
+    out.cx = FrameVector<float>();
+    out.cy = FrameVector<float>();
+    out.cz = FrameVector<float>();
+    out.r2 = FrameVector<float>();
+    out.candidates = FrameVector<unsigned int>();
+    out.cx.reserve(maxCandidates);
+    out.cy.reserve(maxCandidates);
+    out.cz.reserve(maxCandidates);
+    out.r2.reserve(maxCandidates);
+    out.candidates.reserve(maxCandidates);
+
+    // lights overlapping this slice's depth range, in SoA form for the SIMD test
+    const ClusterBounds& first = bounds[slice * CLUSTER_X * CLUSTER_Y];
+    float sliceMinZ = first.min.z;
+    float sliceMaxZ = first.max.z;
+    for (size_t i = 0; i < viewLights.size(); i++) {
+        const glm::vec4& light = viewLights[i];
+        if (light.z - light.w > sliceMaxZ || light.z + light.w < sliceMinZ)
+            continue;
+        out.cx.push_back(light.x);
+        out.cy.push_back(light.y);
+        out.cz.push_back(light.z);
+        out.r2.push_back(light.w * light.w);
+        out.candidates.push_back(static_cast<unsigned int>(i));
+    }
+    // pad to a multiple of four with spheres that can never pass
+    while (out.cx.size() % 4 != 0) {
+        out.cx.push_back(0.0f);
+        out.cy.push_back(0.0f);
+        out.cz.push_back(0.0f);
+        out.r2.push_back(-1.0f);
+    }
+
+    for (unsigned int tile = 0; tile < CLUSTER_X * CLUSTER_Y; tile++) {
+        const ClusterBounds& cluster = bounds[slice * CLUSTER_X * CLUSTER_Y + tile];
+        size_t before = out.indices.size();
+
+#ifdef CLUSTER_USE_SSE
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 minX = _mm_set1_ps(cluster.min.x), maxX = _mm_set1_ps(cluster.max.x);
+        const __m128 minY = _mm_set1_ps(cluster.min.y), maxY = _mm_set1_ps(cluster.max.y);
+        const __m128 minZ = _mm_set1_ps(cluster.min.z), maxZ = _mm_set1_ps(cluster.max.z);
+        for (size_t k = 0; k < out.cx.size(); k += 4) {
+            __m128 cx = _mm_loadu_ps(&out.cx[k]);
+            __m128 cy = _mm_loadu_ps(&out.cy[k]);
+            __m128 cz = _mm_loadu_ps(&out.cz[k]);
+            // distance from the sphere center to the box along each axis
+            __m128 dx = _mm_add_ps(_mm_max_ps(_mm_sub_ps(minX, cx), zero), _mm_max_ps(_mm_sub_ps(cx, maxX), zero));
+            __m128 dy = _mm_add_ps(_mm_max_ps(_mm_sub_ps(minY, cy), zero), _mm_max_ps(_mm_sub_ps(cy, maxY), zero));
+            __m128 dz = _mm_add_ps(_mm_max_ps(_mm_sub_ps(minZ, cz), zero), _mm_max_ps(_mm_sub_ps(cz, maxZ), zero));
+            __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            int mask = _mm_movemask_ps(_mm_cmple_ps(d2, _mm_loadu_ps(&out.r2[k])));
+            for (int b = 0; b < 4; b++) {
+                if (mask & (1 << b))
+                    out.indices.push_back(out.candidates[k + b]);
+            }
+        }
+#else
+        for (size_t k = 0; k < out.candidates.size(); k++) {
+            float dx = std::max(cluster.min.x - out.cx[k], 0.0f) + std::max(out.cx[k] - cluster.max.x, 0.0f);
+            float dy = std::max(cluster.min.y - out.cy[k], 0.0f) + std::max(out.cy[k] - cluster.max.y, 0.0f);
+            float dz = std::max(cluster.min.z - out.cz[k], 0.0f) + std::max(out.cz[k] - cluster.max.z, 0.0f);
+            if (dx * dx + dy * dy + dz * dz <= out.r2[k])
+                out.indices.push_back(out.candidates[k]);
+        }
+#endif
+        out.counts[tile] = static_cast<unsigned int>(out.indices.size() - before);
+    }
+}
+
+void ClusteredLighting::update(const std::vector<PointLight>& lights, const glm::mat4& view,
+                               float fovY, float aspect, float zNear, float zFar) {
+    buildClusterBounds(fovY, aspect, zNear, zFar);
+
+    viewLights = FrameVector<glm::vec4>(lights.size());
+    for (size_t i = 0; i < lights.size(); i++) {
+        glm::vec4 center = view * glm::vec4(lights[i].position, 1.0f);
+        viewLights[i] = glm::vec4(glm::vec3(center), lights[i].radius());
+    }
+
+    // slices write only their own SliceOutput, so they bin independently
+    JobSystem::parallelFor(CLUSTER_Z, 1, [this](size_t begin, size_t end) {
+        TRACE_SCOPE("cluster binning");
+        for (size_t z = begin; z < end; z++)
+            binSlice(static_cast<unsigned int>(z));
+    });
+
+    // stitch the per slice lists into one index list with (offset, count) per cluster
+    size_t indexCount = 0;
+    for (unsigned int z = 0; z < CLUSTER_Z; z++)
+        indexCount += slices[z].indices.size();
+    FrameVector<unsigned int> indexData;
+    indexData.reserve(indexCount);
+    for (unsigned int z = 0; z < CLUSTER_Z; z++) {
+        const SliceOutput& out = slices[z];
+        unsigned int offset = static_cast<unsigned int>(indexData.size());
+        for (unsigned int tile = 0; tile < CLUSTER_X * CLUSTER_Y; tile++) {
+            unsigned int cluster = z * CLUSTER_X * CLUSTER_Y + tile;
+            gridData[cluster * 2] = offset;
+            gridData[cluster * 2 + 1] = out.counts[tile];
+            offset += out.counts[tile];
+        }
+        indexData.insert(indexData.end(), out.indices.begin(), out.indices.end());
+    }
+    assignmentCount = static_cast<unsigned int>(indexData.size());
+
+    glBindBuffer(GL_TEXTURE_BUFFER, gridBuffer);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, gridData.size() * sizeof(unsigned int), gridData.data());
+    glBindBuffer(GL_TEXTURE_BUFFER, indexBuffer);
+    if (indexData.size() > indexCapacity) {
+        indexCapacity = indexData.size() * 2;
+        glBufferData(GL_TEXTURE_BUFFER, indexCapacity * sizeof(unsigned int), NULL, GL_DYNAMIC_DRAW);
+    }
+    if (!indexData.empty())
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, indexData.size() * sizeof(unsigned int), indexData.data());
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void ClusteredLighting::bind(Shader& shader, unsigned int screenWidth, unsigned int screenHeight) const {
+    glActiveTexture(GL_TEXTURE0 + CLUSTER_GRID_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, gridTexture);
+    glActiveTexture(GL_TEXTURE0 + CLUSTER_INDEX_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, indexTexture);
+    glActiveTexture(GL_TEXTURE0);
+
+    shader.use();
+    shader.setInt("clusterGrid", CLUSTER_GRID_TEXTURE_UNIT);
+    shader.setInt("clusterIndices", CLUSTER_INDEX_TEXTURE_UNIT);
+    shader.setFloat("clusterZScale", zScale);
+    shader.setFloat("clusterZBias", zBias);
+    shader.setVec2("clusterTileSize", glm::vec2(float(screenWidth) / CLUSTER_X, float(screenHeight) / CLUSTER_Y));
+}
@@ -0,0 +1,220 @@
+#include "DeferredRenderer.h"
+#include "CascadedShadowMap.h"
+#include "PointShadowMap.h"
+#include <glm/gtc/constants.hpp>
+#include <iostream>
+#include <vector>
+
+DeferredRenderer::DeferredRenderer(unsigned int width, unsigned int height)
+    : width(width), height(height),
+      geometryShader("res/shaders/gbuffer.vert", "res/shaders/gbuffer.frag"),
+      lightShader("res/shaders/deferred_light.vert", "res/shaders/deferred_light.frag"),
+      sunShader("res/shaders/postprocess.vert", "res/shaders/deferred_sun.frag") {
+    createTargets();
+    createLightVolume();
+    // the sun's triangle comes from gl_VertexID, but core profile still wants a VAO bound
+    glGenVertexArrays(1, &fullscreenVAO);
+
+    geometryShader.use();
+    geometryShader.setInt("material.diffuse", 0);
+    geometryShader.setInt("material.specular", 1);
+    geometryShader.setFloat("material.shininess", 1.0f);
+
+    lightShader.use();
+    lightShader.setInt("gAlbedoSpec", 0);
+    lightShader.setInt("gNormal", 1);
+    lightShader.setInt("gMaterial", 2);
+    lightShader.setInt("gDepth", 3);
+    PointShadowMap::bindDisabled(lightShader);
+
+    sunShader.use();
+    sunShader.setInt("gAlbedoSpec", 0);
+    sunShader.setInt("gNormal", 1);
+    sunShader.setInt("gMaterial", 2);
+    sunShader.setInt("gDepth", 3);
+    CascadedShadowMap::bindDisabled(sunShader);
+}
+
+DeferredRenderer::~DeferredRenderer() {
+    destroyTargets();
+    glDeleteVertexArrays(1, &sphereVAO);
+    glDeleteBuffers(1, &sphereVBO);
+    glDeleteBuffers(1, &sphereEBO);
+    glDeleteVertexArrays(1, &fullscreenVAO);
+}
+
+void DeferredRenderer::resize(unsigned int newWidth, unsigned int newHeight) {
+    if (newWidth == 0 || newHeight == 0 || (newWidth == width && newHeight == height))
+        return;
+    width = newWidth;
+    height = newHeight;
+    destroyTargets();
+    createTargets();
+}
+
+void DeferredRenderer::createTargets() {
+    glGenFramebuffers(1, &gBuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+
+    // albedo.rgb
+    glGenTextures(1, &gAlbedoSpec);
+    glBindTexture(GL_TEXTURE_2D, gAlbedoSpec);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gAlbedoSpec, 0);
+
+    // world space normal
+    glGenTextures(1, &gNormal);
+    glBindTexture(GL_TEXTURE_2D, gNormal);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_HALF_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gNormal, 0);
+
+    // material params: specular color, shininess / 256
+    glGenTextures(1, &gMaterial);
+    glBindTexture(GL_TEXTURE_2D, gMaterial);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, gMaterial, 0);
+
+    // depth, same format as the default framebuffer so it can be blitted across
+    glGenTextures(1, &gDepth);
+    glBindTexture(GL_TEXTURE_2D, gDepth);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, gDepth, 0);
+
+    unsigned int attachments[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+    glDrawBuffers(3, attachments);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::FRAMEBUFFER:: G-buffer is not complete!" << std::endl;
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void DeferredRenderer::destroyTargets() {
+    unsigned int textures[4] = { gAlbedoSpec, gNormal, gMaterial, gDepth };
+    glDeleteTextures(4, textures);
+    glDeleteFramebuffers(1, &gBuffer);
+}
+
+void DeferredRenderer::createLightVolume() {
+    // low poly UV sphere; the vertex shader inflates it slightly so its flat
+    // faces still enclose the true light sphere
+    const unsigned int stacks = 12;
+    const unsigned int slices = 16;
+    std::vector<glm::vec3> positions;
+    std::vector<unsigned int> indices;
+
+    for (unsigned int i = 0; i <= stacks; i++) {
+        float phi = glm::pi<float>() * i / stacks;
+        for (unsigned int j = 0; j <= slices; j++) {
+            float theta = 2.0f * glm::pi<float>() * j / slices;
+            positions.push_back(glm::vec3(sin(phi) * cos(theta), cos(phi), sin(phi) * sin(theta)));
+        }
+    }
+    for (unsigned int i = 0; i < stacks; i++) {
+        for (unsigned int j = 0; j < slices; j++) {
+            unsigned int first = i * (slices + 1) + j;
+            unsigned int second = first + slices + 1;
+            indices.push_back(first);
+            indices.push_back(first + 1);
+            indices.push_back(second);
+            indices.push_back(second);
+            indices.push_back(first + 1);
+            indices.push_back(second + 1);
+        }
+    }
+    sphereIndexCount = static_cast<unsigned int>(indices.size());
+
+    glGenVertexArrays(1, &sphereVAO);
+    glGenBuffers(1, &sphereVBO);
+    glGenBuffers(1, &sphereEBO);
+
+    glBindVertexArray(sphereVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, sphereVBO);
+    glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), positions.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphereEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+    glBindVertexArray(0);
+}
+
+void DeferredRenderer::beginGeometryPass(const glm::mat4& view, const glm::mat4& projection) {
+    glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+    glViewport(0, 0, width, height);
+    // blending would mix material params with the clear color
+    glDisable(GL_BLEND);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    geometryShader.use();
+    geometryShader.setMat4("view", view);
+    geometryShader.setMat4("projection", projection);
+}
+
+void DeferredRenderer::endGeometryPass() {
+    glEnable(GL_BLEND);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void DeferredRenderer::lightingPass(const LightBuffer& lights, const glm::mat4& view, const glm::mat4& projection,
+                                    const glm::vec3& viewPos, unsigned int targetFBO, const DirectionalLight* sun) {
+    glBindFramebuffer(GL_FRAMEBUFFER, targetFBO);
+    glViewport(0, 0, width, height);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, gAlbedoSpec);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, gNormal);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, gMaterial);
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_2D, gDepth);
+    glActiveTexture(GL_TEXTURE0);
+
+    lights.bind(lightShader);
+    lightShader.setMat4("view", view);
+    lightShader.setMat4("projection", projection);
+    lightShader.setMat4("inverseViewProjection", glm::inverse(projection * view));
+    lightShader.setVec3("viewPos", viewPos);
+    lightShader.setVec2("screenSize", glm::vec2(width, height));
+
+    // one instanced draw for all light volumes; back faces only so a volume
+    // still shades when the camera is inside it
+    glDisable(GL_DEPTH_TEST);
+    glDepthMask(GL_FALSE);
+    glCullFace(GL_FRONT);
+    glBlendFunc(GL_ONE, GL_ONE);
+
+    glBindVertexArray(sphereVAO);
+    glDrawElementsInstanced(GL_TRIANGLES, sphereIndexCount, GL_UNSIGNED_INT, 0, lights.count());
+    glBindVertexArray(0);
+    glCullFace(GL_BACK);
+
+    if (sun) {
+        sun->bind(sunShader);
+        sunShader.setMat4("inverseViewProjection", glm::inverse(projection * view));
+        sunShader.setVec3("viewPos", viewPos);
+        glBindVertexArray(fullscreenVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+    }
+
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDepthMask(GL_TRUE);
+    glEnable(GL_DEPTH_TEST);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, gBuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, targetFBO);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, targetFBO);
+}
@@ -1,73 +1,70 @@
 #include "Drawer.h"
 
-Drawer::Drawer(Model& model, Shader& shader) : model(model), shader(shader) {
-    position = glm::vec3(0.0f);
-    scale = glm::vec3(1.0f);
-    rotation = glm::vec3(0.0f);
-    rotationMode = RotationMode::NONE;
-    target = glm::vec3(0.0f);
+Drawer::Drawer(Model& model, Shader& shader) : model(model), shader(shader), animator(nullptr) {
+    transform = TransformSystem::create();
 }
 
-glm::mat4 Drawer::calculateModelMatrix() const {
-    glm::mat4 modelMatrix = glm::mat4(1.0f);
-    modelMatrix = glm::translate(modelMatrix, position);
-    
-    // Apply initial rotation first
-    modelMatrix = glm::rotate(modelMatrix, glm::radians(rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
-    modelMatrix = glm::rotate(modelMatrix, glm::radians(rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
-    modelMatrix = glm::rotate(modelMatrix, glm::radians(rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
-    
-    // Calculate rotation based on target
-    if (rotationMode != RotationMode::NONE) {
-        glm::vec3 direction = glm::normalize(target - position);
-        
-        switch(rotationMode) {
-            case RotationMode::Y_ONLY: {
-                float yaw = glm::degrees(atan2(direction.x, direction.z));
-                modelMatrix = glm::rotate(modelMatrix, glm::radians(yaw), glm::vec3(0.0f, 1.0f, 0.0f));
-                break;
-            }
-            case RotationMode::ALL: {
-                float yaw = glm::degrees(atan2(direction.x, direction.z));
-                float pitch = glm::degrees(-atan2(direction.y, glm::length(glm::vec2(direction.x, direction.z))));
-                
-                modelMatrix = glm::rotate(modelMatrix, glm::radians(yaw), glm::vec3(0.0f, 1.0f, 0.0f));
-                modelMatrix = glm::rotate(modelMatrix, glm::radians(pitch), glm::vec3(1.0f, 0.0f, 0.0f));
-                break;
-            }
-            default:
-                break;
-        }
+Drawer::~Drawer() {
+    TransformSystem::destroy(transform);
+}
+
+glm::mat3 Drawer::calculateNormalMatrix(const glm::mat4& modelMatrix) const {
+    // Rotations are orthonormal, so with a uniform scale the upper 3x3 already
+    // points normals the right way (the shaders renormalize); only a
+    // non-uniform scale needs the inverse transpose
+    glm::vec3 scale = getScale();
+    if (scale.x == scale.y && scale.y == scale.z) {
+        return glm::mat3(modelMatrix);
     }
-    
-    modelMatrix = glm::scale(modelMatrix, scale);
-    return modelMatrix;
+    return glm::transpose(glm::inverse(glm::mat3(modelMatrix)));
+}
+
+void Drawer::getWorldBounds(glm::vec3& boundsMin, glm::vec3& boundsMax) const {
+    glm::mat4 modelMatrix = calculateModelMatrix();
+    glm::vec3 localMin = model.getBoundingBoxMin();
+    glm::vec3 localMax = model.getBoundingBoxMax();
+    glm::vec3 center = glm::vec3(modelMatrix * glm::vec4((localMin + localMax) * 0.5f, 1.0f));
+    glm::vec3 halfExtent = (localMax - localMin) * 0.5f;
+    glm::mat3 axes(modelMatrix);
+    glm::vec3 worldExtent = glm::abs(axes[0]) * halfExtent.x + glm::abs(axes[1]) * halfExtent.y + glm::abs(axes[2]) * halfExtent.z;
+    boundsMin = center - worldExtent;
+    boundsMax = center + worldExtent;
 }
 
 void Drawer::draw() {
-    shader.use();
-    shader.setMat4("model", calculateModelMatrix());
-    model.Draw(shader);
+    draw(shader);
+}
+
+void Drawer::draw(Shader& overrideShader) {
+    glm::mat4 modelMatrix = calculateModelMatrix();
+    overrideShader.use();
+    glm::mat3 normalMatrix = calculateNormalMatrix(modelMatrix);
+    overrideShader.setMat4("model", modelMatrix);
+    overrideShader.setMat3("normalMatrix", normalMatrix);
+    bool skinning = animator && animator->isActive();
+    if (skinning)
+        overrideShader.setInt("paletteOffset", animator->getPaletteOffset());
+    model.Draw(overrideShader, modelMatrix, normalMatrix, skinning);
 }
 
 void Drawer::setPosition(const glm::vec3& pos) {
-    position = pos;
+    TransformSystem::setPosition(transform, pos);
 }
 
 void Drawer::setScale(const glm::vec3& s) {
-    scale = s;
+    TransformSystem::setScale(transform, s);
 }
 
 void Drawer::setRotation(const glm::vec3& rot) {
-    rotation = rot;
+    TransformSystem::setRotation(transform, rot);
 }
 
 void Drawer::setRotationMode(RotationMode mode) {
-    rotationMode = mode;
+    TransformSystem::setRotationMode(transform, mode);
 }
 
 void Drawer::setTarget(const glm::vec3& newTarget) {
-    target = newTarget;
+    TransformSystem::setTarget(transform, newTarget);
 }
 
 Model& Drawer::getModel() {
@@ -79,50 +76,47 @@ void Drawer::setModel(Model& newModel) {
 }
 
 void Drawer::setupBoundingBox(Shader& lineShader) {
+    // one unit cube outline shared by every drawer, scaled onto the model bounds
+    static unsigned int boxVAO = 0;
+    if (boxVAO == 0) {
+        const glm::vec3 vertices[] = {
+            glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f),
+            glm::vec3(1.0f, 1.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+            glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(1.0f, 0.0f, 1.0f),
+            glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(0.0f, 1.0f, 1.0f)
+        };
+        const unsigned int indices[] = {
+            0, 1, 1, 2, 2, 3, 3, 0,  // Front face
+            4, 5, 5, 6, 6, 7, 7, 4,  // Back face
+            0, 4, 1, 5, 2, 6, 3, 7   // Connecting lines
+        };
+
+        unsigned int VBO, EBO;
+        glGenVertexArrays(1, &boxVAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+
+        glBindVertexArray(boxVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+        glEnableVertexAttribArray(0);
+        glBindVertexArray(0);
+    }
+
     glm::vec3 minBounds = model.getBoundingBoxMin();
     glm::vec3 maxBounds = model.getBoundingBoxMax();
-    
-    std::vector<glm::vec3> vertices = {
-        glm::vec3(minBounds.x, minBounds.y, minBounds.z),
-        glm::vec3(maxBounds.x, minBounds.y, minBounds.z),
-        glm::vec3(maxBounds.x, maxBounds.y, minBounds.z),
-        glm::vec3(minBounds.x, maxBounds.y, minBounds.z),
-        glm::vec3(minBounds.x, minBounds.y, maxBounds.z),
-        glm::vec3(maxBounds.x, minBounds.y, maxBounds.z),
-        glm::vec3(maxBounds.x, maxBounds.y, maxBounds.z),
-        glm::vec3(minBounds.x, maxBounds.y, maxBounds.z)
-    };
-    
-    std::vector<unsigned int> indices = {
-        0, 1, 1, 2, 2, 3, 3, 0,  // Front face
-        4, 5, 5, 6, 6, 7, 7, 4,  // Back face
-        0, 4, 1, 5, 2, 6, 3, 7   // Connecting lines
-    };
-    
-    unsigned int VBO, VAO, EBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
-    
-    glBindVertexArray(VAO);
-    
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), vertices.data(), GL_STATIC_DRAW);
-    
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
-    
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
-    glEnableVertexAttribArray(0);
-    
+    if (glm::any(glm::greaterThan(minBounds, maxBounds)))
+        return;
+    glm::mat4 boxMatrix = glm::translate(calculateModelMatrix(), minBounds);
+    boxMatrix = glm::scale(boxMatrix, maxBounds - minBounds);
+
     lineShader.use();
-    lineShader.setMat4("model", calculateModelMatrix());
-    
-    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-    glDrawElements(GL_LINES, indices.size(), GL_UNSIGNED_INT, 0);
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-    
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
-} 
\ No newline at end of file
+    lineShader.setMat4("model", boxMatrix);
+
+    glBindVertexArray(boxVAO);
+    glDrawElements(GL_LINES, 24, GL_UNSIGNED_INT, 0);
+    glBindVertexArray(0);
+}
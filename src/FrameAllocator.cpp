@@ -0,0 +1,167 @@
+#include "FrameAllocator.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <new>
+
+namespace {
+    struct Arena {
+        char* memory = nullptr;
+        size_t capacity = 0;
+        std::atomic<size_t> offset;
+        // heap blocks for requests that did not fit, freed on reset
+        std::mutex overflowMutex;
+        std::vector<void*> overflow;
+        size_t overflowBytes = 0;
+
+        Arena() : offset(0) {}
+
+        void reset() {
+            offset.store(0, std::memory_order_relaxed);
+            std::lock_guard<std::mutex> lock(overflowMutex);
+            for (size_t i = 0; i < overflow.size(); i++)
+                std::free(overflow[i]);
+            overflow.clear();
+            overflowBytes = 0;
+        }
+    };
+
+    Arena arenas[2];
+    std::atomic<int> current(0);
+    bool overflowReported = false;
+    int holds = 0;
+
+    std::atomic<uint64_t> heapAllocations(0);
+    uint64_t frameStartAllocations = 0;
+    uint64_t lastFrameAllocations = 0;
+}
+
+void FrameAllocator::initialize(size_t capacity) {
+    shutdown();
+    for (int i = 0; i < 2; i++) {
+        arenas[i].memory = static_cast<char*>(std::malloc(capacity));
+        arenas[i].capacity = arenas[i].memory ? capacity : 0;
+        arenas[i].overflow.reserve(64);
+    }
+    current.store(0);
+    frameStartAllocations = heapAllocations.load(std::memory_order_relaxed);
+}
+
+void FrameAllocator::shutdown() {
+    for (int i = 0; i < 2; i++) {
+        arenas[i].reset();
+        std::free(arenas[i].memory);
+        arenas[i].memory = nullptr;
+        arenas[i].capacity = 0;
+    }
+}
+
+void FrameAllocator::beginFrame() {
+    Arena& finished = arenas[current.load(std::memory_order_relaxed)];
+    if (finished.overflowBytes > 0 && !overflowReported) {
+        std::cout << "WARNING::FRAME_ALLOCATOR::OVERFLOW: " << finished.overflowBytes
+                  << " bytes went to the heap, raise the arena capacity" << std::endl;
+        overflowReported = true;
+    }
+
+    // while held the arenas keep filling up, and past capacity the heap
+    int next = 1 - current.load(std::memory_order_relaxed);
+    if (holds == 0)
+        arenas[next].reset();
+    current.store(next, std::memory_order_release);
+
+    uint64_t now = heapAllocations.load(std::memory_order_relaxed);
+    lastFrameAllocations = now - frameStartAllocations;
+    frameStartAllocations = now;
+}
+
+void FrameAllocator::hold() {
+    holds++;
+}
+
+void FrameAllocator::release() {
+    if (holds > 0)
+        holds--;
+}
+
+void* FrameAllocator::allocate(size_t size, size_t alignment) {
+    Arena& arena = arenas[current.load(std::memory_order_acquire)];
+    size_t offset = arena.offset.load(std::memory_order_relaxed);
+    for (;;) {
+        size_t aligned = (offset + alignment - 1) & ~(alignment - 1);
+        if (aligned + size > arena.capacity)
+            break;
+        if (arena.offset.compare_exchange_weak(offset, aligned + size, std::memory_order_relaxed))
+            return arena.memory + aligned;
+    }
+
+    // malloc aligns for every fundamental type, which is all the engine asks for
+    void* block = std::malloc(size ? size : 1);
+    if (!block)
+        throw std::bad_alloc();
+    std::lock_guard<std::mutex> lock(arena.overflowMutex);
+    arena.overflow.push_back(block);
+    arena.overflowBytes += size;
+    return block;
+}
+
+size_t FrameAllocator::getUsedBytes() {
+    return arenas[current.load(std::memory_order_relaxed)].offset.load(std::memory_order_relaxed);
+}
+
+size_t FrameAllocator::getOverflowBytes() {
+    Arena& arena = arenas[current.load(std::memory_order_relaxed)];
+    std::lock_guard<std::mutex> lock(arena.overflowMutex);
+    return arena.overflowBytes;
+}
+
+uint64_t FrameAllocator::getHeapAllocations() {
+    return heapAllocations.load(std::memory_order_relaxed) - frameStartAllocations;
+}
+
+uint64_t FrameAllocator::getLastFrameHeapAllocations() {
+    return lastFrameAllocations;
+}
+
+#ifndef ENGINE_NO_ALLOC_COUNT
+// Counting replacements of the global allocation functions; every other form
+// (nothrow, array) forwards here
+void* operator new(size_t size) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    void* block = std::malloc(size ? size : 1);
+    if (!block)
+        throw std::bad_alloc();
+    return block;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept {
+    return operator new(size, tag);
+}
+
+void operator delete(void* block) noexcept {
+    std::free(block);
+}
+
+void operator delete[](void* block) noexcept {
+    std::free(block);
+}
+
+void operator delete(void* block, const std::nothrow_t&) noexcept {
+    std::free(block);
+}
+
+void operator delete[](void* block, const std::nothrow_t&) noexcept {
+    std::free(block);
+}
+#endif
@@ -0,0 +1,33 @@
+#include "Frustum.h"
+
+Frustum Frustum::fromMatrix(const glm::mat4& viewProjection) {
+    // rows of the matrix combined (Gribb/Hartmann)
+    glm::mat4 m = glm::transpose(viewProjection);
+    Frustum frustum;
+    frustum.planes[0] = m[3] + m[0];
+    frustum.planes[1] = m[3] - m[0];
+    frustum.planes[2] = m[3] + m[1];
+    frustum.planes[3] = m[3] - m[1];
+    frustum.planes[4] = m[3] + m[2];
+    frustum.planes[5] = m[3] - m[2];
+    for (int p = 0; p < 6; p++)
+        frustum.planes[p] /= glm::length(glm::vec3(frustum.planes[p]));
+    return frustum;
+}
+
+bool Frustum::intersectsSphere(const glm::vec3& center, float radius) const {
+    for (int p = 0; p < 6; p++) {
+        if (glm::dot(glm::vec3(planes[p]), center) + planes[p].w < -radius)
+            return false;
+    }
+    return true;
+}
+
+bool Frustum::intersectsBox(const glm::vec3& center, const glm::vec3& extent) const {
+    for (int p = 0; p < 6; p++) {
+        glm::vec3 normal(planes[p]);
+        if (glm::dot(normal, center) + glm::dot(glm::abs(normal), extent) + planes[p].w < 0.0f)
+            return false;
+    }
+    return true;
+}
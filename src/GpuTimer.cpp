@@ -0,0 +1,53 @@
+#include "GpuTimer.h"
+
+GpuTimer::GpuTimer() : current(0), lastResult(0.0) {
+    glGenQueries(2, queries);
+    pending[0] = pending[1] = false;
+}
+
+GpuTimer::~GpuTimer() {
+    glDeleteQueries(2, queries);
+}
+
+void GpuTimer::begin() {
+    // collect the old result before the query object gets reused
+    if (pending[current])
+        lastMilliseconds();
+    glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+}
+
+void GpuTimer::end() {
+    glEndQuery(GL_TIME_ELAPSED);
+    pending[current] = true;
+    current ^= 1;
+}
+
+double GpuTimer::lastMilliseconds() {
+    // the older of the two queries is the one issued a frame ago
+    for (int i = 0; i < 2; i++) {
+        unsigned int index = current ^ i;
+        if (!pending[index])
+            continue;
+        GLint available = 0;
+        glGetQueryObjectiv(queries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            break;
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(queries[index], GL_QUERY_RESULT, &elapsed);
+        lastResult = elapsed / 1.0e6;
+        pending[index] = false;
+    }
+    return lastResult;
+}
+
+double GpuTimer::waitMilliseconds() {
+    unsigned int index = current ^ 1;
+    if (pending[index]) {
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(queries[index], GL_QUERY_RESULT, &elapsed);
+        lastResult = elapsed / 1.0e6;
+        pending[index] = false;
+        pending[current] = false;
+    }
+    return lastResult;
+}
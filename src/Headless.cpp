@@ -0,0 +1,187 @@
+#include "Headless.h"
+#include "FrameAllocator.h"
+#include "Trace.h"
+#include "stb_image_write.h"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+bool CameraPath::load(const std::string& path) {
+    std::ifstream file(path.c_str());
+    if (!file) {
+        std::cout << "ERROR::HEADLESS::CAMERA_PATH_NOT_FOUND: " << path << std::endl;
+        return false;
+    }
+
+    keys.clear();
+    std::string line;
+    while (std::getline(file, line)) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream stream(line);
+        Key key;
+        if (stream >> key.position.x >> key.position.y >> key.position.z >> key.target.x >> key.target.y >> key.target.z)
+            keys.push_back(key);
+    }
+    if (keys.empty()) {
+        std::cout << "ERROR::HEADLESS::CAMERA_PATH_EMPTY: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void CameraPath::orbit(const glm::vec3& boundsMin, const glm::vec3& boundsMax, float height, unsigned int count) {
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    float radius = 0.35f * glm::max(boundsMax.x - boundsMin.x, boundsMax.z - boundsMin.z);
+    keys.clear();
+    for (unsigned int i = 0; i <= count; i++) {
+        float angle = glm::two_pi<float>() * i / count;
+        Key key;
+        key.position = glm::vec3(center.x + radius * cos(angle), height, center.z + radius * sin(angle));
+        key.target = glm::vec3(center.x, height, center.z);
+        keys.push_back(key);
+    }
+}
+
+void CameraPath::apply(Camera& camera, float t) const {
+    if (keys.size() == 1) {
+        camera.lookAt(keys[0].position, keys[0].target);
+        return;
+    }
+    float segment = glm::clamp(t, 0.0f, 1.0f) * (keys.size() - 1);
+    size_t i = std::min(static_cast<size_t>(segment), keys.size() - 2);
+    float f = segment - i;
+    camera.lookAt(glm::mix(keys[i].position, keys[i + 1].position, f),
+                  glm::mix(keys[i].target, keys[i + 1].target, f));
+}
+
+int Headless::run(const HeadlessOptions& options, Camera& camera, unsigned int width, unsigned int height,
+                  const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+                  const std::function<void(unsigned int targetFBO, float deltaTime)>& renderFrame) {
+    CameraPath path;
+    if (options.cameraPath.empty())
+        path.orbit(boundsMin, boundsMax, camera.Position.y);
+    else if (!path.load(options.cameraPath))
+        return -1;
+
+    // tonemapped output, the HDR scene target lives in PostProcess
+    unsigned int fbo, color;
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glGenTextures(1, &color);
+    glBindTexture(GL_TEXTURE_2D, color);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!complete) {
+        std::cout << "ERROR::FRAMEBUFFER:: headless target is not complete!" << std::endl;
+        glDeleteTextures(1, &color);
+        glDeleteFramebuffers(1, &fbo);
+        return -1;
+    }
+
+    std::cout << "Headless: " << options.frames << " frames at " << width << "x" << height
+              << " on " << glGetString(GL_RENDERER) << std::endl;
+
+    std::vector<double> frameMilliseconds;
+    frameMilliseconds.reserve(options.frames);
+    uint64_t maxFrameAllocations = 0;
+    for (unsigned int frame = 0; frame < options.frames; frame++) {
+        TRACE_SCOPE("headless frame");
+        FrameAllocator::beginFrame();
+        path.apply(camera, options.frames > 1 ? frame / float(options.frames - 1) : 0.0f);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        renderFrame(fbo, options.deltaTime);
+        glFinish();
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+        if (frame >= options.warmupFrames) {
+            frameMilliseconds.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+            // before the snapshot, which is not part of the frame
+            maxFrameAllocations = std::max(maxFrameAllocations, FrameAllocator::getHeapAllocations());
+        }
+
+        if (options.snapshotInterval > 0 && !options.snapshotDir.empty() && frame % options.snapshotInterval == 0) {
+            char name[32];
+            std::snprintf(name, sizeof(name), "/frame_%05u.png", frame);
+            glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+            writeSnapshot(options.snapshotDir + name, width, height);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        }
+    }
+
+    writeStats(options.statsPath, frameMilliseconds);
+    std::cout << "Heap allocations per frame: at most " << maxFrameAllocations << std::endl;
+
+    glDeleteTextures(1, &color);
+    glDeleteFramebuffers(1, &fbo);
+    if (options.requireNoAllocations && maxFrameAllocations > 0) {
+        std::cout << "ERROR::HEADLESS::FRAME_ALLOCATED: " << maxFrameAllocations << " heap allocations in a steady-state frame" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+bool Headless::writeSnapshot(const std::string& path, unsigned int width, unsigned int height) {
+    TRACE_SCOPE("snapshot");
+    FrameVector<unsigned char> pixels(width * height * 4);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+    // GL rows start at the bottom
+    stbi_flip_vertically_on_write(1);
+    if (!stbi_write_png(path.c_str(), width, height, 4, pixels.data(), width * 4)) {
+        std::cout << "ERROR::HEADLESS::SNAPSHOT_NOT_WRITTEN: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void Headless::writeStats(const std::string& statsPath, std::vector<double> frameMilliseconds) {
+    if (frameMilliseconds.empty()) {
+        std::cout << "No frames measured" << std::endl;
+        return;
+    }
+
+    double sum = 0.0;
+    for (size_t i = 0; i < frameMilliseconds.size(); i++)
+        sum += frameMilliseconds[i];
+    std::sort(frameMilliseconds.begin(), frameMilliseconds.end());
+    // nearest rank
+    auto percentile = [&](double p) {
+        size_t rank = static_cast<size_t>(p / 100.0 * frameMilliseconds.size() + 0.5);
+        return frameMilliseconds[std::min(std::max(rank, size_t(1)), frameMilliseconds.size()) - 1];
+    };
+
+    std::ostringstream stats;
+    stats.setf(std::ios::fixed);
+    stats.precision(3);
+    stats << "{\n"
+          << "  \"frames\": " << frameMilliseconds.size() << ",\n"
+          << "  \"mean_ms\": " << sum / frameMilliseconds.size() << ",\n"
+          << "  \"p50_ms\": " << percentile(50.0) << ",\n"
+          << "  \"p95_ms\": " << percentile(95.0) << ",\n"
+          << "  \"p99_ms\": " << percentile(99.0) << ",\n"
+          << "  \"min_ms\": " << frameMilliseconds.front() << ",\n"
+          << "  \"max_ms\": " << frameMilliseconds.back() << "\n"
+          << "}\n";
+    std::cout << stats.str();
+
+    if (!statsPath.empty()) {
+        std::ofstream file(statsPath.c_str());
+        if (file)
+            file << stats.str();
+        else
+            std::cout << "ERROR::HEADLESS::STATS_NOT_WRITTEN: " << statsPath << std::endl;
+    }
+}
@@ -3,9 +3,19 @@
 
 // Initialize static members only
 bool InputManager::showMenu = false;
+ShadingMode InputManager::shadingMode = ShadingMode::FORWARD;
+bool InputManager::gKeyPressed = false;
+bool InputManager::mKeyPressed = false;
+bool InputManager::tKeyPressed = false;
+bool InputManager::traceRequested = false;
+std::vector<InputManager::ResizeListener> InputManager::resizeListeners;
+unsigned int InputManager::nextListenerId = 0;
 float InputManager::lastX = 800.0f;
 float InputManager::lastY = 450.0f;
 bool InputManager::firstMouse = true;
+float InputManager::mouseX = 0.0f;
+float InputManager::mouseY = 0.0f;
+float InputManager::scroll = 0.0f;
 unsigned int InputManager::SCR_WIDTH = 1600;
 unsigned int InputManager::SCR_HEIGHT = 900;
 
@@ -14,42 +24,76 @@ InputManager::InputManager(Camera& cam, float& dt, float& lt, float& ld, bool& v
 }
 
 void InputManager::processInput(GLFWwindow* window) {
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+    InputFrame frame = sample(window);
+    applyToggles(window, frame);
+    applyMotion(frame, deltaTime, camera, laserTimer, laserDuration);
+}
+
+InputFrame InputManager::sample(GLFWwindow* window) {
+    static const int glfwKeys[INPUT_KEY_COUNT] = {
+        GLFW_KEY_W, GLFW_KEY_A, GLFW_KEY_S, GLFW_KEY_D, GLFW_KEY_SPACE, GLFW_KEY_V,
+        GLFW_KEY_G, GLFW_KEY_M, GLFW_KEY_T, GLFW_KEY_Q, GLFW_KEY_ESCAPE
+    };
+    InputFrame frame;
+    frame.keys = 0;
+    for (int i = 0; i < INPUT_KEY_COUNT; i++) {
+        if (glfwGetKey(window, glfwKeys[i]) == GLFW_PRESS)
+            frame.keys |= 1u << i;
+    }
+    // callbacks only accumulate, the camera sees the motion in apply()
+    frame.mouseX = mouseX;
+    frame.mouseY = mouseY;
+    frame.scroll = scroll;
+    mouseX = mouseY = scroll = 0.0f;
+    frame.deltaTime = deltaTime;
+    return frame;
+}
+
+void InputManager::applyToggles(GLFWwindow* window, const InputFrame& frame) {
+    if (frame.isDown(INPUT_KEY_ESCAPE))
         glfwSetWindowShouldClose(window, true);
 
     // VSync toggle with V key
-    if (glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS) {
+    if (frame.isDown(INPUT_KEY_V)) {
         if (!vKeyPressed) {
             vsyncEnabled = !vsyncEnabled;
             glfwSwapInterval(vsyncEnabled ? 1 : 0);
             std::cout << "VSync: " << (vsyncEnabled ? "ON" : "OFF") << std::endl;
             vKeyPressed = true;
         }
-    } else if (glfwGetKey(window, GLFW_KEY_V) == GLFW_RELEASE) {
+    } else {
         vKeyPressed = false;
     }
 
-    // Camera movement
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-        camera.ProcessKeyboard(FORWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-        camera.ProcessKeyboard(BACKWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-        camera.ProcessKeyboard(LEFT, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-        camera.ProcessKeyboard(RIGHT, deltaTime);
-    
-    if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS) {
-        glfwSetWindowShouldClose(window, true);
+    // Cycle forward -> clustered -> deferred shading with G key
+    if (frame.isDown(INPUT_KEY_G)) {
+        if (!gKeyPressed) {
+            switch (shadingMode) {
+                case ShadingMode::FORWARD:
+                    shadingMode = ShadingMode::CLUSTERED;
+                    std::cout << "Shading: CLUSTERED" << std::endl;
+                    break;
+                case ShadingMode::CLUSTERED:
+                    shadingMode = ShadingMode::DEFERRED;
+                    std::cout << "Shading: DEFERRED" << std::endl;
+                    break;
+                default:
+                    shadingMode = ShadingMode::FORWARD;
+                    std::cout << "Shading: FORWARD" << std::endl;
+                    break;
+            }
+            gKeyPressed = true;
+        }
+    } else {
+        gKeyPressed = false;
     }
-    // Laser activation with space
-    if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS) {
-        laserTimer = laserDuration;
+
+    if (frame.isDown(INPUT_KEY_Q)) {
+        glfwSetWindowShouldClose(window, true);
     }
 
     // Menu toggle with M
-    if (glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS) {
-        static bool mKeyPressed = false;
+    if (frame.isDown(INPUT_KEY_M)) {
         if (!mKeyPressed) {
             showMenu = !showMenu;
             if (showMenu)
@@ -58,16 +102,68 @@ void InputManager::processInput(GLFWwindow* window) {
                 glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
             mKeyPressed = true;
         }
-    } else if (glfwGetKey(window, GLFW_KEY_M) == GLFW_RELEASE) {
-        static bool mKeyPressed = false;
+    } else {
         mKeyPressed = false;
     }
+
+    // Trace dump with T
+    if (frame.isDown(INPUT_KEY_T)) {
+        if (!tKeyPressed) {
+            traceRequested = true;
+            tKeyPressed = true;
+        }
+    } else {
+        tKeyPressed = false;
+    }
+}
+
+void applyMotion(const InputFrame& frame, float step, Camera& camera, float& laserTimer, float laserDuration) {
+    // the callbacks drop mouse motion while the menu is open
+    if (frame.mouseX != 0.0f || frame.mouseY != 0.0f)
+        camera.ProcessMouseMovement(frame.mouseX, frame.mouseY);
+    if (frame.scroll != 0.0f)
+        camera.ProcessMouseScroll(frame.scroll);
+
+    // Camera movement
+    if (frame.isDown(INPUT_KEY_W))
+        camera.ProcessKeyboard(FORWARD, step);
+    if (frame.isDown(INPUT_KEY_S))
+        camera.ProcessKeyboard(BACKWARD, step);
+    if (frame.isDown(INPUT_KEY_A))
+        camera.ProcessKeyboard(LEFT, step);
+    if (frame.isDown(INPUT_KEY_D))
+        camera.ProcessKeyboard(RIGHT, step);
+
+    // Laser activation with space
+    if (frame.isDown(INPUT_KEY_SPACE)) {
+        laserTimer = laserDuration;
+    }
 }
 
 void InputManager::framebuffer_size_callback(GLFWwindow* window, int width, int height) {
     glViewport(0, 0, width, height);
     SCR_WIDTH = width;
     SCR_HEIGHT = height;
+    // minimized windows report 0x0; keep the old targets until we come back
+    if (width == 0 || height == 0)
+        return;
+    for (size_t i = 0; i < resizeListeners.size(); i++)
+        resizeListeners[i].callback(width, height);
+}
+
+unsigned int InputManager::addResizeListener(const std::function<void(int, int)>& listener) {
+    ResizeListener entry = { nextListenerId++, listener };
+    resizeListeners.push_back(entry);
+    return entry.id;
+}
+
+void InputManager::removeResizeListener(unsigned int id) {
+    for (size_t i = 0; i < resizeListeners.size(); i++) {
+        if (resizeListeners[i].id == id) {
+            resizeListeners.erase(resizeListeners.begin() + i);
+            return;
+        }
+    }
 }
 
 void InputManager::mouse_callback(GLFWwindow* window, double xposIn, double yposIn) {
@@ -87,19 +183,14 @@ void InputManager::mouse_callback(GLFWwindow* window, double xposIn, double ypos
         lastX = xpos;
         lastY = ypos;
 
-        Camera* camera = static_cast<Camera*>(glfwGetWindowUserPointer(window));
-        if (camera) {
-            camera->ProcessMouseMovement(xoffset, yoffset);
-        }
+        mouseX += xoffset;
+        mouseY += yoffset;
     }
 }
 
 void InputManager::scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
     if (!showMenu) {
-        Camera* camera = static_cast<Camera*>(glfwGetWindowUserPointer(window));
-        if (camera) {
-            camera->ProcessMouseScroll(static_cast<float>(yoffset));
-        }
+        scroll += static_cast<float>(yoffset);
     }
 }
 
@@ -0,0 +1,81 @@
+#include "InputRecorder.h"
+#include <cstring>
+#include <iostream>
+
+namespace {
+    const char MAGIC[4] = { 'G', 'E', 'I', 'N' };
+    const uint32_t VERSION = 1;
+    const size_t RECORD_SIZE = sizeof(uint32_t) + 4 * sizeof(float);
+}
+
+bool InputRecorder::open(const std::string& path) {
+    close();
+    file.open(path.c_str(), std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cout << "ERROR::INPUT::RECORDING_NOT_WRITABLE: " << path << std::endl;
+        return false;
+    }
+    file.write(MAGIC, sizeof(MAGIC));
+    file.write(reinterpret_cast<const char*>(&VERSION), sizeof(VERSION));
+    frames = 0;
+    return true;
+}
+
+void InputRecorder::write(const InputFrame& frame) {
+    if (!file.is_open())
+        return;
+    char record[RECORD_SIZE];
+    std::memcpy(record, &frame.keys, 4);
+    std::memcpy(record + 4, &frame.mouseX, 4);
+    std::memcpy(record + 8, &frame.mouseY, 4);
+    std::memcpy(record + 12, &frame.scroll, 4);
+    std::memcpy(record + 16, &frame.deltaTime, 4);
+    file.write(record, RECORD_SIZE);
+    frames++;
+}
+
+void InputRecorder::close() {
+    if (!file.is_open())
+        return;
+    file.close();
+    std::cout << "Input: recorded " << frames << " frames" << std::endl;
+}
+
+bool InputReplay::open(const std::string& path) {
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if (!file) {
+        std::cout << "ERROR::INPUT::RECORDING_NOT_FOUND: " << path << std::endl;
+        return false;
+    }
+
+    char magic[4];
+    uint32_t version = 0;
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char*>(&version), sizeof(version));
+    if (!file || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || version != VERSION) {
+        std::cout << "ERROR::INPUT::NOT_A_RECORDING: " << path << std::endl;
+        return false;
+    }
+
+    records.clear();
+    position = 0;
+    char record[RECORD_SIZE];
+    while (file.read(record, RECORD_SIZE)) {
+        InputFrame frame;
+        std::memcpy(&frame.keys, record, 4);
+        std::memcpy(&frame.mouseX, record + 4, 4);
+        std::memcpy(&frame.mouseY, record + 8, 4);
+        std::memcpy(&frame.scroll, record + 12, 4);
+        std::memcpy(&frame.deltaTime, record + 16, 4);
+        records.push_back(frame);
+    }
+    std::cout << "Input: replaying " << records.size() << " frames from " << path << std::endl;
+    return !records.empty();
+}
+
+bool InputReplay::next(InputFrame& frame) {
+    if (position >= records.size())
+        return false;
+    frame = records[position++];
+    return true;
+}
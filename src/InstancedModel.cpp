@@ -0,0 +1,239 @@
+#include "InstancedModel.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // invocations per work group, as in the compute shaders
+    const unsigned int CULL_GROUP_SIZE = 64;
+    const unsigned int HIZ_GROUP_SIZE = 8;
+}
+
+HiZPyramid::HiZPyramid()
+    : texture(0), depthWidth(0), depthHeight(0), size(0), levels(0),
+      downsampleShader("res/shaders/hiz_downsample.comp") {
+}
+
+HiZPyramid::~HiZPyramid() {
+    glDeleteTextures(1, &texture);
+}
+
+void HiZPyramid::build(unsigned int depthTexture, unsigned int width, unsigned int height) {
+    TRACE_SCOPE("hi-z build");
+    if (width == 0 || height == 0)
+        return;
+    if (width != depthWidth || height != depthHeight) {
+        glDeleteTextures(1, &texture);
+        depthWidth = width;
+        depthHeight = height;
+        size = glm::ivec2((width + 1) / 2, (height + 1) / 2);
+        levels = 1;
+        while ((size.x >> levels) > 0 || (size.y >> levels) > 0)
+            levels++;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexStorage2D(GL_TEXTURE_2D, levels, GL_R32F, size.x, size.y);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    downsampleShader.use();
+    downsampleShader.setInt("depth", 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    glm::ivec2 sourceSize(width, height);
+    for (int level = 0; level < levels; level++) {
+        glm::ivec2 targetSize(std::max(size.x >> level, 1), std::max(size.y >> level, 1));
+        // level 0 reads the depth buffer, the others the level above
+        downsampleShader.setBool("fromDepth", level == 0);
+        downsampleShader.setVec2("sourceSize", glm::vec2(sourceSize));
+        if (level > 0)
+            glBindImageTexture(1, texture, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+        glBindImageTexture(0, texture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        glDispatchCompute((targetSize.x + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE,
+                          (targetSize.y + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        sourceSize = targetSize;
+    }
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+InstancedModel::InstancedModel(Model& model, bool preferGpu)
+    : model(model), gpuDriven(preferGpu && isGpuCullingSupported()), index(0.0f),
+      instanceBuffer(0), visibleBuffer(0), counterBuffer(0), commandBuffer(0) {
+    if (!gpuDriven)
+        return;
+
+    cullShader.reset(new Shader("res/shaders/gpu_cull.comp"));
+    commandShader.reset(new Shader("res/shaders/gpu_commands.comp"));
+    instanceShader.reset(new Shader("res/shaders/lighting_instanced.vert", "res/shaders/lighting.frag"));
+
+    glGenBuffers(1, &instanceBuffer);
+    glGenBuffers(1, &visibleBuffer);
+    glGenBuffers(1, &counterBuffer);
+    glGenBuffers(1, &commandBuffer);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, counterBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(unsigned int), NULL, GL_DYNAMIC_DRAW);
+
+    // one command per mesh, all drawing the same visible list; the GPU fills in instanceCount
+    std::vector<DrawElementsIndirectCommand> commands(model.meshes.size());
+    for (size_t i = 0; i < commands.size(); i++) {
+        commands[i].count = static_cast<unsigned int>(model.meshes[i].indices.size());
+        commands[i].instanceCount = 0;
+        commands[i].firstIndex = 0;
+        commands[i].baseVertex = 0;
+        commands[i].baseInstance = 0;
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<size_t>(commands.size(), 1) * sizeof(DrawElementsIndirectCommand),
+                 commands.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+InstancedModel::~InstancedModel() {
+    if (!gpuDriven)
+        return;
+    unsigned int buffers[4] = { instanceBuffer, visibleBuffer, counterBuffer, commandBuffer };
+    glDeleteBuffers(4, buffers);
+}
+
+bool InstancedModel::isGpuCullingSupported() {
+    return GLAD_GL_VERSION_4_3 != 0;
+}
+
+void InstancedModel::setInstances(const std::vector<glm::mat4>& matrices) {
+    glm::vec3 localMin = model.getBoundingBoxMin();
+    glm::vec3 localMax = model.getBoundingBoxMax();
+    glm::vec3 localCenter = (localMin + localMax) * 0.5f;
+    glm::vec3 halfExtent = (localMax - localMin) * 0.5f;
+
+    instances.resize(matrices.size());
+    for (size_t i = 0; i < matrices.size(); i++) {
+        const glm::mat4& matrix = matrices[i];
+        GpuInstance& instance = instances[i];
+        instance.model = matrix;
+        instance.normalMatrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(matrix))));
+        // world AABB of the model's box, as Drawer::getWorldBounds
+        glm::vec3 center = glm::vec3(matrix * glm::vec4(localCenter, 1.0f));
+        glm::mat3 axes(matrix);
+        glm::vec3 extent = glm::abs(axes[0]) * halfExtent.x + glm::abs(axes[1]) * halfExtent.y + glm::abs(axes[2]) * halfExtent.z;
+        instance.boundsMin = glm::vec4(center - extent, 1.0f);
+        instance.boundsMax = glm::vec4(center + extent, 1.0f);
+    }
+
+    if (!gpuDriven) {
+        // the instances never move, so their boxes need no slack
+        index.clear();
+        for (size_t i = 0; i < instances.size(); i++)
+            index.insert(glm::vec3(instances[i].boundsMin), glm::vec3(instances[i].boundsMax), static_cast<uint32_t>(i));
+        visible = FrameVector<uint32_t>();
+        return;
+    }
+    size_t count = std::max<size_t>(instances.size(), 1);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(GpuInstance), instances.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibleBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(unsigned int), NULL, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void InstancedModel::cull(const glm::mat4& viewProjection, const HiZPyramid* hiZ, OcclusionCuller* occlusion) {
+    TRACE_SCOPE("instance cull");
+    Frustum frustum = Frustum::fromMatrix(viewProjection);
+    if (!gpuDriven) {
+        // a fresh list each frame, the last one's arena may have been reset
+        visible = FrameVector<uint32_t>();
+        visible.reserve(instances.size());
+        index.queryFrustum(frustum, visible);
+        if (occlusion) {
+            visible.erase(std::remove_if(visible.begin(), visible.end(), [&](uint32_t i) {
+                return !occlusion->isVisible(glm::vec3(instances[i].boundsMin), glm::vec3(instances[i].boundsMax));
+            }), visible.end());
+        }
+        return;
+    }
+
+    const unsigned int zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, counterBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(unsigned int), &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, instanceBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, visibleBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, counterBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, commandBuffer);
+
+    cullShader->use();
+    cullShader->setMat4("viewProjection", viewProjection);
+    for (int i = 0; i < 6; i++) {
+        static const char* const PLANE_NAMES[6] = {
+            "frustumPlanes[0]", "frustumPlanes[1]", "frustumPlanes[2]",
+            "frustumPlanes[3]", "frustumPlanes[4]", "frustumPlanes[5]"
+        };
+        cullShader->setVec4(PLANE_NAMES[i], frustum.planes[i]);
+    }
+    cullShader->setInt("instanceCount", static_cast<int>(instances.size()));
+    bool useHiZ = hiZ && hiZ->isBuilt();
+    cullShader->setBool("useHiZ", useHiZ);
+    cullShader->setInt("hiZ", HIZ_TEXTURE_UNIT);
+    if (useHiZ) {
+        cullShader->setVec2("depthSize", glm::vec2(hiZ->getDepthSize()));
+        cullShader->setInt("hiZLevels", hiZ->getLevelCount());
+        glActiveTexture(GL_TEXTURE0 + HIZ_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D, hiZ->getTexture());
+        glActiveTexture(GL_TEXTURE0);
+    }
+    glDispatchCompute((static_cast<unsigned int>(instances.size()) + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    commandShader->use();
+    commandShader->setInt("commandCount", static_cast<int>(model.meshes.size()));
+    glDispatchCompute(1, 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void InstancedModel::draw(Shader& shader) {
+    TRACE_SCOPE("instance draw");
+    if (!gpuDriven) {
+        shader.use();
+        for (size_t v = 0; v < visible.size(); v++) {
+            const GpuInstance& instance = instances[visible[v]];
+            model.Draw(shader, instance.model, glm::mat3(instance.normalMatrix));
+        }
+        return;
+    }
+
+    instanceShader->use();
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, instanceBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, visibleBuffer);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    model.nodes.update();
+    for (size_t i = 0; i < model.meshes.size(); i++) {
+        Mesh& mesh = model.meshes[i];
+        glm::mat4 node = model.nodes.getWorld(mesh.node);
+        instanceShader->setMat4("node", node);
+        instanceShader->setMat3("nodeNormal", model.nodes.getWorldNormal(mesh.node));
+        mesh.bindTextures(*instanceShader);
+        glBindVertexArray(mesh.VAO);
+        glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                               reinterpret_cast<const void*>(i * sizeof(DrawElementsIndirectCommand)));
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+size_t InstancedModel::readVisibleCount() const {
+    if (!gpuDriven)
+        return visible.size();
+    unsigned int count = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, counterBuffer);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(unsigned int), &count);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return count;
+}
@@ -0,0 +1,172 @@
+#include "IslandFinder.h"
+#include "FrameAllocator.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+    // positions closer than this fraction of the model size are welded
+    const float WELD_TOLERANCE = 1e-5f;
+    const uint64_t EMPTY_CELL = ~0ull;
+    const unsigned int NONE = ~0u;
+
+    uint64_t hashCell(int x, int y, int z) {
+        uint64_t hash = static_cast<uint32_t>(x) * 0x9E3779B97F4A7C15ull;
+        hash ^= static_cast<uint32_t>(y) * 0xC2B2AE3D27D4EB4Full + (hash << 6) + (hash >> 2);
+        hash ^= static_cast<uint32_t>(z) * 0x165667B19E3779F9ull + (hash << 6) + (hash >> 2);
+        return hash == EMPTY_CELL ? hash - 1 : hash;
+    }
+
+    unsigned int find(FrameVector<unsigned int>& parent, unsigned int v) {
+        while (parent[v] != v) {
+            // path halving
+            parent[v] = parent[parent[v]];
+            v = parent[v];
+        }
+        return v;
+    }
+
+    void unite(FrameVector<unsigned int>& parent, unsigned int a, unsigned int b) {
+        a = find(parent, a);
+        b = find(parent, b);
+        if (a != b)
+            parent[std::max(a, b)] = std::min(a, b);
+    }
+}
+
+size_t IslandFinder::split(const vector<vector<Vertex>>& vertices, const vector<vector<unsigned int>>& indices,
+                           size_t minTriangles, vector<IslandGeometry>& islands, const glm::mat4* meshTransforms) {
+    TRACE_SCOPE("island split");
+    islands.clear();
+    const size_t meshCount = vertices.size();
+
+    FrameVector<unsigned int> meshBase(meshCount + 1);
+    meshBase[0] = 0;
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+    for (size_t m = 0; m < meshCount; m++)
+        meshBase[m + 1] = meshBase[m] + static_cast<unsigned int>(vertices[m].size());
+    const unsigned int vertexCount = meshBase[meshCount];
+    // model space position of every vertex
+    FrameVector<glm::vec3> positions(vertexCount);
+    for (size_t m = 0; m < meshCount; m++) {
+        glm::vec3* meshPositions = positions.data() + meshBase[m];
+        for (size_t v = 0; v < vertices[m].size(); v++)
+            meshPositions[v] = vertices[m][v].Position;
+        if (meshTransforms && meshTransforms[m] != glm::mat4(1.0f)) {
+            for (size_t v = 0; v < vertices[m].size(); v++)
+                meshPositions[v] = glm::vec3(meshTransforms[m] * glm::vec4(meshPositions[v], 1.0f));
+        }
+        for (size_t v = 0; v < vertices[m].size(); v++) {
+            boundsMin = glm::min(boundsMin, meshPositions[v]);
+            boundsMax = glm::max(boundsMax, meshPositions[v]);
+        }
+    }
+    if (vertexCount == 0)
+        return 0;
+
+    FrameVector<unsigned int> parent(vertexCount);
+    for (unsigned int v = 0; v < vertexCount; v++)
+        parent[v] = v;
+
+    // Triangles connect their corners
+    for (size_t m = 0; m < meshCount; m++) {
+        const vector<unsigned int>& meshIndices = indices[m];
+        for (size_t i = 0; i + 2 < meshIndices.size(); i += 3) {
+            unite(parent, meshBase[m] + meshIndices[i], meshBase[m] + meshIndices[i + 1]);
+            unite(parent, meshBase[m] + meshIndices[i], meshBase[m] + meshIndices[i + 2]);
+        }
+    }
+
+    // Corners in the same weld cell are the same point
+    glm::vec3 extent = boundsMax - boundsMin;
+    float cellSize = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-6f)) * WELD_TOLERANCE;
+    float inverseCell = 1.0f / cellSize;
+    size_t capacity = 16;
+    while (capacity < size_t(vertexCount) * 2)
+        capacity <<= 1;
+    const size_t mask = capacity - 1;
+    FrameVector<uint64_t> cellKeys(capacity, EMPTY_CELL);
+    FrameVector<unsigned int> cellVertices(capacity);
+    for (size_t m = 0; m < meshCount; m++) {
+        for (size_t v = 0; v < vertices[m].size(); v++) {
+            unsigned int id = meshBase[m] + static_cast<unsigned int>(v);
+            glm::vec3 cell = glm::floor((positions[id] - boundsMin) * inverseCell);
+            int x = static_cast<int>(cell.x), y = static_cast<int>(cell.y), z = static_cast<int>(cell.z);
+            uint64_t key = hashCell(x, y, z);
+            size_t slot = key & mask;
+            for (;;) {
+                if (cellKeys[slot] == EMPTY_CELL) {
+                    cellKeys[slot] = key;
+                    cellVertices[slot] = id;
+                    break;
+                }
+                if (cellKeys[slot] == key) {
+                    // the hash only narrows the search, the cell itself must match
+                    unsigned int other = cellVertices[slot];
+                    glm::vec3 otherCell = glm::floor((positions[other] - boundsMin) * inverseCell);
+                    if (otherCell == cell) {
+                        unite(parent, id, other);
+                        break;
+                    }
+                }
+                slot = (slot + 1) & mask;
+            }
+        }
+    }
+
+    // Dense island ids in order of first appearance, with triangle counts
+    FrameVector<unsigned int> islandOf(vertexCount, NONE);
+    FrameVector<size_t> islandTriangles;
+    for (size_t m = 0; m < meshCount; m++) {
+        for (size_t i = 0; i + 2 < indices[m].size(); i += 3) {
+            unsigned int root = find(parent, meshBase[m] + indices[m][i]);
+            if (islandOf[root] == NONE) {
+                islandOf[root] = static_cast<unsigned int>(islandTriangles.size());
+                islandTriangles.push_back(0);
+            }
+            islandTriangles[islandOf[root]]++;
+        }
+    }
+    const size_t islandCount = islandTriangles.size();
+    if (islandCount <= 1)
+        return islandCount;
+
+    // Compact each island's share of every mesh; a vertex lies in exactly one island
+    FrameVector<unsigned int> islandSlot(islandCount, NONE);
+    for (size_t i = 0; i < islandCount; i++) {
+        if (islandTriangles[i] < minTriangles)
+            continue;
+        islandSlot[i] = static_cast<unsigned int>(islands.size());
+        islands.push_back(IslandGeometry());
+        IslandGeometry& island = islands.back();
+        island.vertices.resize(meshCount);
+        island.indices.resize(meshCount);
+        island.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+        island.boundsMax = glm::vec3(std::numeric_limits<float>::lowest());
+        island.triangles = islandTriangles[i];
+    }
+    FrameVector<unsigned int> remap;
+    for (size_t m = 0; m < meshCount; m++) {
+        remap.assign(vertices[m].size(), NONE);
+        for (size_t i = 0; i + 2 < indices[m].size(); i += 3) {
+            unsigned int target = islandSlot[islandOf[find(parent, meshBase[m] + indices[m][i])]];
+            if (target == NONE)
+                continue;
+            IslandGeometry& island = islands[target];
+            for (int j = 0; j < 3; j++) {
+                unsigned int v = indices[m][i + j];
+                if (remap[v] == NONE) {
+                    remap[v] = static_cast<unsigned int>(island.vertices[m].size());
+                    island.vertices[m].push_back(vertices[m][v]);
+                    island.boundsMin = glm::min(island.boundsMin, positions[meshBase[m] + v]);
+                    island.boundsMax = glm::max(island.boundsMax, positions[meshBase[m] + v]);
+                }
+                island.indices[m].push_back(remap[v]);
+            }
+        }
+    }
+    return islandCount;
+}
@@ -0,0 +1,307 @@
+#include "JobSystem.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+    // Chase-Lev deque with a fixed ring (Le et al., "Correct and Efficient
+    // Work-Stealing for Weak Memory Models"). The owner pushes and pops at the
+    // bottom, thieves take from the top; only the last item is contended.
+    class JobQueue {
+    public:
+        static const long long CAPACITY = 4096;
+
+        JobQueue() : top(0), bottom(0) {
+            for (long long i = 0; i < CAPACITY; i++)
+                slots[i].store(nullptr, std::memory_order_relaxed);
+        }
+
+        // owner only; false when full
+        bool push(Job* job) {
+            long long b = bottom.load(std::memory_order_relaxed);
+            long long t = top.load(std::memory_order_acquire);
+            if (b - t >= CAPACITY)
+                return false;
+            slots[b & (CAPACITY - 1)].store(job, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return true;
+        }
+
+        // owner only
+        Job* pop() {
+            long long b = bottom.load(std::memory_order_relaxed) - 1;
+            bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            long long t = top.load(std::memory_order_relaxed);
+            if (t > b) {
+                bottom.store(b + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            Job* job = slots[b & (CAPACITY - 1)].load(std::memory_order_relaxed);
+            if (t == b) {
+                // last item, race the thieves for it
+                if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    job = nullptr;
+                bottom.store(b + 1, std::memory_order_relaxed);
+            }
+            return job;
+        }
+
+        // any thread
+        Job* steal() {
+            long long t = top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            long long b = bottom.load(std::memory_order_acquire);
+            if (t >= b)
+                return nullptr;
+            Job* job = slots[t & (CAPACITY - 1)].load(std::memory_order_relaxed);
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                return nullptr;
+            return job;
+        }
+
+    private:
+        std::atomic<long long> top;
+        std::atomic<long long> bottom;
+        std::atomic<Job*> slots[CAPACITY];
+    };
+
+    const size_t MAX_STACK_JOBS = 64;
+
+    std::vector<JobQueue*> queues;
+    std::vector<std::thread> workers;
+    std::atomic<bool> quit(false);
+
+    // jobs pushed but not yet taken, lets idle workers sleep
+    std::atomic<int> queuedJobs(0);
+    std::mutex sleepMutex;
+    std::condition_variable wakeCondition;
+
+    // runInBackground() jobs, workers only; rare and long, so a locked queue will do
+    std::mutex backgroundMutex;
+    std::deque<Job*> backgroundJobs;
+
+    std::mutex mainThreadMutex;
+    std::vector<std::function<void()>> mainThreadJobs;
+
+    // index into queues, -1 for threads outside the job system
+    thread_local int threadIndex = -1;
+    thread_local unsigned int stealSeed = 0;
+
+    Job* findJob() {
+        if (threadIndex < 0)
+            return nullptr;
+        Job* job = queues[threadIndex]->pop();
+        if (!job && queues.size() > 1) {
+            // xorshift victim choice, one sweep over the other queues
+            stealSeed ^= stealSeed << 13;
+            stealSeed ^= stealSeed >> 17;
+            stealSeed ^= stealSeed << 5;
+            size_t start = stealSeed % queues.size();
+            for (size_t i = 0; i < queues.size() && !job; i++) {
+                size_t victim = (start + i) % queues.size();
+                if (victim != static_cast<size_t>(threadIndex))
+                    job = queues[victim]->steal();
+            }
+        }
+        if (!job && threadIndex != 0) {
+            std::lock_guard<std::mutex> lock(backgroundMutex);
+            if (!backgroundJobs.empty()) {
+                job = backgroundJobs.front();
+                backgroundJobs.pop_front();
+            }
+        }
+        if (job)
+            queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+        return job;
+    }
+
+    void execute(Job* job) {
+        job->function(job->data, job->begin, job->end);
+        job->counter->pending.fetch_sub(1, std::memory_order_release);
+    }
+
+    void workerLoop(int index) {
+        threadIndex = index;
+        stealSeed = 2654435761u * (index + 1);
+        TRACE_THREAD_NAME("job worker");
+        while (!quit.load(std::memory_order_relaxed)) {
+            Job* job = findJob();
+            if (job) {
+                execute(job);
+                continue;
+            }
+            // spin a little before sleeping, jobs tend to arrive in bursts
+            bool found = false;
+            for (int spin = 0; spin < 64 && !found; spin++) {
+                std::this_thread::yield();
+                found = queuedJobs.load(std::memory_order_relaxed) > 0;
+            }
+            if (!found) {
+                std::unique_lock<std::mutex> lock(sleepMutex);
+                wakeCondition.wait(lock, [] { return queuedJobs.load() > 0 || quit.load(); });
+            }
+        }
+    }
+
+    void rangeTrampoline(void* data, size_t begin, size_t end) {
+        (*static_cast<const std::function<void(size_t, size_t)>*>(data))(begin, end);
+    }
+}
+
+void JobSystem::initialize(unsigned int workerCount) {
+    if (!queues.empty())
+        shutdown();
+    if (workerCount == 0) {
+        unsigned int hardware = std::thread::hardware_concurrency();
+        workerCount = hardware > 1 ? hardware - 1 : 0;
+    }
+
+    quit.store(false);
+    queuedJobs.store(0);
+    for (unsigned int i = 0; i <= workerCount; i++)
+        queues.push_back(new JobQueue());
+    threadIndex = 0;
+    stealSeed = 2654435761u;
+    for (unsigned int i = 1; i <= workerCount; i++)
+        workers.push_back(std::thread(workerLoop, static_cast<int>(i)));
+}
+
+void JobSystem::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        quit.store(true);
+    }
+    wakeCondition.notify_all();
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+    workers.clear();
+    backgroundJobs.clear();
+    for (size_t i = 0; i < queues.size(); i++)
+        delete queues[i];
+    queues.clear();
+    threadIndex = -1;
+}
+
+unsigned int JobSystem::getThreadCount() {
+    return queues.empty() ? 1 : static_cast<unsigned int>(queues.size());
+}
+
+bool JobSystem::isMainThread() {
+    return threadIndex == 0;
+}
+
+void JobSystem::run(Job* jobs, size_t count, JobCounter& counter) {
+    counter.pending.fetch_add(static_cast<int>(count), std::memory_order_relaxed);
+    for (size_t i = 0; i < count; i++)
+        jobs[i].counter = &counter;
+
+    if (threadIndex < 0) {
+        for (size_t i = 0; i < count; i++)
+            execute(&jobs[i]);
+        return;
+    }
+
+    JobQueue* queue = queues[threadIndex];
+    size_t pushed = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (queue->push(&jobs[i]))
+            pushed++;
+        else
+            execute(&jobs[i]);
+    }
+    if (pushed == 0)
+        return;
+    queuedJobs.fetch_add(static_cast<int>(pushed), std::memory_order_relaxed);
+    // taking the lock orders the increment before any sleeper's predicate check
+    { std::lock_guard<std::mutex> lock(sleepMutex); }
+    if (pushed == 1)
+        wakeCondition.notify_one();
+    else
+        wakeCondition.notify_all();
+}
+
+void JobSystem::runInBackground(Job* jobs, size_t count, JobCounter& counter) {
+    counter.pending.fetch_add(static_cast<int>(count), std::memory_order_relaxed);
+    for (size_t i = 0; i < count; i++)
+        jobs[i].counter = &counter;
+
+    if (workers.empty() || threadIndex < 0) {
+        for (size_t i = 0; i < count; i++)
+            execute(&jobs[i]);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(backgroundMutex);
+        for (size_t i = 0; i < count; i++)
+            backgroundJobs.push_back(&jobs[i]);
+    }
+    queuedJobs.fetch_add(static_cast<int>(count), std::memory_order_relaxed);
+    { std::lock_guard<std::mutex> lock(sleepMutex); }
+    wakeCondition.notify_all();
+}
+
+void JobSystem::wait(JobCounter& counter) {
+    while (counter.pending.load(std::memory_order_acquire) > 0) {
+        Job* job = findJob();
+        if (job)
+            execute(job);
+        else if (isMainThread())
+            executeMainThreadJobs();
+        else
+            std::this_thread::yield();
+    }
+}
+
+void JobSystem::parallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& body) {
+    if (count == 0)
+        return;
+    grain = std::max(grain, size_t(1));
+    size_t jobCount = (count + grain - 1) / grain;
+    if (jobCount == 1 || getThreadCount() == 1) {
+        body(0, count);
+        return;
+    }
+
+    // typical splits fit on the stack, so a parallelFor per frame stays off the heap
+    Job stackJobs[MAX_STACK_JOBS];
+    std::vector<Job> heapJobs;
+    Job* jobs = stackJobs;
+    if (jobCount > MAX_STACK_JOBS) {
+        heapJobs.resize(jobCount);
+        jobs = heapJobs.data();
+    }
+    for (size_t i = 0; i < jobCount; i++) {
+        jobs[i].function = rangeTrampoline;
+        jobs[i].data = const_cast<std::function<void(size_t, size_t)>*>(&body);
+        jobs[i].begin = i * grain;
+        jobs[i].end = std::min(count, (i + 1) * grain);
+    }
+    JobCounter counter;
+    run(jobs, jobCount, counter);
+    wait(counter);
+}
+
+void JobSystem::runOnMainThread(const std::function<void()>& job) {
+    std::lock_guard<std::mutex> lock(mainThreadMutex);
+    mainThreadJobs.push_back(job);
+}
+
+void JobSystem::executeMainThreadJobs() {
+    // swapped out so a job may queue more (or wait) without deadlocking
+    std::vector<std::function<void()>> jobs;
+    {
+        std::lock_guard<std::mutex> lock(mainThreadMutex);
+        if (mainThreadJobs.empty())
+            return;
+        jobs.swap(mainThreadJobs);
+    }
+    for (size_t i = 0; i < jobs.size(); i++)
+        jobs[i]();
+}
@@ -0,0 +1,89 @@
+#include "Light.h"
+#include <algorithm>
+#include <cmath>
+
+PointLight::PointLight(const glm::vec3& position, const glm::vec3& ambient, const glm::vec3& diffuse,
+                       const glm::vec3& specular, float constant, float linear, float quadratic)
+    : position(position), ambient(ambient), diffuse(diffuse), specular(specular),
+      constant(constant), linear(linear), quadratic(quadratic) {
+}
+
+float PointLight::radius() const {
+    glm::vec3 brightest = glm::max(ambient, glm::max(diffuse, specular));
+    float maxChannel = std::max(brightest.r, std::max(brightest.g, brightest.b));
+    if (quadratic <= 0.0f) {
+        if (linear <= 0.0f)
+            return 1000.0f;
+        return std::max(0.0f, (maxChannel * 256.0f / 5.0f - constant) / linear);
+    }
+    // solve constant + linear*d + quadratic*d^2 = maxChannel * 256/5 for d
+    float c = constant - maxChannel * (256.0f / 5.0f);
+    float discriminant = linear * linear - 4.0f * quadratic * c;
+    return (-linear + std::sqrt(std::max(discriminant, 0.0f))) / (2.0f * quadratic);
+}
+
+DirectionalLight::DirectionalLight(const glm::vec3& direction, const glm::vec3& ambient, const glm::vec3& diffuse,
+                                   const glm::vec3& specular)
+    : direction(glm::normalize(direction)), ambient(ambient), diffuse(diffuse), specular(specular) {
+}
+
+void DirectionalLight::bind(Shader& shader) const {
+    shader.use();
+    shader.setBool("sunEnabled", true);
+    shader.setVec3("sunDirection", glm::normalize(direction));
+    shader.setVec3("sunAmbient", ambient);
+    shader.setVec3("sunDiffuse", diffuse);
+    shader.setVec3("sunSpecular", specular);
+}
+
+LightBuffer::LightBuffer() : capacity(0), lightCount(0) {
+    glGenBuffers(1, &buffer);
+    glGenTextures(1, &texture);
+
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, LIGHT_TEXELS * sizeof(glm::vec4), NULL, GL_DYNAMIC_DRAW);
+    capacity = 1;
+
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+LightBuffer::~LightBuffer() {
+    glDeleteTextures(1, &texture);
+    glDeleteBuffers(1, &buffer);
+}
+
+void LightBuffer::upload(const std::vector<PointLight>& lights) {
+    // layout per light, mirrors fetchLight() in the lighting shaders:
+    // [position, radius] [ambient, constant] [diffuse, linear] [specular, quadratic]
+    staging.resize(lights.size() * LIGHT_TEXELS);
+    for (size_t i = 0; i < lights.size(); i++) {
+        const PointLight& light = lights[i];
+        staging[i * LIGHT_TEXELS + 0] = glm::vec4(light.position, light.radius());
+        staging[i * LIGHT_TEXELS + 1] = glm::vec4(light.ambient, light.constant);
+        staging[i * LIGHT_TEXELS + 2] = glm::vec4(light.diffuse, light.linear);
+        staging[i * LIGHT_TEXELS + 3] = glm::vec4(light.specular, light.quadratic);
+    }
+    lightCount = static_cast<unsigned int>(lights.size());
+
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    if (lights.size() > capacity) {
+        capacity = lights.size();
+        glBufferData(GL_TEXTURE_BUFFER, capacity * LIGHT_TEXELS * sizeof(glm::vec4), NULL, GL_DYNAMIC_DRAW);
+    }
+    if (!staging.empty())
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, staging.size() * sizeof(glm::vec4), staging.data());
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightBuffer::bind(Shader& shader) const {
+    glActiveTexture(GL_TEXTURE0 + LIGHT_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+    glActiveTexture(GL_TEXTURE0);
+
+    shader.use();
+    shader.setInt("lights", LIGHT_TEXTURE_UNIT);
+    shader.setInt("lightCount", static_cast<int>(lightCount));
+}
@@ -1,23 +1,22 @@
 #include "Mesh.h"
+#include "MeshCutter.h"
 
 Mesh::Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures) {
-    this->vertices = vertices;
-    this->indices = indices;
-    this->textures = textures;
-
-    setupMesh();
-}
-
-void Mesh::Draw(Shader &shader) {
+    this->vertices = std::move(vertices);
+    this->indices = std::move(indices);
+    this->textures = std::move(textures);
+    node = 0;
+    skinned = false;
+
+    // sampler uniform names (texture_diffuse1, texture_specular1, ...) built
+    // once here rather than on every draw
     unsigned int diffuseNr = 1;
     unsigned int specularNr = 1;
     unsigned int normalNr = 1;
     unsigned int heightNr = 1;
-
-    for(unsigned int i = 0; i < textures.size(); i++) {
-        glActiveTexture(GL_TEXTURE0 + i);
+    for(unsigned int i = 0; i < this->textures.size(); i++) {
         string number;
-        string name = textures[i].type;
+        string name = this->textures[i].type;
         if(name == "texture_diffuse")
             number = std::to_string(diffuseNr++);
         else if(name == "texture_specular")
@@ -26,10 +25,22 @@ void Mesh::Draw(Shader &shader) {
             number = std::to_string(normalNr++);
         else if(name == "texture_height")
             number = std::to_string(heightNr++);
+        samplerNames.push_back(name + number);
+    }
 
-        glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
+    setupMesh();
+}
+
+void Mesh::bindTextures(Shader &shader) {
+    for(unsigned int i = 0; i < textures.size(); i++) {
+        glActiveTexture(GL_TEXTURE0 + i);
+        glUniform1i(glGetUniformLocation(shader.ID, samplerNames[i].c_str()), i);
         glBindTexture(GL_TEXTURE_2D, textures[i].id);
     }
+}
+
+void Mesh::Draw(Shader &shader) {
+    bindTextures(shader);
     
     glBindVertexArray(VAO);
     glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
@@ -38,6 +49,15 @@ void Mesh::Draw(Shader &shader) {
     glActiveTexture(GL_TEXTURE0);
 }
 
+void Mesh::release() {
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    VAO = VBO = EBO = 0;
+    vector<Vertex>().swap(vertices);
+    vector<unsigned int>().swap(indices);
+}
+
 void Mesh::setupMesh() {
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
@@ -65,118 +85,45 @@ void Mesh::setupMesh() {
     // vertex bitangent
     glEnableVertexAttribArray(4);
     glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+    // bone ids and weights
+    glEnableVertexAttribArray(5);
+    glVertexAttribIPointer(5, MAX_BONE_INFLUENCE, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, BoneIDs));
+    glEnableVertexAttribArray(6);
+    glVertexAttribPointer(6, MAX_BONE_INFLUENCE, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Weights));
 
     glBindVertexArray(0);
 }
 
 vector<Mesh> Mesh::sliceMesh(const Mesh& mesh, float xThreshold) {
-    vector<Vertex> leftVertices, rightVertices;
-    vector<unsigned int> leftIndices, rightIndices;
-    
-    // First, separate vertices
-    for (size_t i = 0; i < mesh.vertices.size(); i++) {
-        if (mesh.vertices[i].Position.x <= xThreshold) {
-            leftVertices.push_back(mesh.vertices[i]);
-        } else {
-            rightVertices.push_back(mesh.vertices[i]);
-        }
-    }
-
-    // Create new indices for separated meshes
-    unordered_map<unsigned int, unsigned int> leftIndexMap, rightIndexMap;
-    unsigned int leftCurrentIndex = 0, rightCurrentIndex = 0;
-
-    for (size_t i = 0; i < mesh.indices.size(); i += 3) {
-        bool isLeft = false, isRight = false;
-        for (int j = 0; j < 3; j++) {
-            if (mesh.vertices[mesh.indices[i + j]].Position.x <= xThreshold) {
-                isLeft = true;
-            } else {
-                isRight = true;
-            }
-        }
-
-        if (isLeft && !isRight) {
-            // Triangle belongs to left mesh
-            for (int j = 0; j < 3; j++) {
-                unsigned int oldIndex = mesh.indices[i + j];
-                if (leftIndexMap.find(oldIndex) == leftIndexMap.end()) {
-                    leftIndexMap[oldIndex] = leftCurrentIndex++;
-                }
-                leftIndices.push_back(leftIndexMap[oldIndex]);
-            }
-        } else if (!isLeft && isRight) {
-            // Triangle belongs to right mesh
-            for (int j = 0; j < 3; j++) {
-                unsigned int oldIndex = mesh.indices[i + j];
-                if (rightIndexMap.find(oldIndex) == rightIndexMap.end()) {
-                    rightIndexMap[oldIndex] = rightCurrentIndex++;
-                }
-                rightIndices.push_back(rightIndexMap[oldIndex]);
-            }
-        }
-    }
+    // each half is clipped at the plane and capped where the other half was
+    glm::vec3 point(xThreshold, 0.0f, 0.0f);
+    CutShape halves[2] = {
+        CutShape::plane(point, glm::vec3(1.0f, 0.0f, 0.0f)),
+        CutShape::plane(point, glm::vec3(-1.0f, 0.0f, 0.0f))
+    };
 
     vector<Mesh> result;
-    if (!leftVertices.empty() && !leftIndices.empty()) {
-        result.push_back(Mesh(leftVertices, leftIndices, mesh.textures));
-    }
-    if (!rightVertices.empty() && !rightIndices.empty()) {
-        result.push_back(Mesh(rightVertices, rightIndices, mesh.textures));
+    for (int side = 0; side < 2; side++) {
+        vector<Vertex> sideVertices;
+        vector<unsigned int> sideIndices;
+        MeshCutter::cut(mesh.vertices, mesh.indices, &halves[side], 1, true, sideVertices, sideIndices);
+        if (!sideVertices.empty() && !sideIndices.empty()) {
+            result.push_back(Mesh(std::move(sideVertices), std::move(sideIndices), mesh.textures));
+            result.back().node = mesh.node;
+            result.back().skinned = mesh.skinned;
+        }
     }
     return result;
 }
 
 Mesh Mesh::sliceMeshCyl(const Mesh& mesh, const glm::vec3& cylinderAxisStart, const glm::vec3& cylinderAxisEnd, float cylinderRadius) {
+    SliceCylinder cylinder = { cylinderAxisStart, cylinderAxisEnd, cylinderRadius };
+    CutShape shape = CutShape::cylinder(cylinder);
     vector<Vertex> remainingVertices;
     vector<unsigned int> remainingIndices;
-    
-    // Helper function to check if a point is inside the cylinder
-    auto isInsideCylinder = [](const glm::vec3& point, const glm::vec3& cylinderStart, const glm::vec3& cylinderEnd, float radius) {
-        glm::vec3 cylinderDir = glm::normalize(cylinderEnd - cylinderStart);
-        glm::vec3 pointVec = point - cylinderStart;
-        
-        // Project point onto cylinder axis
-        float t = glm::dot(pointVec, cylinderDir);
-        glm::vec3 projection = cylinderStart + t * cylinderDir;
-        
-        // Check if projection is within cylinder bounds
-        float cylinderLength = glm::length(cylinderEnd - cylinderStart);
-        if (t < 0 || t > cylinderLength)
-            return false;
-            
-        // Check radial distance
-        float distance = glm::length(point - projection);
-        return distance <= radius;
-    };
-
-    // Create a map to store new indices for remaining vertices
-    unordered_map<unsigned int, unsigned int> newIndexMap;
-    unsigned int currentIndex = 0;
-
-    // Process triangles
-    for (size_t i = 0; i < mesh.indices.size(); i += 3) {
-        bool keepTriangle = true;
-        for (int j = 0; j < 3; j++) {
-            if (isInsideCylinder(mesh.vertices[mesh.indices[i + j]].Position, 
-                               cylinderAxisStart, cylinderAxisEnd, cylinderRadius)) {
-                keepTriangle = false;
-                break;
-            }
-        }
-
-        if (keepTriangle) {
-            // Add vertices and update indices
-            for (int j = 0; j < 3; j++) {
-                unsigned int oldIndex = mesh.indices[i + j];
-                if (newIndexMap.find(oldIndex) == newIndexMap.end()) {
-                    newIndexMap[oldIndex] = currentIndex++;
-                    remainingVertices.push_back(mesh.vertices[oldIndex]);
-                }
-                remainingIndices.push_back(newIndexMap[oldIndex]);
-            }
-        }
-    }
-
-    return Mesh(remainingVertices, remainingIndices, mesh.textures);
-} 
\ No newline at end of file
+    MeshCutter::cut(mesh.vertices, mesh.indices, &shape, 1, false, remainingVertices, remainingIndices);
+    Mesh result(std::move(remainingVertices), std::move(remainingIndices), mesh.textures);
+    result.node = mesh.node;
+    result.skinned = mesh.skinned;
+    return result;
+}
@@ -0,0 +1,508 @@
+#include "MeshCutter.h"
+#include "FrameAllocator.h"
+#include "JobSystem.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+    // items per job in the parallel stages
+    const size_t CUT_VERTEX_GRAIN = 16384;
+    const size_t CUT_TRIANGLE_GRAIN = 8192;
+    // regula falsi steps placing a corner on a curved surface; planes are exact in one
+    const int ROOT_ITERATIONS = 8;
+    const float ROOT_EPSILON = 1e-6f;
+
+    const uint64_t EMPTY_KEY = ~0ull;
+    const unsigned int NONE = ~0u;
+
+    enum TriangleClass : unsigned char {
+        TRIANGLE_KEEP,
+        TRIANGLE_DROP,
+        TRIANGLE_CLIP
+    };
+
+    uint64_t mix64(uint64_t key) {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdull;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ull;
+        key ^= key >> 33;
+        return key;
+    }
+
+    // Open addressing map from 64 bit keys to indices. Sized once per cut for the
+    // worst case, so it never rehashes.
+    struct ScratchTable {
+        FrameVector<uint64_t> keys;
+        FrameVector<unsigned int> values;
+        size_t mask;
+
+        void reset(size_t maxEntries) {
+            size_t capacity = 16;
+            while (capacity < maxEntries * 2)
+                capacity <<= 1;
+            keys.assign(capacity, EMPTY_KEY);
+            values.resize(capacity);
+            mask = capacity - 1;
+        }
+
+        // first slot holding key or empty
+        size_t find(uint64_t key) const {
+            size_t slot = mix64(key) & mask;
+            while (keys[slot] != EMPTY_KEY && keys[slot] != key)
+                slot = (slot + 1) & mask;
+            return slot;
+        }
+    };
+
+    struct CutScratch {
+        FrameVector<float> distance;
+        FrameVector<unsigned int> remap;
+        FrameVector<size_t> vertexOffsets;
+        FrameVector<unsigned char> triangleClass;
+        FrameVector<size_t> keptOffsets;
+        FrameVector<size_t> clipOffsets;
+        FrameVector<unsigned int> clipTriangles;
+
+        // source edge -> new output vertex, and that vertex's loop point
+        ScratchTable edgeVertices;
+        FrameVector<unsigned int> edgePoint;
+        // cut points welded by position for the cap loops; duplicated seam
+        // vertices cut the same edge into bit-identical points
+        ScratchTable points;
+        FrameVector<glm::vec3> pointEdgeLow;
+        FrameVector<glm::vec3> pointEdgeHigh;
+        FrameVector<glm::vec3> pointPositions;
+        FrameVector<unsigned int> loopNext;
+        FrameVector<unsigned char> visited;
+
+        FrameVector<unsigned int> loop;
+        FrameVector<glm::vec2> polygon;
+        FrameVector<unsigned int> earPrev;
+        FrameVector<unsigned int> earNext;
+    };
+
+    float field(const CutShape* shapes, size_t shapeCount, const glm::vec3& point) {
+        float distance = shapes[0].distance(point);
+        for (size_t s = 1; s < shapeCount; s++)
+            distance = std::min(distance, shapes[s].distance(point));
+        return distance;
+    }
+
+    glm::vec3 safeNormalize(const glm::vec3& v) {
+        float length = glm::length(v);
+        return length > 0.0f ? v / length : v;
+    }
+
+    Vertex lerpVertex(const Vertex& a, const Vertex& b, float s, const glm::vec3& position) {
+        // bone influences do not interpolate, the new corner follows the nearer end's bones
+        Vertex v = s <= 0.5f ? a : b;
+        v.Position = position;
+        v.Normal = safeNormalize(glm::mix(a.Normal, b.Normal, s));
+        v.TexCoords = glm::mix(a.TexCoords, b.TexCoords, s);
+        v.Tangent = safeNormalize(glm::mix(a.Tangent, b.Tangent, s));
+        v.Bitangent = safeNormalize(glm::mix(a.Bitangent, b.Bitangent, s));
+        return v;
+    }
+
+    bool lessPosition(const glm::vec3& a, const glm::vec3& b) {
+        if (a.x != b.x) return a.x < b.x;
+        if (a.y != b.y) return a.y < b.y;
+        return a.z < b.z;
+    }
+
+    // Illinois variant of regula falsi between two points on opposite sides
+    float edgeRoot(const CutShape* shapes, size_t shapeCount, const glm::vec3& low, float lowDistance,
+                   const glm::vec3& high, float highDistance) {
+        float s0 = 0.0f, s1 = 1.0f;
+        float f0 = lowDistance, f1 = highDistance;
+        float s = f0 / (f0 - f1);
+        if (shapeCount == 1 && shapes[0].type == CutShape::PLANE)
+            return s;
+        int side = 0;
+        for (int i = 0; i < ROOT_ITERATIONS; i++) {
+            float fs = field(shapes, shapeCount, glm::mix(low, high, s));
+            if (std::fabs(fs) < ROOT_EPSILON)
+                break;
+            if ((fs < 0.0f) == (f1 < 0.0f)) {
+                s1 = s;
+                f1 = fs;
+                if (side == -1)
+                    f0 *= 0.5f;
+                side = -1;
+            } else {
+                s0 = s;
+                f0 = fs;
+                if (side == 1)
+                    f1 *= 0.5f;
+                side = 1;
+            }
+            s = (s0 * f1 - s1 * f0) / (f1 - f0);
+        }
+        return s;
+    }
+
+    uint64_t hashEdge(const glm::vec3& low, const glm::vec3& high) {
+        uint32_t bits[6];
+        std::memcpy(bits, &low, sizeof(glm::vec3));
+        std::memcpy(bits + 3, &high, sizeof(glm::vec3));
+        uint64_t hash = 1469598103934665603ull;
+        for (int i = 0; i < 6; i++)
+            hash = mix64(hash ^ bits[i]);
+        return hash == EMPTY_KEY ? hash - 1 : hash;
+    }
+
+    float cross2(const glm::vec2& a, const glm::vec2& b, const glm::vec2& c) {
+        return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+    }
+
+    bool insideTriangle(const glm::vec2& p, const glm::vec2& a, const glm::vec2& b, const glm::vec2& c) {
+        return cross2(a, b, p) > 0.0f && cross2(b, c, p) > 0.0f && cross2(c, a, p) > 0.0f;
+    }
+
+    // Ear clipping of one counter-clockwise loop into triangles indexing base + loop position
+    size_t triangulateLoop(CutScratch& scratch, unsigned int base, vector<unsigned int>& outIndices) {
+        const FrameVector<glm::vec2>& polygon = scratch.polygon;
+        unsigned int count = static_cast<unsigned int>(polygon.size());
+        scratch.earPrev.resize(count);
+        scratch.earNext.resize(count);
+        for (unsigned int i = 0; i < count; i++) {
+            scratch.earPrev[i] = (i + count - 1) % count;
+            scratch.earNext[i] = (i + 1) % count;
+        }
+
+        size_t triangles = 0;
+        unsigned int remaining = count;
+        unsigned int current = 0;
+        unsigned int sinceLastEar = 0;
+        while (remaining > 3 && sinceLastEar < remaining) {
+            unsigned int prev = scratch.earPrev[current];
+            unsigned int next = scratch.earNext[current];
+            bool ear = cross2(polygon[prev], polygon[current], polygon[next]) > 0.0f;
+            for (unsigned int other = scratch.earNext[next]; ear && other != prev; other = scratch.earNext[other])
+                ear = !insideTriangle(polygon[other], polygon[prev], polygon[current], polygon[next]);
+            if (!ear) {
+                current = next;
+                sinceLastEar++;
+                continue;
+            }
+            outIndices.push_back(base + prev);
+            outIndices.push_back(base + current);
+            outIndices.push_back(base + next);
+            triangles++;
+            scratch.earNext[prev] = next;
+            scratch.earPrev[next] = prev;
+            remaining--;
+            current = next;
+            sinceLastEar = 0;
+        }
+        // what is left is a triangle, or a degenerate loop closed as a fan
+        unsigned int first = current;
+        for (unsigned int v = scratch.earNext[first]; scratch.earNext[v] != first; v = scratch.earNext[v]) {
+            outIndices.push_back(base + first);
+            outIndices.push_back(base + v);
+            outIndices.push_back(base + scratch.earNext[v]);
+            triangles++;
+        }
+        return triangles;
+    }
+
+    // Closes every boundary loop of a planar cut with a cap facing the removed side
+    size_t buildCaps(CutScratch& scratch, const CutShape& plane, vector<Vertex>& outVertices, vector<unsigned int>& outIndices) {
+        glm::vec3 normal = plane.axis;
+        glm::vec3 reference = std::fabs(normal.y) < 0.9f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+        glm::vec3 u = glm::normalize(glm::cross(reference, normal));
+        glm::vec3 v = glm::cross(normal, u);
+
+        size_t triangles = 0;
+        size_t pointCount = scratch.loopNext.size();
+        scratch.visited.assign(pointCount, 0);
+        for (size_t start = 0; start < pointCount; start++) {
+            if (scratch.visited[start] || scratch.loopNext[start] == NONE)
+                continue;
+            scratch.loop.clear();
+            unsigned int point = static_cast<unsigned int>(start);
+            while (point != NONE && !scratch.visited[point]) {
+                scratch.visited[point] = 1;
+                scratch.loop.push_back(point);
+                point = scratch.loopNext[point];
+            }
+            // open chains come from non-manifold or already open geometry
+            if (point != start || scratch.loop.size() < 3)
+                continue;
+
+            scratch.polygon.resize(scratch.loop.size());
+            float area = 0.0f;
+            for (size_t i = 0; i < scratch.loop.size(); i++) {
+                glm::vec3 position = scratch.pointPositions[scratch.loop[i]];
+                scratch.polygon[i] = glm::vec2(glm::dot(position, u), glm::dot(position, v));
+            }
+            for (size_t i = 0; i < scratch.polygon.size(); i++) {
+                const glm::vec2& a = scratch.polygon[i];
+                const glm::vec2& b = scratch.polygon[(i + 1) % scratch.polygon.size()];
+                area += a.x * b.y - b.x * a.y;
+            }
+            if (area < 0.0f) {
+                std::reverse(scratch.loop.begin(), scratch.loop.end());
+                std::reverse(scratch.polygon.begin(), scratch.polygon.end());
+            }
+
+            unsigned int base = static_cast<unsigned int>(outVertices.size());
+            for (size_t i = 0; i < scratch.loop.size(); i++) {
+                Vertex vertex;
+                vertex.Position = scratch.pointPositions[scratch.loop[i]];
+                vertex.Normal = normal;
+                vertex.TexCoords = scratch.polygon[i];
+                vertex.Tangent = u;
+                vertex.Bitangent = v;
+                outVertices.push_back(vertex);
+            }
+            triangles += triangulateLoop(scratch, base, outIndices);
+        }
+        return triangles;
+    }
+}
+
+CutShape CutShape::plane(const glm::vec3& point, const glm::vec3& removedNormal) {
+    CutShape shape;
+    shape.type = PLANE;
+    shape.origin = point;
+    shape.axis = glm::normalize(removedNormal);
+    shape.length = 0.0f;
+    shape.radius = 0.0f;
+    return shape;
+}
+
+CutShape CutShape::cylinder(const SliceCylinder& cylinder) {
+    CutShape shape;
+    shape.type = CYLINDER;
+    shape.origin = cylinder.start;
+    glm::vec3 axis = cylinder.end - cylinder.start;
+    shape.length = glm::length(axis);
+    shape.axis = shape.length > 0.0f ? axis / shape.length : glm::vec3(0.0f);
+    shape.radius = cylinder.radius;
+    return shape;
+}
+
+float CutShape::distance(const glm::vec3& point) const {
+    glm::vec3 offset = point - origin;
+    float t = glm::dot(offset, axis);
+    if (type == PLANE)
+        return -t;
+    // zero length removes nothing
+    if (length <= 0.0f)
+        return 1.0f;
+    glm::vec3 radial = offset - t * axis;
+    return std::max(glm::length(radial) - radius, std::max(-t, t - length));
+}
+
+// Parallel stages split their input into fixed grains and write disjoint output
+// placed by prefix sums over per-range counts. parallelFor hands out ranges
+// starting at multiples of the grain, or the whole input in one call, so
+// begin / grain is always the range index.
+void MeshCutter::cut(const vector<Vertex>& vertices, const vector<unsigned int>& indices,
+                     const CutShape* shapes, size_t shapeCount, bool caps,
+                     vector<Vertex>& outVertices, vector<unsigned int>& outIndices, CutStats* stats) {
+    TRACE_SCOPE("mesh cut");
+    outVertices.clear();
+    outIndices.clear();
+    const size_t vertexCount = vertices.size();
+    const size_t triangleCount = indices.size() / 3;
+    CutStats localStats;
+    CutStats& result = stats ? *stats : localStats;
+    result = CutStats();
+    result.inputTriangles = triangleCount;
+    if (vertexCount == 0 || triangleCount == 0)
+        return;
+    if (shapeCount == 0) {
+        outVertices = vertices;
+        outIndices = indices;
+        result.keptTriangles = triangleCount;
+        return;
+    }
+
+    // temporaries live in the frame arena; a cut running in the background
+    // holds it (see SliceWorker)
+    CutScratch scratch;
+
+    // Signed distance per source vertex, kept vertices counted per range
+    const size_t vertexRanges = (vertexCount + CUT_VERTEX_GRAIN - 1) / CUT_VERTEX_GRAIN;
+    scratch.distance.resize(vertexCount);
+    scratch.vertexOffsets.assign(vertexRanges + 1, 0);
+    JobSystem::parallelFor(vertexCount, CUT_VERTEX_GRAIN, [&](size_t begin, size_t end) {
+        size_t kept = 0;
+        for (size_t i = begin; i < end; i++) {
+            scratch.distance[i] = field(shapes, shapeCount, vertices[i].Position);
+            kept += scratch.distance[i] >= 0.0f;
+        }
+        scratch.vertexOffsets[begin / CUT_VERTEX_GRAIN + 1] = kept;
+    });
+    for (size_t r = 0; r < vertexRanges; r++)
+        scratch.vertexOffsets[r + 1] += scratch.vertexOffsets[r];
+
+    // Triangles fully outside are kept, fully inside dropped, the rest clipped
+    const size_t triangleRanges = (triangleCount + CUT_TRIANGLE_GRAIN - 1) / CUT_TRIANGLE_GRAIN;
+    scratch.triangleClass.resize(triangleCount);
+    scratch.keptOffsets.assign(triangleRanges + 1, 0);
+    scratch.clipOffsets.assign(triangleRanges + 1, 0);
+    JobSystem::parallelFor(triangleCount, CUT_TRIANGLE_GRAIN, [&](size_t begin, size_t end) {
+        size_t kept = 0, clipped = 0;
+        for (size_t t = begin; t < end; t++) {
+            const unsigned int* corner = &indices[t * 3];
+            int removed = (scratch.distance[corner[0]] < 0.0f) + (scratch.distance[corner[1]] < 0.0f) +
+                          (scratch.distance[corner[2]] < 0.0f);
+            TriangleClass triangleClass = removed == 0 ? TRIANGLE_KEEP : removed == 3 ? TRIANGLE_DROP : TRIANGLE_CLIP;
+            scratch.triangleClass[t] = triangleClass;
+            kept += triangleClass == TRIANGLE_KEEP;
+            clipped += triangleClass == TRIANGLE_CLIP;
+        }
+        scratch.keptOffsets[begin / CUT_TRIANGLE_GRAIN + 1] = kept;
+        scratch.clipOffsets[begin / CUT_TRIANGLE_GRAIN + 1] = clipped;
+    });
+    for (size_t r = 0; r < triangleRanges; r++) {
+        scratch.keptOffsets[r + 1] += scratch.keptOffsets[r];
+        scratch.clipOffsets[r + 1] += scratch.clipOffsets[r];
+    }
+    const size_t keptTriangles = scratch.keptOffsets[triangleRanges];
+    const size_t clipCount = scratch.clipOffsets[triangleRanges];
+    result.keptTriangles = keptTriangles;
+    result.clippedTriangles = clipCount;
+
+    // Every kept vertex belongs to a kept or clipped triangle, so compaction needs
+    // no marking pass. Clipping adds at most two vertices and two triangles each.
+    const size_t keptVertices = scratch.vertexOffsets[vertexRanges];
+    outVertices.reserve(keptVertices + clipCount * 2);
+    outVertices.resize(keptVertices);
+    outIndices.reserve((keptTriangles + clipCount * 2) * 3);
+    outIndices.resize(keptTriangles * 3);
+    scratch.remap.resize(vertexCount);
+    scratch.clipTriangles.resize(clipCount);
+    JobSystem::parallelFor(vertexCount, CUT_VERTEX_GRAIN, [&](size_t begin, size_t end) {
+        size_t next = scratch.vertexOffsets[begin / CUT_VERTEX_GRAIN];
+        for (size_t i = begin; i < end; i++) {
+            if (scratch.distance[i] < 0.0f)
+                continue;
+            scratch.remap[i] = static_cast<unsigned int>(next);
+            outVertices[next++] = vertices[i];
+        }
+    });
+    JobSystem::parallelFor(triangleCount, CUT_TRIANGLE_GRAIN, [&](size_t begin, size_t end) {
+        size_t range = begin / CUT_TRIANGLE_GRAIN;
+        unsigned int* out = outIndices.empty() ? nullptr : &outIndices[scratch.keptOffsets[range] * 3];
+        size_t clip = scratch.clipOffsets[range];
+        for (size_t t = begin; t < end; t++) {
+            if (scratch.triangleClass[t] == TRIANGLE_KEEP) {
+                for (int j = 0; j < 3; j++)
+                    *out++ = scratch.remap[indices[t * 3 + j]];
+            } else if (scratch.triangleClass[t] == TRIANGLE_CLIP) {
+                scratch.clipTriangles[clip++] = static_cast<unsigned int>(t);
+            }
+        }
+    });
+    if (clipCount == 0)
+        return;
+
+    // Clip the straddling triangles against the zero set. The polygon left of
+    // each is convex with at most four corners and fanned into triangles.
+    const bool buildCap = caps && shapeCount == 1 && shapes[0].type == CutShape::PLANE;
+    scratch.edgeVertices.reset(clipCount * 2);
+    scratch.points.reset(buildCap ? clipCount * 2 : 0);
+    // each clipped triangle adds at most two of each; arena memory is not
+    // reused when a vector grows, so reserve the worst case up front
+    scratch.edgePoint.reserve(clipCount * 2);
+    if (buildCap) {
+        scratch.pointEdgeLow.reserve(clipCount * 2);
+        scratch.pointEdgeHigh.reserve(clipCount * 2);
+        scratch.pointPositions.reserve(clipCount * 2);
+        scratch.loopNext.reserve(clipCount * 2);
+    }
+
+    auto edgeVertex = [&](unsigned int a, unsigned int b, unsigned int& point) -> unsigned int {
+        uint64_t key = a < b ? (static_cast<uint64_t>(a) << 32 | b) : (static_cast<uint64_t>(b) << 32 | a);
+        size_t slot = scratch.edgeVertices.find(key);
+        if (scratch.edgeVertices.keys[slot] == key) {
+            unsigned int vertex = scratch.edgeVertices.values[slot];
+            point = scratch.edgePoint[vertex - keptVertices];
+            return vertex;
+        }
+
+        // interpolate from the lexicographically lower endpoint so duplicated
+        // seam edges produce bit-identical points
+        unsigned int low = a, high = b;
+        if (lessPosition(vertices[b].Position, vertices[a].Position))
+            std::swap(low, high);
+        const glm::vec3& lowPosition = vertices[low].Position;
+        const glm::vec3& highPosition = vertices[high].Position;
+        float s = edgeRoot(shapes, shapeCount, lowPosition, scratch.distance[low], highPosition, scratch.distance[high]);
+        s = glm::clamp(s, 0.0f, 1.0f);
+        glm::vec3 position = glm::mix(lowPosition, highPosition, s);
+
+        point = NONE;
+        if (buildCap) {
+            uint64_t hash = hashEdge(lowPosition, highPosition);
+            size_t pointSlot = hash & scratch.points.mask;
+            while (scratch.points.keys[pointSlot] != EMPTY_KEY) {
+                unsigned int candidate = scratch.points.values[pointSlot];
+                if (scratch.points.keys[pointSlot] == hash && scratch.pointEdgeLow[candidate] == lowPosition &&
+                    scratch.pointEdgeHigh[candidate] == highPosition) {
+                    point = candidate;
+                    break;
+                }
+                pointSlot = (pointSlot + 1) & scratch.points.mask;
+            }
+            if (point == NONE) {
+                point = static_cast<unsigned int>(scratch.pointPositions.size());
+                scratch.points.keys[pointSlot] = hash;
+                scratch.points.values[pointSlot] = point;
+                scratch.pointEdgeLow.push_back(lowPosition);
+                scratch.pointEdgeHigh.push_back(highPosition);
+                scratch.pointPositions.push_back(position);
+                scratch.loopNext.push_back(NONE);
+            }
+        }
+
+        unsigned int vertex = static_cast<unsigned int>(outVertices.size());
+        outVertices.push_back(lerpVertex(vertices[low], vertices[high], s, position));
+        scratch.edgeVertices.keys[slot] = key;
+        scratch.edgeVertices.values[slot] = vertex;
+        scratch.edgePoint.push_back(point);
+        return vertex;
+    };
+
+    for (size_t c = 0; c < clipCount; c++) {
+        const unsigned int* corner = &indices[scratch.clipTriangles[c] * 3];
+        unsigned int polygon[4];
+        int count = 0;
+        unsigned int exitPoint = NONE, entryPoint = NONE;
+        for (int j = 0; j < 3; j++) {
+            unsigned int a = corner[j], b = corner[(j + 1) % 3];
+            bool keepA = scratch.distance[a] >= 0.0f;
+            bool keepB = scratch.distance[b] >= 0.0f;
+            if (keepA)
+                polygon[count++] = scratch.remap[a];
+            if (keepA != keepB) {
+                unsigned int point;
+                polygon[count++] = edgeVertex(a, b, point);
+                if (keepA)
+                    exitPoint = point;
+                else
+                    entryPoint = point;
+            }
+        }
+        for (int k = 1; k + 1 < count; k++) {
+            outIndices.push_back(polygon[0]);
+            outIndices.push_back(polygon[k]);
+            outIndices.push_back(polygon[k + 1]);
+        }
+        // the surface runs exit -> entry along the cut, the cap the other way
+        if (buildCap && entryPoint != NONE && exitPoint != NONE)
+            scratch.loopNext[entryPoint] = exitPoint;
+    }
+
+    if (buildCap)
+        result.capTriangles = buildCaps(scratch, shapes[0], outVertices, outIndices);
+}
@@ -1,31 +1,213 @@
 #include "Model.h"
+#include "AnimationCompressor.h"
+#include "FrameAllocator.h"
+#include "JobSystem.h"
+#include "MeshCutter.h"
 
-void Model::loadModel(string const &path) {
-    // read file via ASSIMP
+#include <assimp/config.h>
+
+#include <chrono>
+
+namespace {
+    // assimp matrices are row major
+    glm::mat4 toGlm(const aiMatrix4x4& m) {
+        return glm::mat4(m.a1, m.b1, m.c1, m.d1,
+                         m.a2, m.b2, m.c2, m.d2,
+                         m.a3, m.b3, m.c3, m.d3,
+                         m.a4, m.b4, m.c4, m.d4);
+    }
+
+    // meshes past these are split by the STANDARD and MERGED profiles, keeping
+    // what culling and cutting work on to a bounded size
+    const int SPLIT_VERTEX_LIMIT = 65535;
+    const int SPLIT_TRIANGLE_LIMIT = 131072;
+
+    const unsigned int BASE_STEPS = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs |
+                                    aiProcess_CalcTangentSpace;
+    const unsigned int STANDARD_STEPS = aiProcess_JoinIdenticalVertices | aiProcess_FindDegenerates |
+                                        aiProcess_SortByPType | aiProcess_ImproveCacheLocality |
+                                        aiProcess_SplitLargeMeshes;
+    const unsigned int MERGED_STEPS = STANDARD_STEPS | aiProcess_RemoveRedundantMaterials | aiProcess_OptimizeMeshes |
+                                      aiProcess_OptimizeGraph;
+
+    // vertices and triangles of every mesh a node places, and how many placements
+    void countPlaced(const aiScene* scene, const aiNode* node, size_t& vertices, size_t& triangles, size_t& meshes) {
+        for (unsigned int i = 0; i < node->mNumMeshes; i++) {
+            const aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+            vertices += mesh->mNumVertices;
+            triangles += mesh->mNumFaces;
+            meshes++;
+        }
+        for (unsigned int i = 0; i < node->mNumChildren; i++)
+            countPlaced(scene, node->mChildren[i], vertices, triangles, meshes);
+    }
+}
+
+const char* importProfileName(ImportProfile profile) {
+    switch (profile) {
+    case ImportProfile::RAW: return "raw";
+    case ImportProfile::STANDARD: return "standard";
+    default: return "merged";
+    }
+}
+
+void Model::loadModel(string const &path, ImportProfile profile) {
+    TRACE_SCOPE("model load");
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    // read file via ASSIMP; the basic steps first, so the profile's effect can be counted
     Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+    importer.SetPropertyInteger(AI_CONFIG_PP_FD_REMOVE, 1);
+    importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_POINT | aiPrimitiveType_LINE);
+    importer.SetPropertyInteger(AI_CONFIG_PP_SLM_VERTEX_LIMIT, SPLIT_VERTEX_LIMIT);
+    importer.SetPropertyInteger(AI_CONFIG_PP_SLM_TRIANGLE_LIMIT, SPLIT_TRIANGLE_LIMIT);
+    const aiScene* scene;
+    {
+        TRACE_SCOPE("assimp import");
+        scene = importer.ReadFile(path, BASE_STEPS);
+    }
     // check for errors
     if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
         cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
         return;
     }
+    importStats = ImportStats();
+    countPlaced(scene, scene->mRootNode, importStats.verticesBefore, importStats.trianglesBefore, importStats.meshesBefore);
+    if (profile != ImportProfile::RAW) {
+        TRACE_SCOPE("assimp post-process");
+        scene = importer.ApplyPostProcessing(profile == ImportProfile::MERGED ? MERGED_STEPS : STANDARD_STEPS);
+        if (!scene || !scene->mRootNode) {
+            cout << "ERROR::ASSIMP::POST_PROCESS: " << importer.GetErrorString() << endl;
+            return;
+        }
+    }
+    importStats.importMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
     // retrieve the directory path of the filepath
     directory = path.substr(0, path.find_last_of('/'));
 
-    // process ASSIMP's root node recursively
-    processNode(scene->mRootNode, scene);
+    processNodes(scene);
+    processAnimations(scene);
+
+    for (size_t i = 0; i < meshes.size(); i++) {
+        importStats.verticesAfter += meshes[i].vertices.size();
+        importStats.trianglesAfter += meshes[i].indices.size() / 3;
+    }
+    importStats.meshesAfter = meshes.size();
+    cout << path << " (" << importProfileName(profile) << "): " << importStats.verticesBefore << " -> "
+         << importStats.verticesAfter << " vertices, " << importStats.trianglesBefore << " -> " << importStats.trianglesAfter
+         << " triangles, " << importStats.meshesBefore << " -> " << importStats.meshesAfter << " meshes, "
+         << importStats.importMilliseconds << " ms import" << endl;
+}
+
+void Model::processNodes(const aiScene *scene) {
+    // breadth first, so the graph's arrays come out parent before child
+    nodes.clear();
+    vector<const aiNode*> queue(1, scene->mRootNode);
+    vector<int> queueParents(1, SceneGraph::NO_PARENT);
+    for (size_t head = 0; head < queue.size(); head++) {
+        const aiNode* node = queue[head];
+        unsigned int index = nodes.addNode(queueParents[head], node->mName.C_Str(), toGlm(node->mTransformation));
+        // a mesh referenced from several nodes becomes one mesh per node
+        for (unsigned int i = 0; i < node->mNumMeshes; i++) {
+            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+            meshes.push_back(processMesh(mesh, scene));
+            meshes.back().node = meshes.back().skinned ? SceneGraph::NO_NODE : index;
+        }
+        for (unsigned int i = 0; i < node->mNumChildren; i++) {
+            queue.push_back(node->mChildren[i]);
+            queueParents.push_back(static_cast<int>(index));
+        }
+    }
+    nodes.update();
+
+    // rest pose, the nodes' imported transforms split into their components
+    restPose.resize(nodes.size());
+    for (unsigned int i = 0; i < nodes.size(); i++) {
+        const glm::mat4& local = nodes.getLocal(i);
+        glm::vec3 scale(glm::length(glm::vec3(local[0])), glm::length(glm::vec3(local[1])), glm::length(glm::vec3(local[2])));
+        restPose.translations[i] = glm::vec3(local[3]);
+        restPose.scales[i] = scale;
+        restPose.rotations[i] = glm::normalize(glm::quat_cast(glm::mat3(glm::vec3(local[0]) / scale.x, glm::vec3(local[1]) / scale.y,
+                                                                         glm::vec3(local[2]) / scale.z)));
+    }
+    for (unordered_map<string, unsigned int>::const_iterator it = boneIndices.begin(); it != boneIndices.end(); ++it) {
+        int node = nodes.find(it->first);
+        if (node < 0)
+            cout << "ERROR::ASSIMP::BONE_WITHOUT_NODE: " << it->first << endl;
+        bones[it->second].node = node < 0 ? 0 : static_cast<unsigned int>(node);
+    }
+    boneIndices.clear();
+}
+
+void Model::processAnimations(const aiScene *scene) {
+    vector<AnimationChannel> channels;
+    for (unsigned int a = 0; a < scene->mNumAnimations; a++) {
+        const aiAnimation* animation = scene->mAnimations[a];
+        double ticksPerSecond = animation->mTicksPerSecond > 0.0 ? animation->mTicksPerSecond : 25.0;
+        channels.clear();
+        for (unsigned int c = 0; c < animation->mNumChannels; c++) {
+            const aiNodeAnim* channel = animation->mChannels[c];
+            int node = nodes.find(channel->mNodeName.C_Str());
+            if (node < 0)
+                continue;
+            channels.push_back(AnimationChannel());
+            AnimationChannel& keys = channels.back();
+            keys.node = static_cast<unsigned int>(node);
+            for (unsigned int k = 0; k < channel->mNumPositionKeys; k++) {
+                const aiVectorKey& key = channel->mPositionKeys[k];
+                keys.translationTimes.push_back(static_cast<float>(key.mTime / ticksPerSecond));
+                keys.translations.push_back(glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+            }
+            for (unsigned int k = 0; k < channel->mNumRotationKeys; k++) {
+                const aiQuatKey& key = channel->mRotationKeys[k];
+                keys.rotationTimes.push_back(static_cast<float>(key.mTime / ticksPerSecond));
+                keys.rotations.push_back(glm::quat(key.mValue.w, key.mValue.x, key.mValue.y, key.mValue.z));
+            }
+            for (unsigned int k = 0; k < channel->mNumScalingKeys; k++) {
+                const aiVectorKey& key = channel->mScalingKeys[k];
+                keys.scaleTimes.push_back(static_cast<float>(key.mTime / ticksPerSecond));
+                keys.scales.push_back(glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+            }
+        }
+        // only the compressed clip is kept, the raw keys go with this scope
+        animations.push_back(AnimationCompressor::compress(animation->mName.C_Str(),
+                                                           static_cast<float>(animation->mDuration / ticksPerSecond),
+                                                           channels, AnimationTolerance(), &animationStats));
+    }
 }
 
-void Model::processNode(aiNode *node, const aiScene *scene) {
-    // process each mesh located at the current node
-    for(unsigned int i = 0; i < node->mNumMeshes; i++) {
-        aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        meshes.push_back(processMesh(mesh, scene));
+void Model::Draw(Shader &shader, const glm::mat4& modelMatrix, const glm::mat3& normalMatrix, bool skinning) {
+    nodes.update();
+    bool flat = nodes.isFlat();
+    // the uniforms only change where consecutive meshes hang from different nodes
+    const unsigned int ROOT_SET = ~0u;
+    unsigned int current = ROOT_SET;
+    bool skinningSet = false;
+    for (unsigned int i = 0; i < meshes.size(); i++) {
+        unsigned int node = meshes[i].node;
+        if (flat || nodes.isIdentity(node)) {
+            if (current != ROOT_SET) {
+                shader.setMat4("model", modelMatrix);
+                shader.setMat3("normalMatrix", normalMatrix);
+                current = ROOT_SET;
+            }
+        } else if (node != current) {
+            shader.setMat4("model", modelMatrix * nodes.getWorld(node));
+            shader.setMat3("normalMatrix", normalMatrix * nodes.getWorldNormal(node));
+            current = node;
+        }
+        bool skinned = skinning && meshes[i].skinned;
+        if (skinned != skinningSet) {
+            shader.setBool("skinned", skinned);
+            skinningSet = skinned;
+        }
+        meshes[i].Draw(shader);
     }
-    // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
-    for(unsigned int i = 0; i < node->mNumChildren; i++) {
-        processNode(node->mChildren[i], scene);
+    if (current != ROOT_SET) {
+        shader.setMat4("model", modelMatrix);
+        shader.setMat3("normalMatrix", normalMatrix);
     }
+    if (skinningSet)
+        shader.setBool("skinned", false);
 }
 
 Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene) {
@@ -77,6 +259,42 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene) {
         vertices.push_back(vertex);
     }
 
+    // bone weights, keeping the strongest MAX_BONE_INFLUENCE of each vertex
+    for (unsigned int b = 0; b < mesh->mNumBones; b++) {
+        const aiBone* bone = mesh->mBones[b];
+        unordered_map<string, unsigned int>::iterator found = boneIndices.find(bone->mName.C_Str());
+        unsigned int boneId;
+        if (found == boneIndices.end()) {
+            boneId = static_cast<unsigned int>(bones.size());
+            Bone info = { 0, toGlm(bone->mOffsetMatrix) };
+            bones.push_back(info);
+            boneIndices[bone->mName.C_Str()] = boneId;
+        } else {
+            boneId = found->second;
+        }
+        for (unsigned int w = 0; w < bone->mNumWeights; w++) {
+            Vertex& vertex = vertices[bone->mWeights[w].mVertexId];
+            unsigned int weakest = 0;
+            for (unsigned int j = 1; j < MAX_BONE_INFLUENCE; j++) {
+                if (vertex.Weights[j] < vertex.Weights[weakest])
+                    weakest = j;
+            }
+            if (bone->mWeights[w].mWeight > vertex.Weights[weakest]) {
+                vertex.BoneIDs[weakest] = static_cast<int>(boneId);
+                vertex.Weights[weakest] = bone->mWeights[w].mWeight;
+            }
+        }
+    }
+    if (mesh->mNumBones > 0) {
+        for (size_t i = 0; i < vertices.size(); i++) {
+            float sum = 0.0f;
+            for (unsigned int j = 0; j < MAX_BONE_INFLUENCE; j++)
+                sum += vertices[i].Weights[j];
+            for (unsigned int j = 0; j < MAX_BONE_INFLUENCE && sum > 0.0f; j++)
+                vertices[i].Weights[j] /= sum;
+        }
+    }
+
     // process indices
     for(unsigned int i = 0; i < mesh->mNumFaces; i++) {
         aiFace face = mesh->mFaces[i];
@@ -99,7 +317,9 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene) {
     vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
     textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
     
-    return Mesh(vertices, indices, textures);
+    Mesh result(std::move(vertices), std::move(indices), std::move(textures));
+    result.skinned = mesh->mNumBones > 0;
+    return result;
 }
 
 vector<Texture> Model::loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName) {
@@ -144,17 +364,21 @@ vector<Model> Model::sliceModel(float xThreshold) {
     if (!leftMeshes.empty()) {
         Model leftModel;
         leftModel.meshes = leftMeshes;
+        leftModel.nodes = nodes;
         leftModel.textures_loaded = textures_loaded;
         leftModel.directory = directory;
         leftModel.gammaCorrection = gammaCorrection;
+        leftModel.updateBounds();
         resultModels.push_back(leftModel);
     }
     if (!rightMeshes.empty()) {
         Model rightModel;
         rightModel.meshes = rightMeshes;
+        rightModel.nodes = nodes;
         rightModel.textures_loaded = textures_loaded;
         rightModel.directory = directory;
         rightModel.gammaCorrection = gammaCorrection;
+        rightModel.updateBounds();
         resultModels.push_back(rightModel);
     }
 
@@ -162,17 +386,72 @@ vector<Model> Model::sliceModel(float xThreshold) {
 }
 
 void Model::sliceModelCylinder(const glm::vec3& cylinderAxisStart, const glm::vec3& cylinderAxisEnd, float cylinderRadius) {
+    TRACE_SCOPE("slice model");
+    // Meshes are cut concurrently (and large ones split again into triangle
+    // ranges); only the buffer upload afterwards has to stay on the GL thread
+    SliceCylinder cylinder = { cylinderAxisStart, cylinderAxisEnd, cylinderRadius };
+    vector<vector<Vertex>> slicedVertices;
+    vector<vector<unsigned int>> slicedIndices;
+    vector<glm::mat4> meshTransforms;
+    getMeshTransforms(meshTransforms);
+    sliceGeometry(&cylinder, 1, slicedVertices, slicedIndices, meshTransforms.empty() ? nullptr : meshTransforms.data());
+    replaceGeometry(slicedVertices, slicedIndices);
+}
+
+void Model::sliceGeometry(const SliceCylinder* cylinders, size_t cylinderCount,
+                          vector<vector<Vertex>>& slicedVertices, vector<vector<unsigned int>>& slicedIndices,
+                          const glm::mat4* meshTransforms) const {
+    FrameVector<CutShape> shapes;
+    shapes.reserve(cylinderCount);
+    for (size_t c = 0; c < cylinderCount; c++)
+        shapes.push_back(CutShape::cylinder(cylinders[c]));
+    slicedVertices.resize(meshes.size());
+    slicedIndices.resize(meshes.size());
+    JobSystem::parallelFor(meshes.size(), 1, [&](size_t begin, size_t end) {
+        FrameVector<CutShape> nodeShapes;
+        nodeShapes.reserve(cylinderCount);
+        for (size_t i = begin; i < end; i++) {
+            const CutShape* meshShapes = shapes.data();
+            if (meshTransforms && meshTransforms[i] != glm::mat4(1.0f)) {
+                // node transforms are rigid with a uniform scale, which carries over to the radius
+                glm::mat4 toMesh = glm::inverse(meshTransforms[i]);
+                float radiusScale = glm::length(glm::vec3(toMesh[0]));
+                nodeShapes.clear();
+                for (size_t c = 0; c < cylinderCount; c++) {
+                    SliceCylinder cylinder = { glm::vec3(toMesh * glm::vec4(cylinders[c].start, 1.0f)),
+                                               glm::vec3(toMesh * glm::vec4(cylinders[c].end, 1.0f)),
+                                               cylinders[c].radius * radiusScale };
+                    nodeShapes.push_back(CutShape::cylinder(cylinder));
+                }
+                meshShapes = nodeShapes.data();
+            }
+            MeshCutter::cut(meshes[i].vertices, meshes[i].indices, meshShapes, shapes.size(), false, slicedVertices[i], slicedIndices[i]);
+        }
+    });
+}
+
+void Model::replaceGeometry(vector<vector<Vertex>>& slicedVertices, vector<vector<unsigned int>>& slicedIndices) {
+    TRACE_SCOPE("slice upload");
     std::vector<Mesh> slicedMeshes;
     slicedMeshes.reserve(meshes.size());
-
-    for (Mesh& mesh : meshes) {
-        Mesh slicedMesh = mesh.sliceMeshCyl(mesh, cylinderAxisStart, cylinderAxisEnd, cylinderRadius);
-        if (!slicedMesh.vertices.empty() && !slicedMesh.indices.empty()) {
-            slicedMeshes.push_back(std::move(slicedMesh));
+    for (size_t i = 0; i < meshes.size(); i++) {
+        if (!slicedVertices[i].empty() && !slicedIndices[i].empty()) {
+            slicedMeshes.push_back(Mesh(std::move(slicedVertices[i]), std::move(slicedIndices[i]), meshes[i].textures));
+            slicedMeshes.back().node = meshes[i].node;
+            slicedMeshes.back().skinned = meshes[i].skinned;
         }
     }
 
+    release();
     meshes = std::move(slicedMeshes);
+    updateBounds();
+}
+
+void Model::release() {
+    for (size_t i = 0; i < meshes.size(); i++)
+        meshes[i].release();
+    meshes.clear();
+    updateBounds();
 }
 
 bool Model::HitBoundingBox(const glm::vec3& minB, const glm::vec3& maxB, const glm::vec3& origin, const glm::vec3& dir, glm::vec3& coord) {
@@ -230,22 +509,42 @@ bool Model::HitBoundingBox(const glm::vec3& minB, const glm::vec3& maxB, const g
     return true;
 }
 
-glm::vec3 Model::getBoundingBoxMin() const {
-    glm::vec3 minBounds(std::numeric_limits<float>::max());
+void Model::updateBounds() {
+    nodes.update();
+    boundsMin = glm::vec3(std::numeric_limits<float>::max());
+    boundsMax = glm::vec3(std::numeric_limits<float>::lowest());
     for (const auto& mesh : meshes) {
+        glm::vec3 meshMin(std::numeric_limits<float>::max());
+        glm::vec3 meshMax(std::numeric_limits<float>::lowest());
         for (const auto& vertex : mesh.vertices) {
-            minBounds = glm::min(minBounds, vertex.Position);
+            meshMin = glm::min(meshMin, vertex.Position);
+            meshMax = glm::max(meshMax, vertex.Position);
         }
+        if (mesh.vertices.empty())
+            continue;
+        if (nodes.isIdentity(mesh.node)) {
+            boundsMin = glm::min(boundsMin, meshMin);
+            boundsMax = glm::max(boundsMax, meshMax);
+            continue;
+        }
+        // the node space box carried into model space
+        glm::mat4 world = nodes.getWorld(mesh.node);
+        glm::vec3 center = glm::vec3(world * glm::vec4((meshMin + meshMax) * 0.5f, 1.0f));
+        glm::vec3 halfExtent = (meshMax - meshMin) * 0.5f;
+        glm::vec3 extent = glm::abs(glm::vec3(world[0])) * halfExtent.x + glm::abs(glm::vec3(world[1])) * halfExtent.y +
+                           glm::abs(glm::vec3(world[2])) * halfExtent.z;
+        boundsMin = glm::min(boundsMin, center - extent);
+        boundsMax = glm::max(boundsMax, center + extent);
     }
-    return minBounds;
 }
 
-glm::vec3 Model::getBoundingBoxMax() const {
-    glm::vec3 maxBounds(std::numeric_limits<float>::lowest());
-    for (const auto& mesh : meshes) {
-        for (const auto& vertex : mesh.vertices) {
-            maxBounds = glm::max(maxBounds, vertex.Position);
-        }
-    }
-    return maxBounds;
-} 
\ No newline at end of file
+bool Model::getMeshTransforms(vector<glm::mat4>& transforms) {
+    transforms.clear();
+    nodes.update();
+    if (nodes.isFlat())
+        return false;
+    transforms.reserve(meshes.size());
+    for (size_t i = 0; i < meshes.size(); i++)
+        transforms.push_back(nodes.getWorld(meshes[i].node));
+    return true;
+}
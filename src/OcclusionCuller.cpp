@@ -0,0 +1,296 @@
+#include "OcclusionCuller.h"
+#include "JobSystem.h"
+#include "Model.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+namespace {
+    // rows per raster job
+    const unsigned int BAND_ROWS = 8;
+    // triangles per setup job
+    const size_t SETUP_TRIANGLES = 512;
+
+    // The few operations the raster and test loops need, over as many pixels
+    // of a row as the build's widest instruction set holds.
+#if defined(__AVX2__)
+    typedef __m256 Lanes;
+    const unsigned int LANES = 8;
+    inline Lanes splat(float value) { return _mm256_set1_ps(value); }
+    inline Lanes laneIndices() { return _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f); }
+    inline Lanes load(const float* source) { return _mm256_loadu_ps(source); }
+    inline void store(float* target, Lanes value) { _mm256_storeu_ps(target, value); }
+    inline Lanes add(Lanes a, Lanes b) { return _mm256_add_ps(a, b); }
+    inline Lanes mul(Lanes a, Lanes b) { return _mm256_mul_ps(a, b); }
+    // depth nearer of old and z where all three edges are inside
+    inline Lanes insideMax(Lanes old, Lanes z, Lanes e0, Lanes e1, Lanes e2) {
+        Lanes inside = _mm256_cmp_ps(_mm256_min_ps(e0, _mm256_min_ps(e1, e2)), _mm256_setzero_ps(), _CMP_GE_OQ);
+        return _mm256_blendv_ps(old, _mm256_max_ps(old, z), inside);
+    }
+    // a pixel within [first, last] whose depth is farther than nearest
+    inline bool anyFarther(Lanes depth, Lanes nearest, Lanes x, Lanes first, Lanes last) {
+        Lanes hit = _mm256_and_ps(_mm256_cmp_ps(depth, nearest, _CMP_LT_OQ),
+                                  _mm256_and_ps(_mm256_cmp_ps(x, first, _CMP_GE_OQ), _mm256_cmp_ps(x, last, _CMP_LE_OQ)));
+        return _mm256_movemask_ps(hit) != 0;
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    typedef __m128 Lanes;
+    const unsigned int LANES = 4;
+    inline Lanes splat(float value) { return _mm_set1_ps(value); }
+    inline Lanes laneIndices() { return _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f); }
+    inline Lanes load(const float* source) { return _mm_loadu_ps(source); }
+    inline void store(float* target, Lanes value) { _mm_storeu_ps(target, value); }
+    inline Lanes add(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+    inline Lanes mul(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+    inline Lanes insideMax(Lanes old, Lanes z, Lanes e0, Lanes e1, Lanes e2) {
+        Lanes inside = _mm_cmpge_ps(_mm_min_ps(e0, _mm_min_ps(e1, e2)), _mm_setzero_ps());
+        return _mm_or_ps(_mm_and_ps(inside, _mm_max_ps(old, z)), _mm_andnot_ps(inside, old));
+    }
+    inline bool anyFarther(Lanes depth, Lanes nearest, Lanes x, Lanes first, Lanes last) {
+        Lanes hit = _mm_and_ps(_mm_cmplt_ps(depth, nearest), _mm_and_ps(_mm_cmpge_ps(x, first), _mm_cmple_ps(x, last)));
+        return _mm_movemask_ps(hit) != 0;
+    }
+#else
+    typedef float Lanes;
+    const unsigned int LANES = 1;
+    inline Lanes splat(float value) { return value; }
+    inline Lanes laneIndices() { return 0.0f; }
+    inline Lanes load(const float* source) { return *source; }
+    inline void store(float* target, Lanes value) { *target = value; }
+    inline Lanes add(Lanes a, Lanes b) { return a + b; }
+    inline Lanes mul(Lanes a, Lanes b) { return a * b; }
+    inline Lanes insideMax(Lanes old, Lanes z, Lanes e0, Lanes e1, Lanes e2) {
+        return std::min(e0, std::min(e1, e2)) >= 0.0f ? std::max(old, z) : old;
+    }
+    inline bool anyFarther(Lanes depth, Lanes nearest, Lanes x, Lanes first, Lanes last) {
+        return depth < nearest && x >= first && x <= last;
+    }
+#endif
+}
+
+OcclusionCuller::OcclusionCuller(unsigned int width, unsigned int height)
+    : width(std::max(width, 1u)), height(std::max(height, 1u)), viewProjection(1.0f), triangleCount(0) {
+    // whole SIMD steps per row, so a step starting inside a row never leaves it
+    stride = (this->width + LANES - 1) / LANES * LANES;
+    depth.assign(stride * this->height, 0.0f);
+}
+
+unsigned int OcclusionCuller::getLaneCount() {
+    return LANES;
+}
+
+void OcclusionCuller::selectOccluders(const Model& model, float minExtent, std::vector<unsigned int>& meshes) {
+    meshes.clear();
+    for (size_t i = 0; i < model.meshes.size(); i++) {
+        const Mesh& mesh = model.meshes[i];
+        if (mesh.skinned || mesh.vertices.empty() || mesh.indices.empty())
+            continue;
+        glm::vec3 boundsMin = mesh.vertices[0].Position;
+        glm::vec3 boundsMax = boundsMin;
+        for (size_t v = 1; v < mesh.vertices.size(); v++) {
+            boundsMin = glm::min(boundsMin, mesh.vertices[v].Position);
+            boundsMax = glm::max(boundsMax, mesh.vertices[v].Position);
+        }
+        glm::vec3 extent = boundsMax - boundsMin;
+        if (std::max(extent.x, std::max(extent.y, extent.z)) >= minExtent)
+            meshes.push_back(static_cast<unsigned int>(i));
+    }
+}
+
+void OcclusionCuller::beginFrame(const glm::mat4& newViewProjection) {
+    viewProjection = newViewProjection;
+    occluders.clear();
+    triangleCount = 0;
+    stats = OcclusionStats();
+}
+
+void OcclusionCuller::addOccluder(const glm::vec3* positions, size_t strideBytes, const unsigned int* indices,
+                                  size_t indexCount, const glm::mat4& matrix) {
+    Occluder occluder;
+    occluder.positions = positions;
+    occluder.strideBytes = strideBytes;
+    occluder.indices = indices;
+    occluder.triangleCount = indexCount / 3;
+    occluder.matrix = viewProjection * matrix;
+    occluder.firstTriangle = triangleCount;
+    occluders.push_back(occluder);
+    triangleCount += occluder.triangleCount;
+}
+
+void OcclusionCuller::render() {
+    TRACE_SCOPE("occlusion raster");
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::fill(depth.begin(), depth.end(), 0.0f);
+    setups.resize(triangleCount);
+
+    JobSystem::parallelFor(triangleCount, SETUP_TRIANGLES, [this](size_t begin, size_t end) {
+        setupTriangles(begin, end);
+    });
+    unsigned int bands = (height + BAND_ROWS - 1) / BAND_ROWS;
+    JobSystem::parallelFor(bands, 1, [this](size_t begin, size_t end) {
+        for (size_t band = begin; band < end; band++) {
+            unsigned int firstRow = static_cast<unsigned int>(band) * BAND_ROWS;
+            rasterizeBand(firstRow, std::min(firstRow + BAND_ROWS, height));
+        }
+    });
+
+    stats.occluderTriangles = triangleCount;
+    for (size_t i = 0; i < setups.size(); i++) {
+        if (setups[i].minY <= setups[i].maxY)
+            stats.rasterizedTriangles++;
+    }
+    stats.rasterMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void OcclusionCuller::setupTriangles(size_t begin, size_t end) {
+    // the occluder holding triangle begin; a range rarely spans more than two
+    size_t o = 0;
+    while (o + 1 < occluders.size() && occluders[o + 1].firstTriangle <= begin)
+        o++;
+
+    for (size_t t = begin; t < end; t++) {
+        while (t >= occluders[o].firstTriangle + occluders[o].triangleCount)
+            o++;
+        const Occluder& occluder = occluders[o];
+        const unsigned int* index = occluder.indices + (t - occluder.firstTriangle) * 3;
+        TriangleSetup& setup = setups[t];
+        setup.minY = INT_MAX;
+        setup.maxY = -1;
+
+        float x[3], y[3], z[3];
+        bool clipped = false;
+        for (int v = 0; v < 3; v++) {
+            const glm::vec3& position = *reinterpret_cast<const glm::vec3*>(
+                reinterpret_cast<const char*>(occluder.positions) + index[v] * occluder.strideBytes);
+            glm::vec4 clip = occluder.matrix * glm::vec4(position, 1.0f);
+            // partly behind the near plane: left out rather than clipped
+            if (clip.z < -clip.w || clip.w <= 0.0f) {
+                clipped = true;
+                break;
+            }
+            z[v] = 1.0f / clip.w;
+            x[v] = (clip.x * z[v] * 0.5f + 0.5f) * width;
+            y[v] = (clip.y * z[v] * 0.5f + 0.5f) * height;
+        }
+        if (clipped)
+            continue;
+
+        // counter-clockwise is the front, as in GL
+        float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+        if (!(area > 0.0f))
+            continue;
+
+        // pixel centers within the triangle's bounds
+        int minX = std::max(0, static_cast<int>(std::ceil(std::min(x[0], std::min(x[1], x[2])) - 0.5f)));
+        int maxX = std::min(static_cast<int>(width) - 1, static_cast<int>(std::floor(std::max(x[0], std::max(x[1], x[2])) - 0.5f)));
+        int minY = std::max(0, static_cast<int>(std::ceil(std::min(y[0], std::min(y[1], y[2])) - 0.5f)));
+        int maxY = std::min(static_cast<int>(height) - 1, static_cast<int>(std::floor(std::max(y[0], std::max(y[1], y[2])) - 0.5f)));
+        if (minX > maxX || minY > maxY)
+            continue;
+
+        // edge i faces vertex i and equals area there, so edge / area are the barycentrics
+        float invArea = 1.0f / area;
+        setup.depthA = setup.depthB = setup.depthC = 0.0f;
+        for (int i = 0; i < 3; i++) {
+            int a = (i + 1) % 3, b = (i + 2) % 3;
+            setup.edgeA[i] = y[a] - y[b];
+            setup.edgeB[i] = x[b] - x[a];
+            setup.edgeC[i] = -(setup.edgeA[i] * x[a] + setup.edgeB[i] * y[a]);
+            setup.depthA += setup.edgeA[i] * z[i] * invArea;
+            setup.depthB += setup.edgeB[i] * z[i] * invArea;
+            setup.depthC += setup.edgeC[i] * z[i] * invArea;
+        }
+        setup.minX = minX;
+        setup.maxX = maxX;
+        setup.minY = minY;
+        setup.maxY = maxY;
+    }
+}
+
+void OcclusionCuller::rasterizeBand(unsigned int firstRow, unsigned int endRow) {
+    const Lanes centers = add(laneIndices(), splat(0.5f));
+    for (size_t t = 0; t < setups.size(); t++) {
+        const TriangleSetup& s = setups[t];
+        if (s.maxY < static_cast<int>(firstRow) || s.minY >= static_cast<int>(endRow))
+            continue;
+        int rowBegin = std::max(s.minY, static_cast<int>(firstRow));
+        int rowEnd = std::min(s.maxY + 1, static_cast<int>(endRow));
+        int columnBegin = s.minX / static_cast<int>(LANES) * static_cast<int>(LANES);
+
+        const Lanes a0 = splat(s.edgeA[0]), a1 = splat(s.edgeA[1]), a2 = splat(s.edgeA[2]);
+        const Lanes depthA = splat(s.depthA);
+        for (int y = rowBegin; y < rowEnd; y++) {
+            float py = y + 0.5f;
+            const Lanes row0 = splat(s.edgeB[0] * py + s.edgeC[0]);
+            const Lanes row1 = splat(s.edgeB[1] * py + s.edgeC[1]);
+            const Lanes row2 = splat(s.edgeB[2] * py + s.edgeC[2]);
+            const Lanes rowDepth = splat(s.depthB * py + s.depthC);
+            float* pixels = depth.data() + y * stride;
+            for (int x = columnBegin; x <= s.maxX; x += LANES) {
+                Lanes px = add(splat(static_cast<float>(x)), centers);
+                Lanes e0 = add(mul(a0, px), row0);
+                Lanes e1 = add(mul(a1, px), row1);
+                Lanes e2 = add(mul(a2, px), row2);
+                Lanes z = add(mul(depthA, px), rowDepth);
+                store(pixels + x, insideMax(load(pixels + x), z, e0, e1, e2));
+            }
+        }
+    }
+}
+
+bool OcclusionCuller::isVisible(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+    stats.tested++;
+    float minX = static_cast<float>(width), maxX = 0.0f;
+    float minY = static_cast<float>(height), maxY = 0.0f;
+    float nearest = 0.0f;
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 corner((i & 1) ? boundsMax.x : boundsMin.x, (i & 2) ? boundsMax.y : boundsMin.y,
+                         (i & 4) ? boundsMax.z : boundsMin.z);
+        glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+        // reaches the camera, nothing can be in front of it
+        if (clip.z < -clip.w || clip.w <= 0.0f)
+            return true;
+        float invW = 1.0f / clip.w;
+        float x = (clip.x * invW * 0.5f + 0.5f) * width;
+        float y = (clip.y * invW * 0.5f + 0.5f) * height;
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        nearest = std::max(nearest, invW);
+    }
+
+    // a pixel of slack around the box: occluders only cover the pixel centers they contain
+    int firstColumn = std::max(0, static_cast<int>(std::floor(minX)) - 1);
+    int lastColumn = std::min(static_cast<int>(width) - 1, static_cast<int>(std::floor(maxX)) + 1);
+    int firstRow = std::max(0, static_cast<int>(std::floor(minY)) - 1);
+    int lastRow = std::min(static_cast<int>(height) - 1, static_cast<int>(std::floor(maxY)) + 1);
+    // off screen is the frustum's call
+    if (firstColumn > lastColumn || firstRow > lastRow)
+        return true;
+
+    const Lanes indices = laneIndices();
+    const Lanes nearestLanes = splat(nearest);
+    const Lanes first = splat(static_cast<float>(firstColumn));
+    const Lanes last = splat(static_cast<float>(lastColumn));
+    int columnBegin = firstColumn / static_cast<int>(LANES) * static_cast<int>(LANES);
+    for (int y = firstRow; y <= lastRow; y++) {
+        const float* pixels = depth.data() + y * stride;
+        for (int x = columnBegin; x <= lastColumn; x += LANES) {
+            if (anyFarther(load(pixels + x), nearestLanes, add(splat(static_cast<float>(x)), indices), first, last))
+                return true;
+        }
+    }
+    stats.culled++;
+    return false;
+}
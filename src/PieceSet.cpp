@@ -0,0 +1,46 @@
+#include "PieceSet.h"
+
+void PieceSet::spawn(IslandGeometry& island, const Model& parent, const Drawer& parentDrawer) {
+    if (pieces.size() >= MAX_PIECES) {
+        release(pieces.front());
+        pieces.erase(pieces.begin());
+    }
+
+    Piece piece;
+    piece.model.reset(new Model());
+    piece.model->directory = parent.directory;
+    piece.model->gammaCorrection = parent.gammaCorrection;
+    piece.model->textures_loaded = parent.textures_loaded;
+    piece.model->nodes = parent.nodes;
+    for (size_t m = 0; m < island.vertices.size() && m < parent.meshes.size(); m++) {
+        if (!island.vertices[m].empty() && !island.indices[m].empty()) {
+            piece.model->meshes.push_back(Mesh(std::move(island.vertices[m]), std::move(island.indices[m]), parent.meshes[m].textures));
+            piece.model->meshes.back().node = parent.meshes[m].node;
+            piece.model->meshes.back().skinned = parent.meshes[m].skinned;
+        }
+    }
+    piece.model->updateBounds();
+
+    // the parent's transform frozen at the moment of the cut
+    piece.drawer.reset(new Drawer(*piece.model, shader));
+    piece.drawer->setPosition(parentDrawer.getPosition());
+    piece.drawer->setScale(parentDrawer.getScale());
+    piece.drawer->setRotation(parentDrawer.getRotation());
+    piece.drawer->setRotationMode(parentDrawer.getRotationMode());
+    piece.drawer->setTarget(parentDrawer.getTarget());
+    // the model's bounds are the island's, so the index gets its world AABB
+    sceneIndex.add(*piece.drawer, SceneIndex::DYNAMIC);
+
+    pieces.push_back(std::move(piece));
+}
+
+void PieceSet::release(Piece& piece) {
+    sceneIndex.remove(*piece.drawer);
+    piece.model->release();
+}
+
+void PieceSet::clear() {
+    for (size_t i = 0; i < pieces.size(); i++)
+        release(pieces[i]);
+    pieces.clear();
+}
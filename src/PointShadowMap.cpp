@@ -0,0 +1,126 @@
+#include "PointShadowMap.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+
+namespace {
+    const float SHADOW_NEAR_PLANE = 0.05f;
+
+    // the cube map face order, +X -X +Y -Y +Z -Z
+    const glm::vec3 FACE_DIRECTIONS[6] = {
+        glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+        glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+        glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+    };
+    const glm::vec3 FACE_UPS[6] = {
+        glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+        glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+        glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)
+    };
+}
+
+PointShadowMap::PointShadowMap(unsigned int resolution)
+    : resolution(resolution), light(-1), position(0.0f), range(0.0f), staticValid(false), staticRenders(0),
+      depthShader("res/shaders/shadow.vert", "res/shaders/shadow_point.frag") {
+    staticCube = createCube();
+    dynamicCube = createCube();
+
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X, staticCube, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::FRAMEBUFFER:: Point shadow framebuffer is not complete!" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+PointShadowMap::~PointShadowMap() {
+    unsigned int cubes[2] = { staticCube, dynamicCube };
+    glDeleteTextures(2, cubes);
+    glDeleteFramebuffers(1, &fbo);
+}
+
+unsigned int PointShadowMap::createCube() {
+    unsigned int cube;
+    glGenTextures(1, &cube);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, cube);
+    for (unsigned int face = 0; face < 6; face++)
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_DEPTH_COMPONENT24, resolution, resolution, 0,
+                     GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    return cube;
+}
+
+void PointShadowMap::setLight(int newLight, const glm::vec3& newPosition, float newRange) {
+    light = newLight;
+    if (newPosition == position && newRange == range)
+        return;
+    position = newPosition;
+    range = newRange;
+    staticValid = false;
+
+    glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, SHADOW_NEAR_PLANE, range);
+    for (int face = 0; face < 6; face++) {
+        faceMatrices[face] = projection * glm::lookAt(position, position + FACE_DIRECTIONS[face], FACE_UPS[face]);
+        faceFrusta[face] = Frustum::fromMatrix(faceMatrices[face]);
+    }
+}
+
+void PointShadowMap::invalidateStatic() {
+    staticValid = false;
+}
+
+void PointShadowMap::renderCube(unsigned int cube, const DrawCasters& drawCasters) {
+    for (int face = 0; face < 6; face++) {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, cube, 0);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        depthShader.use();
+        depthShader.setMat4("lightSpace", faceMatrices[face]);
+        drawCasters(depthShader, faceFrusta[face]);
+    }
+}
+
+void PointShadowMap::render(const DrawCasters& drawStatic, const DrawCasters& drawDynamic) {
+    if (light < 0)
+        return;
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, resolution, resolution);
+    depthShader.use();
+    depthShader.setVec3("lightPos", position);
+    depthShader.setFloat("range", range);
+
+    if (!staticValid) {
+        renderCube(staticCube, drawStatic);
+        staticValid = true;
+        staticRenders++;
+    }
+    renderCube(dynamicCube, drawDynamic);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void PointShadowMap::bind(Shader& shader) const {
+    glActiveTexture(GL_TEXTURE0 + SHADOW_STATIC_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, staticCube);
+    glActiveTexture(GL_TEXTURE0 + SHADOW_DYNAMIC_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, dynamicCube);
+    glActiveTexture(GL_TEXTURE0);
+
+    shader.use();
+    shader.setInt("shadowStatic", SHADOW_STATIC_TEXTURE_UNIT);
+    shader.setInt("shadowDynamic", SHADOW_DYNAMIC_TEXTURE_UNIT);
+    shader.setInt("shadowLight", light);
+    shader.setFloat("shadowRange", range);
+}
+
+void PointShadowMap::bindDisabled(Shader& shader) {
+    shader.use();
+    shader.setInt("shadowStatic", SHADOW_STATIC_TEXTURE_UNIT);
+    shader.setInt("shadowDynamic", SHADOW_DYNAMIC_TEXTURE_UNIT);
+    shader.setInt("shadowLight", -1);
+}
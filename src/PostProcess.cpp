@@ -0,0 +1,184 @@
+#include "PostProcess.h"
+#include <algorithm>
+#include <iostream>
+
+PostProcess::PostProcess(unsigned int width, unsigned int height, unsigned int bloomMips)
+    : width(width), height(height), requestedMips(bloomMips),
+      downsampleShader("res/shaders/postprocess.vert", "res/shaders/bloom_downsample.frag"),
+      upsampleShader("res/shaders/postprocess.vert", "res/shaders/bloom_upsample.frag"),
+      tonemapShader("res/shaders/postprocess.vert", "res/shaders/tonemap.frag") {
+    // core profile needs a VAO bound even though the triangle comes from gl_VertexID
+    glGenVertexArrays(1, &fullscreenVAO);
+    createTargets();
+
+    downsampleShader.use();
+    downsampleShader.setInt("srcTexture", 0);
+    upsampleShader.use();
+    upsampleShader.setInt("srcTexture", 0);
+    tonemapShader.use();
+    tonemapShader.setInt("scene", 0);
+    tonemapShader.setInt("bloom", 1);
+}
+
+PostProcess::~PostProcess() {
+    destroyTargets();
+    glDeleteVertexArrays(1, &fullscreenVAO);
+}
+
+const char* PostProcess::passName(int pass) {
+    switch (pass) {
+        case PASS_PREFILTER: return "bloom prefilter";
+        case PASS_DOWNSAMPLE: return "bloom downsample";
+        case PASS_UPSAMPLE: return "bloom upsample";
+        case PASS_TONEMAP: return "tonemap";
+        default: return "";
+    }
+}
+
+void PostProcess::resize(unsigned int newWidth, unsigned int newHeight) {
+    if (newWidth == 0 || newHeight == 0 || (newWidth == width && newHeight == height))
+        return;
+    width = newWidth;
+    height = newHeight;
+    destroyTargets();
+    createTargets();
+}
+
+void PostProcess::createTargets() {
+    glGenFramebuffers(1, &sceneFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+
+    glGenTextures(1, &sceneColor);
+    glBindTexture(GL_TEXTURE_2D, sceneColor);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_HALF_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sceneColor, 0);
+
+    // same depth format as the G-buffer so the deferred path can blit into it
+    glGenTextures(1, &sceneDepth);
+    glBindTexture(GL_TEXTURE_2D, sceneDepth);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, sceneDepth, 0);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::FRAMEBUFFER:: HDR scene target is not complete!" << std::endl;
+
+    // bloom chain starts at half resolution and halves per mip
+    glGenFramebuffers(1, &bloomFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, bloomFBO);
+    glm::ivec2 size(width, height);
+    for (unsigned int i = 0; i < requestedMips; i++) {
+        size = glm::max(size / 2, glm::ivec2(1));
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R11F_G11F_B10F, size.x, size.y, 0, GL_RGB, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        bloomTextures.push_back(texture);
+        bloomSizes.push_back(size);
+        if (size.x == 1 && size.y == 1)
+            break;
+    }
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, bloomTextures[0], 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::FRAMEBUFFER:: bloom target is not complete!" << std::endl;
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void PostProcess::destroyTargets() {
+    glDeleteTextures(1, &sceneColor);
+    glDeleteTextures(1, &sceneDepth);
+    glDeleteFramebuffers(1, &sceneFBO);
+    glDeleteTextures(static_cast<GLsizei>(bloomTextures.size()), bloomTextures.data());
+    glDeleteFramebuffers(1, &bloomFBO);
+    bloomTextures.clear();
+    bloomSizes.clear();
+}
+
+void PostProcess::drawFullscreen() {
+    glBindVertexArray(fullscreenVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+}
+
+void PostProcess::beginScene() {
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+    glViewport(0, 0, width, height);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void PostProcess::apply(float bloomStrength, float bloomThreshold, float exposure, unsigned int targetFBO) {
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    glDisable(GL_CULL_FACE);
+    glBindFramebuffer(GL_FRAMEBUFFER, bloomFBO);
+    glActiveTexture(GL_TEXTURE0);
+
+    // threshold the scene into the first mip
+    timers[PASS_PREFILTER].begin();
+    downsampleShader.use();
+    downsampleShader.setBool("prefilter", true);
+    downsampleShader.setFloat("threshold", bloomThreshold);
+    downsampleShader.setVec2("srcTexelSize", glm::vec2(1.0f / width, 1.0f / height));
+    glBindTexture(GL_TEXTURE_2D, sceneColor);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, bloomTextures[0], 0);
+    glViewport(0, 0, bloomSizes[0].x, bloomSizes[0].y);
+    drawFullscreen();
+    timers[PASS_PREFILTER].end();
+
+    // progressive downsample
+    timers[PASS_DOWNSAMPLE].begin();
+    downsampleShader.setBool("prefilter", false);
+    for (size_t i = 1; i < bloomTextures.size(); i++) {
+        downsampleShader.setVec2("srcTexelSize", 1.0f / glm::vec2(bloomSizes[i - 1]));
+        glBindTexture(GL_TEXTURE_2D, bloomTextures[i - 1]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, bloomTextures[i], 0);
+        glViewport(0, 0, bloomSizes[i].x, bloomSizes[i].y);
+        drawFullscreen();
+    }
+    timers[PASS_DOWNSAMPLE].end();
+
+    // progressive upsample, each level added onto the next larger one
+    timers[PASS_UPSAMPLE].begin();
+    upsampleShader.use();
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    for (size_t i = bloomTextures.size() - 1; i > 0; i--) {
+        upsampleShader.setVec2("srcTexelSize", 1.0f / glm::vec2(bloomSizes[i]));
+        glBindTexture(GL_TEXTURE_2D, bloomTextures[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, bloomTextures[i - 1], 0);
+        glViewport(0, 0, bloomSizes[i - 1].x, bloomSizes[i - 1].y);
+        drawFullscreen();
+    }
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDisable(GL_BLEND);
+    timers[PASS_UPSAMPLE].end();
+
+    // composite and tonemap
+    timers[PASS_TONEMAP].begin();
+    glBindFramebuffer(GL_FRAMEBUFFER, targetFBO);
+    glViewport(0, 0, width, height);
+    tonemapShader.use();
+    tonemapShader.setFloat("bloomStrength", bloomStrength / bloomTextures.size());
+    tonemapShader.setFloat("exposure", exposure);
+    glBindTexture(GL_TEXTURE_2D, sceneColor);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, bloomTextures[0]);
+    glActiveTexture(GL_TEXTURE0);
+    drawFullscreen();
+    timers[PASS_TONEMAP].end();
+
+    glEnable(GL_BLEND);
+    glEnable(GL_CULL_FACE);
+    glEnable(GL_DEPTH_TEST);
+}
@@ -0,0 +1,139 @@
+#include "Profiler.h"
+#include "imgui.h"
+#include "FrameAllocator.h"
+
+Profiler::Frame Profiler::frames[Profiler::FRAMES_IN_FLIGHT];
+int Profiler::currentFrame = 0;
+bool Profiler::inFrame = false;
+std::vector<GLuint64> Profiler::timestamps;
+std::vector<int> Profiler::stack;
+std::vector<Profiler::Result> Profiler::results;
+Profiler::Clock::time_point Profiler::lastFrameStart;
+float Profiler::cpuHistory[Profiler::HISTORY_SIZE] = {};
+float Profiler::gpuHistory[Profiler::HISTORY_SIZE] = {};
+int Profiler::historyOffset = 0;
+
+unsigned int Profiler::nextQuery(Frame& frame) {
+    if (frame.queriesUsed == frame.queries.size()) {
+        unsigned int query;
+        glGenQueries(1, &query);
+        frame.queries.push_back(query);
+    }
+    return frame.queriesUsed++;
+}
+
+void Profiler::resolve(Frame& frame) {
+    results.clear();
+    if (!frame.recorded)
+        return;
+
+    // the frame is two behind, so this normally returns without waiting
+    timestamps.resize(frame.queriesUsed);
+    for (unsigned int i = 0; i < frame.queriesUsed; i++)
+        glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &timestamps[i]);
+
+    for (size_t i = 0; i < frame.scopes.size(); i++) {
+        const Scope& scope = frame.scopes[i];
+        Result result;
+        result.name = scope.name;
+        result.depth = scope.depth;
+        result.cpuMilliseconds = std::chrono::duration<double, std::milli>(scope.cpuEnd - scope.cpuBegin).count();
+        result.gpuMilliseconds = (timestamps[scope.gpuEnd] - timestamps[scope.gpuBegin]) / 1.0e6;
+        results.push_back(result);
+    }
+    // the root scope is the whole frame
+    if (!results.empty())
+        gpuHistory[frame.historySlot] = static_cast<float>(results[0].gpuMilliseconds);
+}
+
+void Profiler::beginFrame() {
+    Clock::time_point now = Clock::now();
+    if (lastFrameStart != Clock::time_point()) {
+        historyOffset = (historyOffset + 1) % HISTORY_SIZE;
+        cpuHistory[historyOffset] = std::chrono::duration<float, std::milli>(now - lastFrameStart).count();
+    }
+    lastFrameStart = now;
+
+    currentFrame = (currentFrame + 1) % FRAMES_IN_FLIGHT;
+    Frame& frame = frames[currentFrame];
+    resolve(frame);
+
+    frame.scopes.clear();
+    frame.queriesUsed = 0;
+    frame.recorded = false;
+    frame.historySlot = historyOffset;
+    stack.clear();
+    inFrame = true;
+    beginScope("frame");
+}
+
+void Profiler::endFrame() {
+    endScope();
+    inFrame = false;
+    frames[currentFrame].recorded = true;
+}
+
+void Profiler::beginScope(const char* name) {
+    if (!inFrame)
+        return;
+    Frame& frame = frames[currentFrame];
+    Scope scope;
+    scope.name = name;
+    scope.depth = static_cast<int>(stack.size());
+    scope.gpuBegin = nextQuery(frame);
+    scope.gpuEnd = 0;
+    glQueryCounter(frame.queries[scope.gpuBegin], GL_TIMESTAMP);
+    scope.cpuBegin = Clock::now();
+
+    stack.push_back(static_cast<int>(frame.scopes.size()));
+    frame.scopes.push_back(scope);
+}
+
+void Profiler::endScope() {
+    if (!inFrame || stack.empty())
+        return;
+    Frame& frame = frames[currentFrame];
+    Scope& scope = frame.scopes[stack.back()];
+    stack.pop_back();
+
+    scope.cpuEnd = Clock::now();
+    scope.gpuEnd = nextQuery(frame);
+    glQueryCounter(frame.queries[scope.gpuEnd], GL_TIMESTAMP);
+}
+
+void Profiler::drawWindow() {
+    ImGui::SetNextWindowSize(ImVec2(420, 360), ImGuiCond_FirstUseEver);
+    if (!ImGui::Begin("Profiler")) {
+        ImGui::End();
+        return;
+    }
+
+    float frameMs = cpuHistory[historyOffset];
+    ImGui::Text("%.2f ms/frame (%.0f FPS)", frameMs, frameMs > 0.0f ? 1000.0f / frameMs : 0.0f);
+    ImGui::Text("%llu heap allocations last frame, %.1f KB frame arena",
+                static_cast<unsigned long long>(FrameAllocator::getLastFrameHeapAllocations()),
+                FrameAllocator::getUsedBytes() / 1024.0);
+    ImGui::PlotLines("CPU frame", cpuHistory, HISTORY_SIZE, (historyOffset + 1) % HISTORY_SIZE,
+                     NULL, 0.0f, 33.3f, ImVec2(0, 60));
+    ImGui::PlotLines("GPU frame", gpuHistory, HISTORY_SIZE, (historyOffset + 1) % HISTORY_SIZE,
+                     NULL, 0.0f, 33.3f, ImVec2(0, 60));
+
+    if (ImGui::BeginTable("scopes", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+        ImGui::TableSetupColumn("Scope");
+        ImGui::TableSetupColumn("CPU ms");
+        ImGui::TableSetupColumn("GPU ms");
+        ImGui::TableHeadersRow();
+        for (size_t i = 0; i < results.size(); i++) {
+            const Result& result = results[i];
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0);
+            ImGui::Text("%*s%s", result.depth * 2, "", result.name);
+            ImGui::TableSetColumnIndex(1);
+            ImGui::Text("%.3f", result.cpuMilliseconds);
+            ImGui::TableSetColumnIndex(2);
+            ImGui::Text("%.3f", result.gpuMilliseconds);
+        }
+        ImGui::EndTable();
+    }
+    ImGui::End();
+}
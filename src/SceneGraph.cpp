@@ -0,0 +1,73 @@
+#include "SceneGraph.h"
+
+#include <algorithm>
+
+const int SceneGraph::NO_PARENT;
+const unsigned int SceneGraph::NO_NODE;
+const size_t SceneGraph::NOTHING_DIRTY;
+
+unsigned int SceneGraph::addNode(int parent, const std::string& name, const glm::mat4& local) {
+    unsigned int node = static_cast<unsigned int>(parents.size());
+    parents.push_back(parent < static_cast<int>(node) ? parent : NO_PARENT);
+    names.push_back(name);
+    locals.push_back(local);
+    worlds.push_back(glm::mat4(1.0f));
+    worldNormals.push_back(glm::mat3(1.0f));
+    identity.push_back(1);
+    dirty.push_back(1);
+    firstDirty = std::min(firstDirty, static_cast<size_t>(node));
+    return node;
+}
+
+void SceneGraph::clear() {
+    parents.clear();
+    names.clear();
+    locals.clear();
+    worlds.clear();
+    worldNormals.clear();
+    identity.clear();
+    dirty.clear();
+    firstDirty = NOTHING_DIRTY;
+    offsetNodes = 0;
+}
+
+int SceneGraph::find(const std::string& name) const {
+    for (size_t i = 0; i < names.size(); i++) {
+        if (names[i] == name)
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+void SceneGraph::setLocal(unsigned int node, const glm::mat4& local) {
+    locals[node] = local;
+    dirty[node] = 1;
+    firstDirty = std::min(firstDirty, static_cast<size_t>(node));
+}
+
+size_t SceneGraph::update() {
+    if (firstDirty == NOTHING_DIRTY)
+        return 0;
+
+    // parents precede their children, so a dirty flag reaches the whole
+    // subtree within this one pass
+    size_t rebuilt = 0;
+    const glm::mat4 one(1.0f);
+    for (size_t i = firstDirty; i < parents.size(); i++) {
+        int parent = parents[i];
+        if (parent != NO_PARENT && dirty[parent])
+            dirty[i] = 1;
+        if (!dirty[i])
+            continue;
+        worlds[i] = parent != NO_PARENT ? worlds[parent] * locals[i] : locals[i];
+        unsigned char wasIdentity = identity[i];
+        identity[i] = worlds[i] == one;
+        if (identity[i] != wasIdentity)
+            offsetNodes += identity[i] ? size_t(-1) : 1;
+        worldNormals[i] = identity[i] ? glm::mat3(1.0f) : glm::transpose(glm::inverse(glm::mat3(worlds[i])));
+        rebuilt++;
+    }
+    std::fill(dirty.begin() + firstDirty, dirty.end(), 0);
+    firstDirty = NOTHING_DIRTY;
+    return rebuilt;
+}
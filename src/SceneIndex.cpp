@@ -0,0 +1,99 @@
+#include "SceneIndex.h"
+#include "Trace.h"
+
+namespace {
+    const uint32_t NO_ENTRY = 0xffffffffu;
+}
+
+void SceneIndex::add(Drawer& drawer, uint32_t layer) {
+    TransformHandle transform = drawer.getTransform();
+    if (transform >= entryOfTransform.size())
+        entryOfTransform.resize(transform + 1, NO_ENTRY);
+    if (entryOfTransform[transform] != NO_ENTRY)
+        return;
+
+    uint32_t slot;
+    if (!freeEntries.empty()) {
+        slot = freeEntries.back();
+        freeEntries.pop_back();
+    } else {
+        slot = static_cast<uint32_t>(entries.size());
+        entries.push_back(Entry());
+    }
+    glm::vec3 boundsMin, boundsMax;
+    drawer.getWorldBounds(boundsMin, boundsMax);
+    Entry& entry = entries[slot];
+    entry.drawer = &drawer;
+    entry.layer = layer;
+    entry.handle = index.insert(boundsMin, boundsMax, slot);
+    entry.center = (boundsMin + boundsMax) * 0.5f;
+    entryOfTransform[transform] = slot;
+}
+
+void SceneIndex::remove(Drawer& drawer) {
+    TransformHandle transform = drawer.getTransform();
+    if (transform >= entryOfTransform.size() || entryOfTransform[transform] == NO_ENTRY)
+        return;
+    uint32_t slot = entryOfTransform[transform];
+    index.remove(entries[slot].handle);
+    entries[slot].drawer = nullptr;
+    freeEntries.push_back(slot);
+    entryOfTransform[transform] = NO_ENTRY;
+}
+
+void SceneIndex::move(uint32_t slot) {
+    Entry& entry = entries[slot];
+    glm::vec3 boundsMin, boundsMax;
+    entry.drawer->getWorldBounds(boundsMin, boundsMax);
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    index.move(entry.handle, boundsMin, boundsMax, center - entry.center);
+    entry.center = center;
+}
+
+void SceneIndex::update() {
+    TRACE_SCOPE("scene index");
+    FrameVector<TransformHandle> moved;
+    TransformSystem::takeMoved(moved);
+    for (size_t i = 0; i < moved.size(); i++) {
+        if (moved[i] < entryOfTransform.size() && entryOfTransform[moved[i]] != NO_ENTRY)
+            move(entryOfTransform[moved[i]]);
+    }
+}
+
+void SceneIndex::refresh(Drawer& drawer) {
+    TransformHandle transform = drawer.getTransform();
+    if (transform < entryOfTransform.size() && entryOfTransform[transform] != NO_ENTRY)
+        move(entryOfTransform[transform]);
+}
+
+void SceneIndex::queryFrustum(const Frustum& frustum, uint32_t layers, FrameVector<Drawer*>& drawers) const {
+    FrameVector<uint32_t> slots;
+    index.queryFrustum(frustum, slots);
+    drawers.clear();
+    drawers.reserve(slots.size());
+    for (size_t i = 0; i < slots.size(); i++) {
+        const Entry& entry = entries[slots[i]];
+        if (entry.layer & layers)
+            drawers.push_back(entry.drawer);
+    }
+}
+
+void SceneIndex::queryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, uint32_t layers,
+                          FrameVector<Drawer*>& drawers) const {
+    FrameVector<SpatialHit> hits;
+    index.queryRay(origin, direction, maxDistance, hits);
+    drawers.clear();
+    drawers.reserve(hits.size());
+    for (size_t i = 0; i < hits.size(); i++) {
+        const Entry& entry = entries[hits[i].value];
+        if (entry.layer & layers)
+            drawers.push_back(entry.drawer);
+    }
+}
+
+uint32_t SceneIndex::getLayer(const Drawer& drawer) const {
+    TransformHandle transform = drawer.getTransform();
+    if (transform >= entryOfTransform.size() || entryOfTransform[transform] == NO_ENTRY)
+        return 0;
+    return entries[entryOfTransform[transform]].layer;
+}
@@ -1,13 +1,23 @@
 #include "Setup.h"
 #include "InputManager.h"
 
-GLFWwindow* Setup::initializeWindow(unsigned int SCR_WIDTH, unsigned int SCR_HEIGHT, Camera& camera) {
+GLFWwindow* Setup::initializeWindow(unsigned int SCR_WIDTH, unsigned int SCR_HEIGHT, Camera& camera, bool visible,
+                                    bool preferGL43) {
     glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
 
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+    GLFWwindow* window = NULL;
+    if (preferGL43) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+    }
+    if (window == NULL) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+    }
     if (window == NULL) {
         std::cout << "Failed to create GLFW window" << std::endl;
         glfwTerminate();
@@ -24,7 +34,8 @@ GLFWwindow* Setup::initializeWindow(unsigned int SCR_WIDTH, unsigned int SCR_HEI
     glfwSetKeyCallback(window, InputManager::key_callback);
     
     // Capture mouse
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    if (visible)
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
     return window;
 }
@@ -56,8 +67,8 @@ void Setup::setupOpenGLState() {
 }
 
 void Setup::cleanup() {
-    glfwTerminate();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
+    glfwTerminate();
 } 
\ No newline at end of file
@@ -0,0 +1,145 @@
+#include "Simulation.h"
+#include "Trace.h"
+
+namespace {
+    // simulated seconds between slice checks while the laser is on
+    const double SLICE_CHECK_INTERVAL = 0.1;
+
+    InputFrame emptyFrame(uint32_t keys) {
+        InputFrame frame;
+        frame.keys = keys;
+        frame.mouseX = frame.mouseY = frame.scroll = frame.deltaTime = 0.0f;
+        return frame;
+    }
+}
+
+Simulation::Simulation(const Camera& startCamera, float laserDuration, float stepSeconds, bool threaded)
+    : camera(startCamera), laserTimer(0.0f), laserDuration(laserDuration), step(stepSeconds),
+      time(0.0), lastSliceCheck(-SLICE_CHECK_INTERVAL), accumulator(0.0f), latestKeys(0), threaded(threaded), quit(false) {
+    pending = emptyFrame(0);
+    current = previous = capture();
+    currentWallTime = Clock::now();
+    if (threaded)
+        thread = std::thread(&Simulation::threadLoop, this);
+}
+
+Simulation::~Simulation() {
+    if (thread.joinable()) {
+        quit.store(true);
+        thread.join();
+    }
+}
+
+void Simulation::submitInput(const InputFrame& frame) {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.merge(frame);
+    latestKeys = frame.keys;
+}
+
+void Simulation::update(float frameTime) {
+    if (threaded)
+        return;
+    accumulator += frameTime;
+    int steps = 0;
+    while (accumulator >= step && steps < MAX_STEPS) {
+        runStep();
+        accumulator -= step;
+        steps++;
+    }
+    // too far behind: drop the backlog instead of paying for it next frame
+    if (steps == MAX_STEPS && accumulator >= step)
+        accumulator = 0.0f;
+}
+
+SimState Simulation::capture() const {
+    SimState state;
+    state.cameraPosition = camera.Position;
+    state.yaw = camera.Yaw;
+    state.pitch = camera.Pitch;
+    state.zoom = camera.Zoom;
+    state.laserTimer = laserTimer;
+    return state;
+}
+
+void Simulation::runStep() {
+    TRACE_SCOPE("simulation step");
+    InputFrame frame;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        frame = pending;
+        // held keys carry over to the next step, motion is consumed once
+        pending = emptyFrame(latestKeys);
+    }
+
+    applyMotion(frame, step, camera, laserTimer, laserDuration);
+
+    bool slice = false;
+    SliceRequest request;
+    if (laserTimer > 0.0f) {
+        laserTimer -= step;
+        if (time - lastSliceCheck >= SLICE_CHECK_INTERVAL) {
+            lastSliceCheck = time;
+            // same ray the laser is drawn along
+            request.start = camera.Position + camera.Front * 2.0f - glm::vec3(0.0f, 0.5f, 0.0f);
+            glm::vec3 target = camera.Position + camera.Front * 50.0f - glm::vec3(0.0f, 0.5f, 0.0f);
+            request.direction = glm::normalize(target - request.start);
+            slice = true;
+        }
+    }
+
+    SimState state = capture();
+    std::lock_guard<std::mutex> lock(mutex);
+    time += step;
+    previous = current;
+    current = state;
+    currentWallTime = Clock::now();
+    if (slice)
+        sliceRequests.push_back(request);
+}
+
+void Simulation::threadLoop() {
+    TRACE_THREAD_NAME("simulation");
+    Clock::duration stepDuration = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(step));
+    Clock::time_point next = Clock::now();
+    while (!quit.load()) {
+        runStep();
+        next += stepDuration;
+        Clock::time_point now = Clock::now();
+        if (now - next > stepDuration * MAX_STEPS)
+            next = now;
+        std::this_thread::sleep_until(next);
+    }
+}
+
+SimState Simulation::interpolated(Camera& renderCamera) {
+    std::lock_guard<std::mutex> lock(mutex);
+    float alpha;
+    if (threaded)
+        alpha = std::chrono::duration<float>(Clock::now() - currentWallTime).count() / step;
+    else
+        alpha = accumulator / step;
+    alpha = glm::clamp(alpha, 0.0f, 1.0f);
+
+    SimState state;
+    state.cameraPosition = glm::mix(previous.cameraPosition, current.cameraPosition, alpha);
+    state.yaw = glm::mix(previous.yaw, current.yaw, alpha);
+    state.pitch = glm::mix(previous.pitch, current.pitch, alpha);
+    state.zoom = glm::mix(previous.zoom, current.zoom, alpha);
+    state.laserTimer = current.laserTimer;
+
+    renderCamera.Position = state.cameraPosition;
+    renderCamera.Zoom = state.zoom;
+    renderCamera.setOrientation(state.yaw, state.pitch);
+    return state;
+}
+
+void Simulation::takeSliceRequests(FrameVector<SliceRequest>& requests) {
+    std::lock_guard<std::mutex> lock(mutex);
+    requests.insert(requests.end(), sliceRequests.begin(), sliceRequests.end());
+    sliceRequests.clear();
+}
+
+double Simulation::getTime() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return time;
+}
@@ -0,0 +1,85 @@
+#include "SliceWorker.h"
+#include "FrameAllocator.h"
+#include "Trace.h"
+
+SliceWorker::SliceWorker(Drawer& drawer, PieceSet& pieces)
+    : drawer(drawer), model(drawer.getModel()), pieces(pieces), islandCount(0), busy(false), fixedLatency(0),
+      frame(0), readyFrame(0) {
+    job.function = sliceJob;
+    job.data = this;
+    job.begin = 0;
+    job.end = 0;
+    job.counter = nullptr;
+}
+
+SliceWorker::~SliceWorker() {
+    if (busy) {
+        JobSystem::wait(counter);
+        FrameAllocator::release();
+    }
+}
+
+void SliceWorker::submit(const SliceCylinder& cut) {
+    pending.push_back(cut);
+}
+
+bool SliceWorker::update() {
+    bool changed = false;
+    frame++;
+    bool ready = fixedLatency > 0 ? frame >= readyFrame : counter.pending.load(std::memory_order_acquire) == 0;
+    if (busy && ready) {
+        if (fixedLatency > 0)
+            JobSystem::wait(counter);
+        // the job only read the meshes, so swapping them here cannot race it
+        if (islandCount <= 1) {
+            model.replaceGeometry(slicedVertices, slicedIndices);
+        } else if (islands.empty()) {
+            // nothing but debris left
+            for (size_t m = 0; m < slicedVertices.size(); m++)
+                slicedVertices[m].clear();
+            model.replaceGeometry(slicedVertices, slicedIndices);
+        } else {
+            size_t largest = 0;
+            for (size_t i = 1; i < islands.size(); i++) {
+                if (islands[i].triangles > islands[largest].triangles)
+                    largest = i;
+            }
+            // spawned first, they index the meshes before replaceGeometry drops empty ones
+            for (size_t i = 0; i < islands.size(); i++) {
+                if (i != largest)
+                    pieces.spawn(islands[i], model, drawer);
+            }
+            model.replaceGeometry(islands[largest].vertices, islands[largest].indices);
+        }
+        islands.clear();
+        slicedVertices.clear();
+        slicedIndices.clear();
+        running.clear();
+        FrameAllocator::release();
+        busy = false;
+        changed = true;
+    }
+
+    if (!busy && !pending.empty()) {
+        running.swap(pending);
+        // the job must not read the scene graph while the GL thread animates it
+        model.getMeshTransforms(meshTransforms);
+        busy = true;
+        readyFrame = frame + fixedLatency;
+        FrameAllocator::hold();
+        // off the main thread's deque, or any wait later in the frame could run the whole
+        // batch inline; without workers it runs right here
+        JobSystem::runInBackground(&job, 1, counter);
+    }
+    return changed;
+}
+
+void SliceWorker::sliceJob(void* data, size_t, size_t) {
+    SliceWorker* worker = static_cast<SliceWorker*>(data);
+    TRACE_SCOPE("slice batch");
+    const glm::mat4* meshTransforms = worker->meshTransforms.empty() ? nullptr : worker->meshTransforms.data();
+    worker->model.sliceGeometry(worker->running.data(), worker->running.size(), worker->slicedVertices, worker->slicedIndices,
+                                meshTransforms);
+    worker->islandCount = IslandFinder::split(worker->slicedVertices, worker->slicedIndices,
+                                              MIN_ISLAND_TRIANGLES, worker->islands, meshTransforms);
+}
@@ -0,0 +1,498 @@
+#include "SpatialIndex.h"
+#include "FrameAllocator.h"
+
+#include <algorithm>
+
+namespace {
+    // traversals keep this many entries on the stack before spilling to the
+    // heap; a balanced tree needs one per level
+    const size_t STACK_SIZE = 128;
+    // how many calls' worth of displacement a reinserted loose box reaches ahead
+    const float PREDICTED_MOVES = 4.0f;
+
+    template <typename T>
+    class TraversalStack {
+    public:
+        TraversalStack() : size(0) {}
+        bool empty() const { return size == 0; }
+        void push(const T& entry) {
+            if (size < STACK_SIZE)
+                items[size] = entry;
+            else
+                overflow.push_back(entry);
+            size++;
+        }
+        T pop() {
+            size--;
+            if (size < STACK_SIZE)
+                return items[size];
+            T entry = overflow.back();
+            overflow.pop_back();
+            return entry;
+        }
+
+    private:
+        T items[STACK_SIZE];
+        size_t size;
+        std::vector<T> overflow;
+    };
+
+    // a node and the frusta or rays it still has to be tested against; for
+    // frusta, insideMask holds those that contain it whole
+    struct MaskedEntry {
+        int node;
+        uint32_t testMask;
+        uint32_t insideMask;
+    };
+
+    // half the surface area, what insertion minimizes
+    float area(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+        glm::vec3 size = boundsMax - boundsMin;
+        return size.x * size.y + size.y * size.z + size.z * size.x;
+    }
+
+    bool boxesOverlap(const glm::vec3& minA, const glm::vec3& maxA, const glm::vec3& minB, const glm::vec3& maxB) {
+        return minA.x <= maxB.x && minB.x <= maxA.x && minA.y <= maxB.y && minB.y <= maxA.y &&
+               minA.z <= maxB.z && minB.z <= maxA.z;
+    }
+
+    bool sphereOverlaps(const glm::vec3& center, float radiusSquared, const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+        glm::vec3 offset = center - glm::clamp(center, boundsMin, boundsMax);
+        return glm::dot(offset, offset) <= radiusSquared;
+    }
+
+    enum class Containment { OUTSIDE, INTERSECTING, INSIDE };
+
+    // as Frustum::intersectsBox, also telling a box wholly inside apart
+    Containment classify(const Frustum& frustum, const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+        glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+        glm::vec3 extent = (boundsMax - boundsMin) * 0.5f;
+        Containment result = Containment::INSIDE;
+        for (int i = 0; i < 6; i++) {
+            const glm::vec4& plane = frustum.planes[i];
+            float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+            float radius = glm::dot(glm::abs(glm::vec3(plane)), extent);
+            if (distance + radius < 0.0f)
+                return Containment::OUTSIDE;
+            if (distance - radius < 0.0f)
+                result = Containment::INTERSECTING;
+        }
+        return result;
+    }
+
+    // slab test; enter is where the ray comes into the box, clamped to its origin
+    bool rayHitsBox(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance,
+                    const glm::vec3& boundsMin, const glm::vec3& boundsMax, float& enter) {
+        glm::vec3 t0 = (boundsMin - origin) * inverseDirection;
+        glm::vec3 t1 = (boundsMax - origin) * inverseDirection;
+        glm::vec3 lower = glm::min(t0, t1);
+        glm::vec3 upper = glm::max(t0, t1);
+        enter = std::max(std::max(lower.x, lower.y), std::max(lower.z, 0.0f));
+        float exit = std::min(std::min(upper.x, upper.y), std::min(upper.z, maxDistance));
+        return enter <= exit;
+    }
+
+    glm::vec3 inverse(const glm::vec3& direction) {
+        return glm::vec3(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+    }
+}
+
+SpatialIndex::SpatialIndex(float margin)
+    : margin(margin), root(NO_NODE), freeList(NO_NODE), count(0) {
+}
+
+int SpatialIndex::allocateNode() {
+    int node;
+    if (freeList != NO_NODE) {
+        node = freeList;
+        freeList = nodes[node].parent;
+    } else {
+        node = static_cast<int>(nodes.size());
+        nodes.push_back(Node());
+    }
+    Node& n = nodes[node];
+    n.parent = n.child1 = n.child2 = NO_NODE;
+    n.height = 0;
+    n.value = 0;
+    return node;
+}
+
+void SpatialIndex::freeNode(int node) {
+    nodes[node].parent = freeList;
+    nodes[node].height = -1;
+    freeList = node;
+}
+
+SpatialHandle SpatialIndex::insert(const glm::vec3& boundsMin, const glm::vec3& boundsMax, uint32_t value) {
+    int leaf = allocateNode();
+    nodes[leaf].boundsMin = boundsMin - glm::vec3(margin);
+    nodes[leaf].boundsMax = boundsMax + glm::vec3(margin);
+    nodes[leaf].value = value;
+    insertLeaf(leaf);
+    count++;
+    return static_cast<SpatialHandle>(leaf);
+}
+
+void SpatialIndex::remove(SpatialHandle handle) {
+    int leaf = static_cast<int>(handle);
+    removeLeaf(leaf);
+    freeNode(leaf);
+    count--;
+}
+
+bool SpatialIndex::move(SpatialHandle handle, const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+                        const glm::vec3& displacement) {
+    int leaf = static_cast<int>(handle);
+    Node& node = nodes[leaf];
+    if (glm::all(glm::greaterThanEqual(boundsMin, node.boundsMin)) &&
+        glm::all(glm::lessThanEqual(boundsMax, node.boundsMax)))
+        return false;
+    removeLeaf(leaf);
+    glm::vec3 ahead = displacement * PREDICTED_MOVES;
+    nodes[leaf].boundsMin = boundsMin - glm::vec3(margin) + glm::min(ahead, glm::vec3(0.0f));
+    nodes[leaf].boundsMax = boundsMax + glm::vec3(margin) + glm::max(ahead, glm::vec3(0.0f));
+    insertLeaf(leaf);
+    return true;
+}
+
+void SpatialIndex::clear() {
+    nodes.clear();
+    root = freeList = NO_NODE;
+    count = 0;
+}
+
+void SpatialIndex::getLooseBounds(SpatialHandle handle, glm::vec3& boundsMin, glm::vec3& boundsMax) const {
+    boundsMin = nodes[handle].boundsMin;
+    boundsMax = nodes[handle].boundsMax;
+}
+
+int SpatialIndex::getHeight() const {
+    return root != NO_NODE ? nodes[root].height : 0;
+}
+
+void SpatialIndex::insertLeaf(int leaf) {
+    if (root == NO_NODE) {
+        root = leaf;
+        nodes[leaf].parent = NO_NODE;
+        return;
+    }
+
+    // walks down towards the sibling whose box grows least, stopping where
+    // pairing with the current node is cheaper than going further
+    glm::vec3 leafMin = nodes[leaf].boundsMin, leafMax = nodes[leaf].boundsMax;
+    int index = root;
+    while (!nodes[index].isLeaf()) {
+        const Node& node = nodes[index];
+        float nodeArea = area(node.boundsMin, node.boundsMax);
+        float combinedArea = area(glm::min(node.boundsMin, leafMin), glm::max(node.boundsMax, leafMax));
+        // a new parent here, and the growth every ancestor below would see
+        float cost = 2.0f * combinedArea;
+        float inheritance = 2.0f * (combinedArea - nodeArea);
+
+        float childCost[2];
+        int children[2] = { node.child1, node.child2 };
+        for (int c = 0; c < 2; c++) {
+            const Node& child = nodes[children[c]];
+            float grown = area(glm::min(child.boundsMin, leafMin), glm::max(child.boundsMax, leafMax));
+            childCost[c] = (child.isLeaf() ? grown : grown - area(child.boundsMin, child.boundsMax)) + inheritance;
+        }
+        if (cost < childCost[0] && cost < childCost[1])
+            break;
+        index = childCost[0] < childCost[1] ? children[0] : children[1];
+    }
+
+    int sibling = index;
+    int oldParent = nodes[sibling].parent;
+    int newParent = allocateNode();
+    Node& parent = nodes[newParent];
+    parent.parent = oldParent;
+    parent.boundsMin = glm::min(nodes[sibling].boundsMin, leafMin);
+    parent.boundsMax = glm::max(nodes[sibling].boundsMax, leafMax);
+    parent.height = nodes[sibling].height + 1;
+    parent.child1 = sibling;
+    parent.child2 = leaf;
+    if (oldParent != NO_NODE) {
+        if (nodes[oldParent].child1 == sibling)
+            nodes[oldParent].child1 = newParent;
+        else
+            nodes[oldParent].child2 = newParent;
+    } else {
+        root = newParent;
+    }
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+
+    refitFrom(oldParent);
+}
+
+void SpatialIndex::removeLeaf(int leaf) {
+    if (leaf == root) {
+        root = NO_NODE;
+        return;
+    }
+
+    int parent = nodes[leaf].parent;
+    int grandParent = nodes[parent].parent;
+    int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+    freeNode(parent);
+    if (grandParent == NO_NODE) {
+        root = sibling;
+        nodes[sibling].parent = NO_NODE;
+        return;
+    }
+    // the sibling takes the parent's place
+    if (nodes[grandParent].child1 == parent)
+        nodes[grandParent].child1 = sibling;
+    else
+        nodes[grandParent].child2 = sibling;
+    nodes[sibling].parent = grandParent;
+    refitFrom(grandParent);
+}
+
+void SpatialIndex::refitFrom(int node) {
+    while (node != NO_NODE) {
+        node = balance(node);
+        Node& n = nodes[node];
+        const Node& child1 = nodes[n.child1];
+        const Node& child2 = nodes[n.child2];
+        n.boundsMin = glm::min(child1.boundsMin, child2.boundsMin);
+        n.boundsMax = glm::max(child1.boundsMax, child2.boundsMax);
+        n.height = 1 + std::max(child1.height, child2.height);
+        node = n.parent;
+    }
+}
+
+int SpatialIndex::balance(int a) {
+    Node& nodeA = nodes[a];
+    if (nodeA.isLeaf() || nodeA.height < 2)
+        return a;
+
+    int b = nodeA.child1;
+    int c = nodeA.child2;
+    int difference = nodes[c].height - nodes[b].height;
+    if (difference >= -1 && difference <= 1)
+        return a;
+
+    // the taller child rises into a's place, a keeps the other child and the
+    // shorter of the riser's children, the riser keeps its taller one
+    bool leftUp = difference < -1;
+    int up = leftUp ? b : c;
+    int stay = leftUp ? c : b;
+    Node& nodeUp = nodes[up];
+    int f = nodeUp.child1;
+    int g = nodeUp.child2;
+    int taller = nodes[f].height > nodes[g].height ? f : g;
+    int shorter = taller == f ? g : f;
+
+    nodeUp.child1 = a;
+    nodeUp.child2 = taller;
+    nodeUp.parent = nodeA.parent;
+    nodeA.parent = up;
+    if (nodeUp.parent != NO_NODE) {
+        if (nodes[nodeUp.parent].child1 == a)
+            nodes[nodeUp.parent].child1 = up;
+        else
+            nodes[nodeUp.parent].child2 = up;
+    } else {
+        root = up;
+    }
+
+    if (leftUp)
+        nodeA.child1 = shorter;
+    else
+        nodeA.child2 = shorter;
+    nodes[shorter].parent = a;
+
+    nodeA.boundsMin = glm::min(nodes[stay].boundsMin, nodes[shorter].boundsMin);
+    nodeA.boundsMax = glm::max(nodes[stay].boundsMax, nodes[shorter].boundsMax);
+    nodeA.height = 1 + std::max(nodes[stay].height, nodes[shorter].height);
+    nodeUp.boundsMin = glm::min(nodeA.boundsMin, nodes[taller].boundsMin);
+    nodeUp.boundsMax = glm::max(nodeA.boundsMax, nodes[taller].boundsMax);
+    nodeUp.height = 1 + std::max(nodeA.height, nodes[taller].height);
+    return up;
+}
+
+template <typename Allocator>
+void SpatialIndex::queryBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+                            std::vector<uint32_t, Allocator>& values) const {
+    values.clear();
+    if (root == NO_NODE)
+        return;
+    TraversalStack<int> stack;
+    stack.push(root);
+    while (!stack.empty()) {
+        const Node& node = nodes[stack.pop()];
+        if (!boxesOverlap(node.boundsMin, node.boundsMax, boundsMin, boundsMax))
+            continue;
+        if (node.isLeaf()) {
+            values.push_back(node.value);
+        } else {
+            stack.push(node.child1);
+            stack.push(node.child2);
+        }
+    }
+}
+
+template <typename Allocator>
+void SpatialIndex::querySphere(const glm::vec3& center, float radius, std::vector<uint32_t, Allocator>& values) const {
+    values.clear();
+    if (root == NO_NODE)
+        return;
+    float radiusSquared = radius * radius;
+    TraversalStack<int> stack;
+    stack.push(root);
+    while (!stack.empty()) {
+        const Node& node = nodes[stack.pop()];
+        if (!sphereOverlaps(center, radiusSquared, node.boundsMin, node.boundsMax))
+            continue;
+        if (node.isLeaf()) {
+            values.push_back(node.value);
+        } else {
+            stack.push(node.child1);
+            stack.push(node.child2);
+        }
+    }
+}
+
+template <typename Allocator>
+void SpatialIndex::queryFrustum(const Frustum& frustum, std::vector<uint32_t, Allocator>& values) const {
+    values.clear();
+    if (root == NO_NODE)
+        return;
+    // testMask is 0 below a node wholly inside, everything there is reported untested
+    TraversalStack<MaskedEntry> stack;
+    MaskedEntry first = { root, 1u, 0u };
+    stack.push(first);
+    while (!stack.empty()) {
+        MaskedEntry entry = stack.pop();
+        const Node& node = nodes[entry.node];
+        if (entry.testMask != 0) {
+            Containment containment = classify(frustum, node.boundsMin, node.boundsMax);
+            if (containment == Containment::OUTSIDE)
+                continue;
+            if (containment == Containment::INSIDE)
+                entry.testMask = 0;
+        }
+        if (node.isLeaf()) {
+            values.push_back(node.value);
+        } else {
+            MaskedEntry child1 = { node.child1, entry.testMask, 0u };
+            MaskedEntry child2 = { node.child2, entry.testMask, 0u };
+            stack.push(child1);
+            stack.push(child2);
+        }
+    }
+}
+
+void SpatialIndex::queryFrusta(const Frustum* frusta, unsigned int frustumCount, std::vector<uint32_t>& values,
+                               std::vector<uint32_t>& masks) const {
+    values.clear();
+    masks.clear();
+    if (root == NO_NODE || frustumCount == 0)
+        return;
+    frustumCount = std::min(frustumCount, 32u);
+    TraversalStack<MaskedEntry> stack;
+    MaskedEntry first = { root, frustumCount == 32 ? 0xffffffffu : (1u << frustumCount) - 1u, 0u };
+    stack.push(first);
+    while (!stack.empty()) {
+        MaskedEntry entry = stack.pop();
+        const Node& node = nodes[entry.node];
+        uint32_t testing = entry.testMask;
+        entry.testMask = 0;
+        for (unsigned int f = 0; testing != 0; f++, testing >>= 1) {
+            if ((testing & 1u) == 0)
+                continue;
+            Containment containment = classify(frusta[f], node.boundsMin, node.boundsMax);
+            if (containment == Containment::INTERSECTING)
+                entry.testMask |= 1u << f;
+            else if (containment == Containment::INSIDE)
+                entry.insideMask |= 1u << f;
+        }
+        if ((entry.testMask | entry.insideMask) == 0)
+            continue;
+        if (node.isLeaf()) {
+            values.push_back(node.value);
+            masks.push_back(entry.testMask | entry.insideMask);
+        } else {
+            MaskedEntry child1 = { node.child1, entry.testMask, entry.insideMask };
+            MaskedEntry child2 = { node.child2, entry.testMask, entry.insideMask };
+            stack.push(child1);
+            stack.push(child2);
+        }
+    }
+}
+
+template <typename Allocator>
+void SpatialIndex::queryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+                            std::vector<SpatialHit, Allocator>& hits) const {
+    hits.clear();
+    if (root == NO_NODE)
+        return;
+    glm::vec3 inverseDirection = inverse(direction);
+    TraversalStack<int> stack;
+    stack.push(root);
+    while (!stack.empty()) {
+        const Node& node = nodes[stack.pop()];
+        float enter;
+        if (!rayHitsBox(origin, inverseDirection, maxDistance, node.boundsMin, node.boundsMax, enter))
+            continue;
+        if (node.isLeaf()) {
+            SpatialHit hit = { node.value, 0, enter };
+            hits.push_back(hit);
+        } else {
+            stack.push(node.child1);
+            stack.push(node.child2);
+        }
+    }
+}
+
+void SpatialIndex::queryRays(const SpatialRay* rays, unsigned int rayCount, std::vector<SpatialHit>& hits) const {
+    hits.clear();
+    if (root == NO_NODE || rayCount == 0)
+        return;
+    rayCount = std::min(rayCount, 32u);
+    glm::vec3 inverseDirections[32];
+    for (unsigned int r = 0; r < rayCount; r++)
+        inverseDirections[r] = inverse(rays[r].direction);
+
+    TraversalStack<MaskedEntry> stack;
+    MaskedEntry first = { root, rayCount == 32 ? 0xffffffffu : (1u << rayCount) - 1u, 0u };
+    stack.push(first);
+    while (!stack.empty()) {
+        MaskedEntry entry = stack.pop();
+        const Node& node = nodes[entry.node];
+        uint32_t testing = entry.testMask;
+        uint32_t active = 0;
+        float distances[32];
+        for (unsigned int r = 0; testing != 0; r++, testing >>= 1) {
+            if ((testing & 1u) != 0 && rayHitsBox(rays[r].origin, inverseDirections[r], rays[r].maxDistance,
+                                                  node.boundsMin, node.boundsMax, distances[r]))
+                active |= 1u << r;
+        }
+        if (active == 0)
+            continue;
+        if (node.isLeaf()) {
+            for (unsigned int r = 0; r < rayCount; r++) {
+                if ((active & (1u << r)) != 0) {
+                    SpatialHit hit = { node.value, r, distances[r] };
+                    hits.push_back(hit);
+                }
+            }
+        } else {
+            MaskedEntry child1 = { node.child1, active, 0u };
+            MaskedEntry child2 = { node.child2, active, 0u };
+            stack.push(child1);
+            stack.push(child2);
+        }
+    }
+}
+
+// the single result queries for heap vectors and for per-frame FrameVectors
+#define INSTANTIATE_QUERIES(ALLOCATOR, HIT_ALLOCATOR) \
+    template void SpatialIndex::queryBox(const glm::vec3&, const glm::vec3&, std::vector<uint32_t, ALLOCATOR>&) const; \
+    template void SpatialIndex::querySphere(const glm::vec3&, float, std::vector<uint32_t, ALLOCATOR>&) const; \
+    template void SpatialIndex::queryFrustum(const Frustum&, std::vector<uint32_t, ALLOCATOR>&) const; \
+    template void SpatialIndex::queryRay(const glm::vec3&, const glm::vec3&, float, std::vector<SpatialHit, HIT_ALLOCATOR>&) const;
+INSTANTIATE_QUERIES(std::allocator<uint32_t>, std::allocator<SpatialHit>)
+INSTANTIATE_QUERIES(FrameStlAllocator<uint32_t>, FrameStlAllocator<SpatialHit>)
+#undef INSTANTIATE_QUERIES
@@ -2,6 +2,7 @@
 #include <string>
 #include <iostream>
 #include "stb_image.h"
+#include "Trace.h"
 
 using namespace std;
 
@@ -13,8 +14,13 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
     glGenTextures(1, &textureID);
 
     int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
+    unsigned char *data;
+    {
+        TRACE_SCOPE("texture decode");
+        data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
+    }
     if (data) {
+        TRACE_SCOPE("texture upload");
         GLenum format = GL_RGB;
         if (nrComponents == 1)
             format = GL_RED;
@@ -0,0 +1,150 @@
+#include "Trace.h"
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+std::atomic<Trace::ThreadBuffer*> Trace::buffers(nullptr);
+std::atomic<unsigned int> Trace::nextThreadId(1);
+
+Trace::ThreadBuffer* Trace::threadBuffer() {
+    static thread_local ThreadBuffer* local = nullptr;
+    if (local)
+        return local;
+
+    // first event on this thread: push a buffer onto the global list, never freed
+    // so events from finished threads still end up in the dump
+    ThreadBuffer* buffer = new ThreadBuffer();
+    for (unsigned int i = 0; i < MAX_CHUNKS; i++)
+        buffer->ring[i].store(nullptr, std::memory_order_relaxed);
+    buffer->ring[0].store(new Chunk(), std::memory_order_relaxed);
+    buffer->tailSequence.store(0, std::memory_order_relaxed);
+    buffer->id = nextThreadId.fetch_add(1);
+    buffer->name.store(nullptr);
+    buffer->dropped.store(0);
+    buffer->next = buffers.load(std::memory_order_relaxed);
+    while (!buffers.compare_exchange_weak(buffer->next, buffer, std::memory_order_release, std::memory_order_relaxed))
+        ;
+    local = buffer;
+    return local;
+}
+
+void Trace::record(const char* name, uint64_t beginNs, uint64_t endNs) {
+    ThreadBuffer* buffer = threadBuffer();
+    uint64_t sequence = buffer->tailSequence.load(std::memory_order_relaxed);
+    Chunk* chunk = buffer->ring[sequence % MAX_CHUNKS].load(std::memory_order_relaxed);
+    unsigned int count = chunk->count.load(std::memory_order_relaxed);
+    if (count == CHUNK_EVENTS) {
+        sequence++;
+        std::atomic<Chunk*>& slot = buffer->ring[sequence % MAX_CHUNKS];
+        chunk = slot.load(std::memory_order_relaxed);
+        if (!chunk) {
+            chunk = new Chunk();
+            chunk->sequence.store(sequence, std::memory_order_relaxed);
+            slot.store(chunk, std::memory_order_release);
+        } else {
+            // recycles the oldest chunk: the count is cleared before the new
+            // sequence shows, and the fence orders the sequence before any of
+            // the event stores below, pairing with the fence in write()
+            buffer->dropped.fetch_add(chunk->count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            chunk->count.store(0, std::memory_order_relaxed);
+            chunk->sequence.store(sequence, std::memory_order_release);
+            std::atomic_thread_fence(std::memory_order_release);
+        }
+        buffer->tailSequence.store(sequence, std::memory_order_release);
+        count = 0;
+    }
+
+    EventSlot& event = chunk->events[count];
+    event.name.store(name, std::memory_order_relaxed);
+    event.begin.store(beginNs, std::memory_order_relaxed);
+    event.duration.store(endNs - beginNs, std::memory_order_relaxed);
+    // publishes the event to write()
+    chunk->count.store(count + 1, std::memory_order_release);
+}
+
+void Trace::setThreadName(const char* name) {
+    threadBuffer()->name.store(name, std::memory_order_release);
+}
+
+size_t Trace::droppedEvents() {
+    size_t dropped = 0;
+    for (ThreadBuffer* buffer = buffers.load(std::memory_order_acquire); buffer; buffer = buffer->next)
+        dropped += buffer->dropped.load(std::memory_order_relaxed);
+    return dropped;
+}
+
+static void writeString(std::ofstream& out, const char* text) {
+    out << '"';
+    for (const char* c = text; *c; c++) {
+        if (*c == '"' || *c == '\\')
+            out << '\\';
+        out << *c;
+    }
+    out << '"';
+}
+
+bool Trace::write(const std::string& path) {
+    std::ofstream out(path.c_str());
+    if (!out) {
+        std::cout << "ERROR::TRACE::FILE_NOT_WRITABLE: " << path << std::endl;
+        return false;
+    }
+
+    size_t eventCount = 0;
+    bool first = true;
+    std::vector<Event> events;
+    events.reserve(CHUNK_EVENTS);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out.setf(std::ios::fixed);
+    out.precision(3);
+    for (ThreadBuffer* buffer = buffers.load(std::memory_order_acquire); buffer; buffer = buffer->next) {
+        const char* threadName = buffer->name.load(std::memory_order_acquire);
+        if (threadName) {
+            out << (first ? "" : ",\n") << "{\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->id
+                << ",\"name\":\"thread_name\",\"args\":{\"name\":";
+            writeString(out, threadName);
+            out << "}}";
+            first = false;
+        }
+
+        // the ring oldest first; a chunk is copied out and kept only if it
+        // wasn't recycled while being copied
+        uint64_t tail = buffer->tailSequence.load(std::memory_order_acquire);
+        uint64_t oldest = tail >= MAX_CHUNKS ? tail - MAX_CHUNKS + 1 : 0;
+        for (uint64_t sequence = oldest; sequence <= tail; sequence++) {
+            Chunk* chunk = buffer->ring[sequence % MAX_CHUNKS].load(std::memory_order_acquire);
+            if (!chunk || chunk->sequence.load(std::memory_order_acquire) != sequence)
+                continue;
+            unsigned int count = chunk->count.load(std::memory_order_acquire);
+            events.resize(count);
+            for (unsigned int i = 0; i < count; i++) {
+                const EventSlot& slot = chunk->events[i];
+                events[i].name = slot.name.load(std::memory_order_relaxed);
+                events[i].begin = slot.begin.load(std::memory_order_relaxed);
+                events[i].duration = slot.duration.load(std::memory_order_relaxed);
+            }
+            // orders the copy before the re-check; a recycle that began during
+            // it shows in the sequence
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (chunk->sequence.load(std::memory_order_relaxed) != sequence)
+                continue;
+            for (unsigned int i = 0; i < count; i++) {
+                const Event& event = events[i];
+                // trace-event timestamps are in microseconds
+                out << (first ? "" : ",\n") << "{\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->id << ",\"name\":";
+                writeString(out, event.name);
+                out << ",\"ts\":" << event.begin / 1000.0 << ",\"dur\":" << event.duration / 1000.0 << "}";
+                first = false;
+            }
+            eventCount += count;
+        }
+    }
+    out << "\n]}\n";
+
+    std::cout << "Trace: wrote " << eventCount << " events to " << path;
+    size_t dropped = droppedEvents();
+    if (dropped > 0)
+        std::cout << " (" << dropped << " older ones overwritten)";
+    std::cout << std::endl;
+    return true;
+}
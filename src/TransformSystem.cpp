@@ -0,0 +1,354 @@
+#include "TransformSystem.h"
+#include "JobSystem.h"
+
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define TRANSFORM_SSE 1
+#endif
+
+namespace {
+    // matrices are built in groups of LANES, the arrays are padded to match
+    const size_t LANES = 4;
+    const size_t WORD_BITS = 32;
+    // dirty words per parallelFor range, 2048 transforms
+    const size_t WORDS_PER_JOB = 64;
+
+    // hot data, read by the batch kernel
+    std::vector<float> positionX, positionY, positionZ;
+    std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+    std::vector<float> scaleX, scaleY, scaleZ;
+    std::vector<glm::mat4> worldMatrices;
+    std::vector<uint32_t> dirtyBits;
+    // rebuilt since the last takeMoved()
+    std::vector<uint32_t> movedBits;
+    // set for transforms with a look-at mode, their rotation depends on the target
+    std::vector<uint32_t> lookAtBits;
+
+    // cold data, only touched by setters and when a look-at rotation is resolved
+    std::vector<glm::quat> baseRotations;
+    std::vector<glm::vec3> eulerAngles;
+    std::vector<glm::vec3> targets;
+    std::vector<RotationMode> modes;
+    std::vector<unsigned char> alive;
+
+    std::vector<TransformHandle> freeSlots;
+    size_t slotCount = 0;
+    size_t liveCount = 0;
+    size_t lastUpdateCount = 0;
+
+    void markDirty(TransformHandle i) {
+        dirtyBits[i / WORD_BITS] |= 1u << (i % WORD_BITS);
+    }
+
+    bool isDirty(TransformHandle i) {
+        return (dirtyBits[i / WORD_BITS] >> (i % WORD_BITS)) & 1u;
+    }
+
+    size_t countBits(uint32_t bits) {
+        bits = bits - ((bits >> 1) & 0x55555555u);
+        bits = (bits & 0x33333333u) + ((bits >> 2) & 0x33333333u);
+        return (((bits + (bits >> 4)) & 0x0f0f0f0fu) * 0x01010101u) >> 24;
+    }
+
+    void storeRotation(size_t i, const glm::quat& q) {
+        rotationX[i] = q.x;
+        rotationY[i] = q.y;
+        rotationZ[i] = q.z;
+        rotationW[i] = q.w;
+    }
+
+    // Base rotation followed by turning +Z towards the target: a yaw about Y,
+    // then for ALL a pitch about X. The quaternion of a rotation by t is
+    // proportional to (1 + cos t, sin t) in its w and axis part, so both come
+    // straight from the direction without any trigonometry.
+    void resolveLookAt(size_t i) {
+        glm::quat q = baseRotations[i];
+        glm::vec3 direction = targets[i] - glm::vec3(positionX[i], positionY[i], positionZ[i]);
+        float horizontal = glm::length(glm::vec2(direction.x, direction.z));
+        if (horizontal > 0.0f) {
+            float sinYaw = direction.x / horizontal;
+            float cosYaw = direction.z / horizontal;
+            // (1 - cos t, sin t) is the same rotation scaled by 2 sin(t/2), and
+            // does not cancel when the object turns around
+            if (cosYaw >= 0.0f)
+                q = q * glm::normalize(glm::quat(1.0f + cosYaw, 0.0f, sinYaw, 0.0f));
+            else
+                q = q * glm::normalize(glm::quat(sinYaw, 0.0f, 1.0f - cosYaw, 0.0f));
+        }
+        if (modes[i] == RotationMode::ALL) {
+            float length = glm::length(direction);
+            if (length > 0.0f)
+                q = q * glm::normalize(glm::quat(1.0f + horizontal / length, -direction.y / length, 0.0f, 0.0f));
+        }
+        storeRotation(i, q);
+    }
+
+    void buildMatrix(size_t i) {
+        float x = rotationX[i], y = rotationY[i], z = rotationZ[i], w = rotationW[i];
+        glm::mat4& m = worldMatrices[i];
+        m[0] = glm::vec4(1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + w * z), 2.0f * (x * z - w * y), 0.0f) * scaleX[i];
+        m[1] = glm::vec4(2.0f * (x * y - w * z), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + w * x), 0.0f) * scaleY[i];
+        m[2] = glm::vec4(2.0f * (x * z + w * y), 2.0f * (y * z - w * x), 1.0f - 2.0f * (x * x + y * y), 0.0f) * scaleZ[i];
+        m[3] = glm::vec4(positionX[i], positionY[i], positionZ[i], 1.0f);
+    }
+
+#ifdef TRANSFORM_SSE
+    // one column of four matrices from its x, y, z, w across the lanes
+    void storeColumn(size_t first, int column, __m128 x, __m128 y, __m128 z, __m128 w) {
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+        _mm_storeu_ps(&worldMatrices[first][column][0], x);
+        _mm_storeu_ps(&worldMatrices[first + 1][column][0], y);
+        _mm_storeu_ps(&worldMatrices[first + 2][column][0], z);
+        _mm_storeu_ps(&worldMatrices[first + 3][column][0], w);
+    }
+
+    void buildGroup(size_t first) {
+        __m128 x = _mm_loadu_ps(&rotationX[first]);
+        __m128 y = _mm_loadu_ps(&rotationY[first]);
+        __m128 z = _mm_loadu_ps(&rotationZ[first]);
+        __m128 w = _mm_loadu_ps(&rotationW[first]);
+        __m128 one = _mm_set1_ps(1.0f);
+        __m128 two = _mm_set1_ps(2.0f);
+        __m128 zero = _mm_setzero_ps();
+
+        __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+        __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+        __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+        __m128 sx = _mm_loadu_ps(&scaleX[first]);
+        __m128 sy = _mm_loadu_ps(&scaleY[first]);
+        __m128 sz = _mm_loadu_ps(&scaleZ[first]);
+        storeColumn(first, 0,
+                    _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx),
+                    _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx),
+                    _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx), zero);
+        storeColumn(first, 1,
+                    _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy),
+                    _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy),
+                    _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy), zero);
+        storeColumn(first, 2,
+                    _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz),
+                    _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz),
+                    _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz), zero);
+        storeColumn(first, 3,
+                    _mm_loadu_ps(&positionX[first]), _mm_loadu_ps(&positionY[first]),
+                    _mm_loadu_ps(&positionZ[first]), one);
+    }
+#else
+    void buildGroup(size_t first) {
+        for (size_t i = first; i < first + LANES; i++)
+            buildMatrix(i);
+    }
+#endif
+
+    // rebuilds the dirty transforms of words [begin, end) and returns how many there were
+    size_t updateWords(size_t begin, size_t end) {
+        size_t rebuilt = 0;
+        for (size_t word = begin; word < end; word++) {
+            uint32_t bits = dirtyBits[word];
+            if (bits == 0)
+                continue;
+            size_t first = word * WORD_BITS;
+            rebuilt += countBits(bits);
+            uint32_t lookAt = bits & lookAtBits[word];
+            for (size_t bit = 0; lookAt != 0; bit++, lookAt >>= 1) {
+                if (lookAt & 1u)
+                    resolveLookAt(first + bit);
+            }
+            // clean lanes in a dirty group come out unchanged
+            for (size_t group = 0; group < WORD_BITS; group += LANES) {
+                if ((bits >> group) & ((1u << LANES) - 1))
+                    buildGroup(first + group);
+            }
+            movedBits[word] |= bits;
+            dirtyBits[word] = 0;
+        }
+        return rebuilt;
+    }
+
+    void grow(size_t count) {
+        // whole dirty words, so the padding lanes of every group exist
+        size_t padded = (count + WORD_BITS - 1) / WORD_BITS * WORD_BITS;
+        if (padded <= positionX.size())
+            return;
+        positionX.resize(padded, 0.0f);
+        positionY.resize(padded, 0.0f);
+        positionZ.resize(padded, 0.0f);
+        rotationX.resize(padded, 0.0f);
+        rotationY.resize(padded, 0.0f);
+        rotationZ.resize(padded, 0.0f);
+        rotationW.resize(padded, 1.0f);
+        scaleX.resize(padded, 1.0f);
+        scaleY.resize(padded, 1.0f);
+        scaleZ.resize(padded, 1.0f);
+        worldMatrices.resize(padded, glm::mat4(1.0f));
+        dirtyBits.resize(padded / WORD_BITS, 0);
+        movedBits.resize(padded / WORD_BITS, 0);
+        lookAtBits.resize(padded / WORD_BITS, 0);
+        baseRotations.resize(padded, glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+        eulerAngles.resize(padded, glm::vec3(0.0f));
+        targets.resize(padded, glm::vec3(0.0f));
+        modes.resize(padded, RotationMode::NONE);
+        alive.resize(padded, 0);
+    }
+}
+
+TransformHandle TransformSystem::create() {
+    TransformHandle handle;
+    if (!freeSlots.empty()) {
+        handle = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        handle = static_cast<TransformHandle>(slotCount++);
+        // doubling, the arrays are reallocated as rarely as a std::vector's
+        if (slotCount > positionX.size())
+            grow(std::max(slotCount, positionX.size() * 2));
+    }
+
+    positionX[handle] = positionY[handle] = positionZ[handle] = 0.0f;
+    storeRotation(handle, glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+    scaleX[handle] = scaleY[handle] = scaleZ[handle] = 1.0f;
+    baseRotations[handle] = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    eulerAngles[handle] = glm::vec3(0.0f);
+    targets[handle] = glm::vec3(0.0f);
+    modes[handle] = RotationMode::NONE;
+    lookAtBits[handle / WORD_BITS] &= ~(1u << (handle % WORD_BITS));
+    alive[handle] = 1;
+    markDirty(handle);
+    liveCount++;
+    return handle;
+}
+
+void TransformSystem::destroy(TransformHandle handle) {
+    if (handle == INVALID_TRANSFORM || handle >= slotCount || !alive[handle])
+        return;
+    alive[handle] = 0;
+    dirtyBits[handle / WORD_BITS] &= ~(1u << (handle % WORD_BITS));
+    movedBits[handle / WORD_BITS] &= ~(1u << (handle % WORD_BITS));
+    freeSlots.push_back(handle);
+    liveCount--;
+}
+
+void TransformSystem::reserve(size_t count) {
+    grow(count);
+    freeSlots.reserve(count);
+}
+
+void TransformSystem::setPosition(TransformHandle handle, const glm::vec3& position) {
+    if (positionX[handle] == position.x && positionY[handle] == position.y && positionZ[handle] == position.z)
+        return;
+    positionX[handle] = position.x;
+    positionY[handle] = position.y;
+    positionZ[handle] = position.z;
+    markDirty(handle);
+}
+
+void TransformSystem::setScale(TransformHandle handle, const glm::vec3& scale) {
+    if (scaleX[handle] == scale.x && scaleY[handle] == scale.y && scaleZ[handle] == scale.z)
+        return;
+    scaleX[handle] = scale.x;
+    scaleY[handle] = scale.y;
+    scaleZ[handle] = scale.z;
+    markDirty(handle);
+}
+
+void TransformSystem::setRotation(TransformHandle handle, const glm::vec3& eulerDegrees) {
+    if (eulerAngles[handle] == eulerDegrees)
+        return;
+    eulerAngles[handle] = eulerDegrees;
+    glm::vec3 radians = glm::radians(eulerDegrees);
+    baseRotations[handle] = glm::angleAxis(radians.x, glm::vec3(1.0f, 0.0f, 0.0f)) *
+                            glm::angleAxis(radians.y, glm::vec3(0.0f, 1.0f, 0.0f)) *
+                            glm::angleAxis(radians.z, glm::vec3(0.0f, 0.0f, 1.0f));
+    storeRotation(handle, baseRotations[handle]);
+    markDirty(handle);
+}
+
+void TransformSystem::setRotationMode(TransformHandle handle, RotationMode mode) {
+    if (modes[handle] == mode)
+        return;
+    modes[handle] = mode;
+    if (mode == RotationMode::NONE)
+        lookAtBits[handle / WORD_BITS] &= ~(1u << (handle % WORD_BITS));
+    else
+        lookAtBits[handle / WORD_BITS] |= 1u << (handle % WORD_BITS);
+    storeRotation(handle, baseRotations[handle]);
+    markDirty(handle);
+}
+
+void TransformSystem::setTarget(TransformHandle handle, const glm::vec3& target) {
+    if (targets[handle] == target)
+        return;
+    targets[handle] = target;
+    // without a look-at mode the target does not affect the matrix
+    if (modes[handle] != RotationMode::NONE)
+        markDirty(handle);
+}
+
+glm::vec3 TransformSystem::getPosition(TransformHandle handle) {
+    return glm::vec3(positionX[handle], positionY[handle], positionZ[handle]);
+}
+
+glm::vec3 TransformSystem::getScale(TransformHandle handle) {
+    return glm::vec3(scaleX[handle], scaleY[handle], scaleZ[handle]);
+}
+
+glm::vec3 TransformSystem::getRotation(TransformHandle handle) {
+    return eulerAngles[handle];
+}
+
+RotationMode TransformSystem::getRotationMode(TransformHandle handle) {
+    return modes[handle];
+}
+
+glm::vec3 TransformSystem::getTarget(TransformHandle handle) {
+    return targets[handle];
+}
+
+void TransformSystem::update() {
+    size_t words = (slotCount + WORD_BITS - 1) / WORD_BITS;
+    std::atomic<size_t> rebuilt(0);
+    JobSystem::parallelFor(words, WORDS_PER_JOB, [&rebuilt](size_t begin, size_t end) {
+        size_t count = updateWords(begin, end);
+        if (count > 0)
+            rebuilt.fetch_add(count, std::memory_order_relaxed);
+    });
+    lastUpdateCount = rebuilt.load();
+}
+
+glm::mat4 TransformSystem::getWorldMatrix(TransformHandle handle) {
+    if (isDirty(handle)) {
+        if (modes[handle] != RotationMode::NONE)
+            resolveLookAt(handle);
+        buildMatrix(handle);
+        dirtyBits[handle / WORD_BITS] &= ~(1u << (handle % WORD_BITS));
+        movedBits[handle / WORD_BITS] |= 1u << (handle % WORD_BITS);
+    }
+    return worldMatrices[handle];
+}
+
+size_t TransformSystem::getCount() {
+    return liveCount;
+}
+
+size_t TransformSystem::getLastUpdateCount() {
+    return lastUpdateCount;
+}
+
+void TransformSystem::takeMoved(FrameVector<TransformHandle>& handles) {
+    handles.clear();
+    for (size_t word = 0; word < movedBits.size(); word++) {
+        uint32_t bits = movedBits[word];
+        for (size_t bit = 0; bits != 0; bit++, bits >>= 1) {
+            if (bits & 1u)
+                handles.push_back(static_cast<TransformHandle>(word * WORD_BITS + bit));
+        }
+        movedBits[word] = 0;
+    }
+}
@@ -86,4 +86,17 @@ void Camera::setHeight(float height) {
     fixedHeight = height;
     Position.y = height;
 }
- 
\ No newline at end of file
+
+void Camera::lookAt(const glm::vec3& position, const glm::vec3& target) {
+    Position = position;
+    glm::vec3 direction = glm::normalize(target - position);
+    Yaw = glm::degrees(glm::atan(direction.z, direction.x));
+    Pitch = glm::clamp(glm::degrees(glm::asin(direction.y)), -89.0f, 89.0f);
+    updateCameraVectors();
+}
+
+void Camera::setOrientation(float yaw, float pitch) {
+    Yaw = yaw;
+    Pitch = pitch;
+    updateCameraVectors();
+}